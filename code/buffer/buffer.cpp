@@ -5,13 +5,20 @@
  */ 
 #include "buffer.h"
 
-Buffer::Buffer(int initBuffSize) : buffer_(initBuffSize), readPos_(0), writePos_(0) {}
+char Buffer::empty_[1];
+
+Buffer::Buffer(int initBuffSize) : buffer_(empty_), cap_(0), hintSize_(initBuffSize),
+                                   readPos_(0), writePos_(0) {}
+
+Buffer::~Buffer() {
+    BufferPool::Instance()->Free(cap_ ? buffer_ : nullptr, cap_);
+}
 
 size_t Buffer::ReadableBytes() const {
     return writePos_ - readPos_;
 }
 size_t Buffer::WritableBytes() const {
-    return buffer_.size() - writePos_;
+    return cap_ - writePos_;
 }
 
 size_t Buffer::PrependableBytes() const {
@@ -33,11 +40,19 @@ void Buffer::RetrieveUntil(const char* end) {
 }  // 该函数从缓冲区中检索数据，直到指定的结束指针为止。
 
 void Buffer::RetrieveAll() {
-    bzero(&buffer_[0], buffer_.size());
     readPos_ = 0;
     writePos_ = 0;
 }
 
+void Buffer::Release() {
+    if(ReadableBytes() > 0 || cap_ == 0) { return; }
+    BufferPool::Instance()->Free(buffer_, cap_);
+    hintSize_ = cap_;  // 下次直接申请同样大小，读入时不必先落到栈上再拷贝
+    buffer_ = empty_;
+    cap_ = 0;
+    readPos_ = writePos_ = 0;
+}
+
 std::string Buffer::RetrieveAllToStr() {
     std::string str(Peek(), ReadableBytes());
     RetrieveAll();
@@ -83,9 +98,12 @@ void Buffer::EnsureWriteable(size_t len) {
     assert(WritableBytes() >= len);
 }
 
-ssize_t Buffer::ReadFd(int fd, int* saveErrno) {
+ssize_t Buffer::ReadFd(int fd, int* saveErrno, bool* drained) {
     char buff[65535];
     struct iovec iov[2];
+    if(cap_ == 0) {
+        MakeSpace_(hintSize_);
+    }
     const size_t writable = WritableBytes();
     /* 分散读， 保证数据全部读完 */
     iov[0].iov_base = BeginPtr_() + writePos_;
@@ -94,6 +112,9 @@ ssize_t Buffer::ReadFd(int fd, int* saveErrno) {
     iov[1].iov_len = sizeof(buff);
 
     const ssize_t len = readv(fd, iov, 2);
+    if(drained) {
+        *drained = len >= 0 && static_cast<size_t>(len) < writable + sizeof(buff);
+    }
     if(len < 0) {
         *saveErrno = errno;
     }
@@ -101,7 +122,7 @@ ssize_t Buffer::ReadFd(int fd, int* saveErrno) {
         writePos_ += len;
     }
     else {
-        writePos_ = buffer_.size();
+        writePos_ = cap_;
         Append(buff, len - writable);
     }
     return len;
@@ -119,16 +140,25 @@ ssize_t Buffer::WriteFd(int fd, int* saveErrno) {
 }
 
 char* Buffer::BeginPtr_() {
-    return &*buffer_.begin();
+    return buffer_;
 }
 
 const char* Buffer::BeginPtr_() const {
-    return &*buffer_.begin();
+    return buffer_;
 }
 
 void Buffer::MakeSpace_(size_t len) {
     if(WritableBytes() + PrependableBytes() < len) {
-        buffer_.resize(writePos_ + len + 1);
+        /* 换一个更大档位的块，只拷贝未读的数据 */
+        size_t readable = ReadableBytes();
+        size_t cap = 0;
+        char* buffer = BufferPool::Instance()->Alloc(std::max(readable + len, hintSize_), &cap);
+        std::copy(BeginPtr_() + readPos_, BeginPtr_() + writePos_, buffer);
+        BufferPool::Instance()->Free(cap_ ? buffer_ : nullptr, cap_);
+        buffer_ = buffer;
+        cap_ = cap;
+        readPos_ = 0;
+        writePos_ = readable;
     } 
     else {
         size_t readable = ReadableBytes();
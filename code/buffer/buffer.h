@@ -10,13 +10,18 @@
 #include <iostream>
 #include <unistd.h>  // write
 #include <sys/uio.h> //readv
-#include <vector> //readv
-#include <atomic>
 #include <assert.h>
+#include "bufferpool.h"
+
+/* 读写下标只由持有连接的线程访问，用普通整数；存储来自 BufferPool，
+   第一次写入时才申请，Release() 在空闲时把内存还给池 */
 class Buffer {
 public:
     Buffer(int initBuffSize = 1024);
-    ~Buffer() = default;
+    ~Buffer();
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
 
     size_t WritableBytes() const;       
     size_t ReadableBytes() const ;
@@ -29,8 +34,10 @@ public:
     void Retrieve(size_t len);
     void RetrieveUntil(const char* end);
 
-    void RetrieveAll() ;
+    void RetrieveAll() ;  // O(1)，只重置下标，不清零
     std::string RetrieveAllToStr();
+    void Release();  // 没有可读数据时把存储还给内存池，下次写入再申请
+    void SetHintSize(size_t size) { hintSize_ = size; }  // 下次申请存储时的容量，只在未申请存储时有意义
 
     const char* BeginWriteConst() const;
     char* BeginWrite();
@@ -40,7 +47,8 @@ public:
     void Append(const void* data, size_t len);
     void Append(const Buffer& buff);
 
-    ssize_t ReadFd(int fd, int* Errno);
+    ssize_t ReadFd(int fd, int* Errno, bool* drained = nullptr);
+    // drained: 读到的比提供的空间少，套接字的接收缓冲区已读空，ET 模式不必再读一次等 EAGAIN
     ssize_t WriteFd(int fd, int* Errno);
 
 private:
@@ -48,9 +56,13 @@ private:
     const char* BeginPtr_() const;
     void MakeSpace_(size_t len);
 
-    std::vector<char> buffer_;
-    std::atomic<std::size_t> readPos_;
-    std::atomic<std::size_t> writePos_;
+    char* buffer_;
+    size_t cap_;  // buffer_ 的容量，未申请时为 0
+    size_t hintSize_;  // 申请存储时的最小容量：初始为构造参数，Release 后为上次的容量
+    size_t readPos_;
+    size_t writePos_;
+
+    static char empty_[1];  // 未申请存储时 buffer_ 指向这里，Peek/BeginWrite 不用判空
 };
 
 #endif //BUFFER_H
\ No newline at end of file
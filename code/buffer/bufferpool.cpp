@@ -0,0 +1,91 @@
+#include "bufferpool.h"
+
+thread_local BufferPool::LocalCache_ BufferPool::local_;
+
+BufferPool* BufferPool::Instance() {
+    /* 不析构：退出时仍在运行的线程归还内存也不会访问已销毁的链表 */
+    static BufferPool* inst = new BufferPool();
+    return inst;
+}
+
+int BufferPool::ClassOf_(size_t size) {
+    if(size <= (size_t(1) << MIN_SHIFT)) { return 0; }
+    int shift = 64 - __builtin_clzll(size - 1);  // 向上取整到 2 的幂
+    return shift <= MAX_SHIFT ? shift - MIN_SHIFT : -1;
+}
+
+char* BufferPool::Alloc(size_t size, size_t* cap) {
+    assert(cap);
+    allocs_.fetch_add(1, std::memory_order_relaxed);
+    int cls = ClassOf_(size);
+    if(cls < 0) {
+        /* 超过最大档位，不进池 */
+        mallocs_.fetch_add(1, std::memory_order_relaxed);
+        *cap = size;
+        return static_cast<char*>(malloc(size));
+    }
+    *cap = size_t(1) << (MIN_SHIFT + cls);
+    std::vector<char*>& local = local_.blocks[cls];
+    if(local.empty()) {
+        Refill_(cls, local);
+    }
+    if(!local.empty()) {
+        char* data = local.back();
+        local.pop_back();
+        return data;
+    }
+    mallocs_.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<char*>(malloc(*cap));  // 不需要清零
+}
+
+void BufferPool::Free(char* data, size_t cap) {
+    if(!data) { return; }
+    int cls = ClassOf_(cap);
+    if(cls < 0 || (size_t(1) << (MIN_SHIFT + cls)) != cap) {
+        free(data);
+        return;
+    }
+    std::vector<char*>& local = local_.blocks[cls];
+    local.push_back(data);
+    if(local.size() > LocalMax_(cls)) {
+        Drain_(cls, local, LocalMax_(cls) / 2);
+    }
+}
+
+void BufferPool::Refill_(int cls, std::vector<char*>& local) {
+    Class_& global = classes_[cls];
+    std::lock_guard<std::mutex> locker(global.mtx);
+    size_t n = std::min(global.blocks.size(), std::max<size_t>(LocalMax_(cls) / 2, 1));
+    local.insert(local.end(), global.blocks.end() - n, global.blocks.end());
+    global.blocks.resize(global.blocks.size() - n);
+}
+
+void BufferPool::Drain_(int cls, std::vector<char*>& local, size_t keep) {
+    Class_& global = classes_[cls];
+    std::lock_guard<std::mutex> locker(global.mtx);
+    while(local.size() > keep) {
+        if(global.blocks.size() < GlobalMax_(cls)) {
+            global.blocks.push_back(local.back());
+        } else {
+            free(local.back());  // 全局也满了，还给系统
+        }
+        local.pop_back();
+    }
+}
+
+BufferPool::LocalCache_::~LocalCache_() {
+    for(int cls = 0; cls < CLASSES; cls++) {
+        if(!blocks[cls].empty()) {
+            BufferPool::Instance()->Drain_(cls, blocks[cls], 0);
+        }
+    }
+}
+
+BufferPool::Stats BufferPool::GetStats() {
+    Stats stats = { allocs_.load(), mallocs_.load(), 0 };
+    for(int cls = 0; cls < CLASSES; cls++) {
+        std::lock_guard<std::mutex> locker(classes_[cls].mtx);
+        stats.pooled += classes_[cls].blocks.size() << (MIN_SHIFT + cls);
+    }
+    return stats;
+}
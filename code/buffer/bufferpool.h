@@ -0,0 +1,66 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <assert.h>
+
+/* Buffer 的内存池：按 2 的幂分成 1KB ~ 1MB 共 11 个尺寸档位，更大的直接 malloc。
+   每个线程先在自己的空闲链表里取还，满了/空了再批量和全局链表交换，
+   常见的「连接空闲归还、下一个请求再取」不加锁、不清零 */
+class BufferPool {
+public:
+    struct Stats {
+        size_t allocs;    // Alloc 次数
+        size_t mallocs;   // 池中没有空闲块、向系统申请的次数
+        size_t pooled;    // 全局链表中空闲的字节数
+    };
+
+    static BufferPool* Instance();
+
+    char* Alloc(size_t size, size_t* cap);  // 返回至少 size 字节的块，实际容量写入 cap
+    void Free(char* data, size_t cap);  // cap 必须是 Alloc 返回的容量
+
+    Stats GetStats();
+
+    static constexpr int MIN_SHIFT = 10;
+    static constexpr int MAX_SHIFT = 20;
+
+private:
+    BufferPool() = default;
+    ~BufferPool() = default;
+
+    static constexpr int CLASSES = MAX_SHIFT - MIN_SHIFT + 1;
+    static constexpr size_t LOCAL_BYTES = 256 << 10;  // 每个线程每个档位最多缓存的字节数
+    static constexpr size_t GLOBAL_BYTES = 16 << 20;  // 全局每个档位最多缓存的字节数
+
+    struct Class_ {
+        std::mutex mtx;
+        std::vector<char*> blocks;
+    };
+
+    /* 线程本地的空闲链表，线程退出时还给全局 */
+    struct LocalCache_ {
+        std::vector<char*> blocks[CLASSES];
+        ~LocalCache_();
+    };
+
+    static int ClassOf_(size_t size);
+    static size_t LocalMax_(int cls) { return std::max<size_t>(LOCAL_BYTES >> (MIN_SHIFT + cls), 1); }
+    static size_t GlobalMax_(int cls) { return GLOBAL_BYTES >> (MIN_SHIFT + cls); }
+
+    void Refill_(int cls, std::vector<char*>& local);  // 从全局取一半本地容量
+    void Drain_(int cls, std::vector<char*>& local, size_t keep);  // 本地只保留 keep 个，其余还给全局
+
+    static thread_local LocalCache_ local_;
+
+    Class_ classes_[CLASSES];
+    std::atomic<size_t> allocs_{0};
+    std::atomic<size_t> mallocs_{0};
+};
+
+#endif //BUFFER_POOL_H
@@ -0,0 +1,104 @@
+#include "chainbuffer.h"
+
+void ChainBuffer::Append(const std::string& str) {
+    Append(str.data(), str.length());
+}
+
+void ChainBuffer::Append(const char* str, size_t len) {
+    assert(str || len == 0);
+    readable_ += len;
+    while(len > 0) {
+        if(segs_.empty() || segs_.back().cap == 0 || segs_.back().end == segs_.back().cap) {
+            /* 尾段是外部引用或已写满：接一个新块 */
+            size_t cap = 0;
+            char* data = BufferPool::Instance()->Alloc(BLOCK_SIZE, &cap);
+            segs_.push_back({ data, cap, 0, 0, nullptr, -1 });
+        }
+        Segment_& seg = segs_.back();
+        size_t n = std::min(len, seg.cap - seg.end);
+        std::copy(str, str + n, seg.data + seg.end);
+        seg.end += n;
+        str += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::AppendRef(const char* data, size_t len, std::shared_ptr<const void> owner) {
+    if(len == 0) { return; }
+    assert(data);
+    segs_.push_back({ const_cast<char*>(data), 0, 0, len, std::move(owner), -1 });
+    readable_ += len;
+}
+
+void ChainBuffer::AppendFile(int fd, off_t offset, size_t len, std::shared_ptr<const void> owner) {
+    if(len == 0) { return; }
+    assert(fd >= 0 && offset >= 0);
+    segs_.push_back({ nullptr, 0, size_t(offset), size_t(offset) + len, std::move(owner), fd });
+    readable_ += len;
+}
+
+int ChainBuffer::PeekIov(struct iovec* iov, int maxIov) const {
+    int cnt = 0;
+    for(auto it = segs_.begin() + head_; it != segs_.end() && it->fd < 0 && cnt < maxIov; ++it) {
+        iov[cnt].iov_base = it->data + it->begin;
+        iov[cnt].iov_len = it->end - it->begin;
+        cnt++;
+    }
+    return cnt;
+}
+
+void ChainBuffer::Retrieve(size_t len) {
+    assert(len <= readable_);
+    readable_ -= len;
+    while(len > 0) {
+        Segment_& seg = segs_[head_];
+        size_t n = std::min(len, seg.end - seg.begin);
+        seg.begin += n;
+        len -= n;
+        if(seg.begin == seg.end) {
+            if(seg.cap) { BufferPool::Instance()->Free(seg.data, seg.cap); }
+            seg.owner.reset();
+            head_++;
+        }
+    }
+    if(head_ == segs_.size()) {
+        segs_.clear();  // 保留容量，下一批响应不再分配
+        head_ = 0;
+    }
+}
+
+void ChainBuffer::Clear() {
+    for(size_t i = head_; i < segs_.size(); i++) {
+        if(segs_[i].cap) { BufferPool::Instance()->Free(segs_[i].data, segs_[i].cap); }
+    }
+    segs_.clear();
+    head_ = 0;
+    readable_ = 0;
+}
+
+bool ChainBuffer::HasFile() const {
+    for(size_t i = head_; i < segs_.size(); i++) {
+        if(segs_[i].fd >= 0) { return true; }
+    }
+    return false;
+}
+
+ssize_t ChainBuffer::WriteFd(int fd, int* saveErrno) {
+    ssize_t len;
+    if(head_ < segs_.size() && segs_[head_].fd >= 0) {
+        /* 文件区间：不经过用户态，偏移由段记录，EAGAIN 后从这里继续 */
+        const Segment_& seg = segs_[head_];
+        off_t offset = seg.begin;
+        len = sendfile(fd, seg.fd, &offset, seg.end - seg.begin);
+    } else {
+        struct iovec iov[64];
+        int cnt = PeekIov(iov, 64);
+        len = writev(fd, iov, cnt);
+    }
+    if(len < 0) {
+        *saveErrno = errno;
+        return len;
+    }
+    Retrieve(len);
+    return len;
+}
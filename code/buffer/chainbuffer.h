@@ -0,0 +1,56 @@
+#ifndef CHAIN_BUFFER_H
+#define CHAIN_BUFFER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <errno.h>
+#include <sys/uio.h>  // writev
+#include <sys/sendfile.h> // sendfile
+#include <assert.h>
+#include "bufferpool.h"
+
+/* 分段缓冲区：由固定大小的块串成链，追加时尾块满了就接一个新块，已有数据从不搬移。
+   除了拷贝进来的数据，还可以挂入外部内存的引用（如文件缓存的映射区）和文件区间，
+   由 owner 保证发送完之前有效；发送时连续的内存段组成 iovec 一次 writev，文件区间用 sendfile */
+class ChainBuffer {
+public:
+    ChainBuffer(): head_(0), readable_(0) {}
+    ~ChainBuffer() { Clear(); }
+
+    ChainBuffer(const ChainBuffer&) = delete;
+    ChainBuffer& operator=(const ChainBuffer&) = delete;
+
+    size_t ReadableBytes() const { return readable_; }
+
+    void Append(const std::string& str);
+    void Append(const char* str, size_t len);
+    void AppendRef(const char* data, size_t len, std::shared_ptr<const void> owner);  // 不拷贝
+    void AppendFile(int fd, off_t offset, size_t len, std::shared_ptr<const void> owner);
+    // 文件 [offset, offset + len)，发送时由内核从页缓存直接拷到 socket
+
+    int PeekIov(struct iovec* iov, int maxIov) const;  // 从头开始的若干内存段，遇到文件区间为止，返回段数
+    bool HasFile() const;  // 未发送的数据中是否有文件区间
+    void Retrieve(size_t len);  // 发完的块立即还给内存池
+    void Clear();
+
+    ssize_t WriteFd(int fd, int* saveErrno);
+
+    static const size_t BLOCK_SIZE = 4096;
+
+private:
+    struct Segment_ {
+        char* data;
+        size_t cap;     // 自有块的容量，外部引用和文件区间为 0
+        size_t begin;   // 未发送数据的起点（文件区间为文件偏移）
+        size_t end;     // 数据的终点
+        std::shared_ptr<const void> owner;  // 外部引用的持有者
+        int fd;         // 文件区间的描述符，内存段为 -1
+    };
+
+    std::vector<Segment_> segs_;  // 默认构造不分配内存，空闲连接不占空间
+    size_t head_;  // 第一个未发完的段，发完的段先留在前面，全部发完时一起清掉
+    size_t readable_;
+};
+
+#endif //CHAIN_BUFFER_H
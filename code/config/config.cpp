@@ -0,0 +1,311 @@
+#include "config.h"
+
+using namespace std;
+
+static string Trim(const string& str) {
+    size_t begin = str.find_first_not_of(" \t\r\n");
+    if(begin == string::npos) { return ""; }
+    size_t end = str.find_last_not_of(" \t\r\n");
+    return str.substr(begin, end - begin + 1);
+}
+
+static bool ParseInt(const string& value, int* out) {
+    errno = 0;
+    char* end = nullptr;
+    long v = strtol(value.c_str(), &end, 10);
+    if(value.empty() || *end != '\0' || errno == ERANGE || v < INT_MIN || v > INT_MAX) {
+        return false;
+    }
+    *out = static_cast<int>(v);
+    return true;
+}
+
+static bool ParseSize(const string& value, size_t* out) {
+    /* 允许 K/M/G 后缀（1024 进制），如 256M */
+    if(value.empty() || value[0] == '-') { return false; }
+    errno = 0;
+    char* end = nullptr;
+    unsigned long long v = strtoull(value.c_str(), &end, 10);
+    if(end == value.c_str() || errno == ERANGE) { return false; }
+    int shift = 0;
+    switch(*end) {
+        case '\0': break;
+        case 'k': case 'K': shift = 10; end++; break;
+        case 'm': case 'M': shift = 20; end++; break;
+        case 'g': case 'G': shift = 30; end++; break;
+        default: return false;
+    }
+    if(*end != '\0' || (shift && v > (~0ULL >> shift))) { return false; }
+    *out = static_cast<size_t>(v << shift);
+    return true;
+}
+
+static bool ParseBool(const string& value, bool* out) {
+    if(value == "true" || value == "on" || value == "yes" || value == "1") { *out = true; return true; }
+    if(value == "false" || value == "off" || value == "no" || value == "0") { *out = false; return true; }
+    return false;
+}
+
+static bool ParseValue(const string& value, int* out) { return ParseInt(value, out); }
+static bool ParseValue(const string& value, size_t* out) { return ParseSize(value, out); }
+static bool ParseValue(const string& value, bool* out) { return ParseBool(value, out); }
+static bool ParseValue(const string& value, string* out) { *out = value; return true; }
+static bool ParseValue(const string& value, vector<pair<string, int>>* out) {
+    // 逗号分隔的 类型=秒数，如 text/css=86400,image/*=604800；类型可以是 "主类型/*" 或 "*"
+    vector<pair<string, int>> items;
+    size_t pos = 0;
+    while(pos < value.size()) {
+        size_t comma = value.find(',', pos);
+        if(comma == string::npos) { comma = value.size(); }
+        string item = Trim(value.substr(pos, comma - pos));
+        pos = comma + 1;
+        size_t eq = item.find('=');
+        int seconds = 0;
+        if(eq == string::npos || Trim(item.substr(0, eq)).empty() || !ParseInt(Trim(item.substr(eq + 1)), &seconds)) {
+            return false;
+        }
+        items.emplace_back(Trim(item.substr(0, eq)), seconds);
+    }
+    *out = std::move(items);
+    return true;
+}
+
+static string FormatValue(int value) { return to_string(value); }
+static string FormatValue(size_t value) { return to_string(value); }
+static string FormatValue(bool value) { return value ? "true" : "false"; }
+static string FormatValue(const string& value) { return value; }
+static string FormatValue(const vector<pair<string, int>>& value) {
+    string out;
+    for(const auto& item: value) {
+        out += (out.empty() ? "" : ",") + item.first + "=" + to_string(item.second);
+    }
+    return out;
+}
+
+template<class T>
+static function<bool(Config&, const string&)> Setter(T Config::* member) {
+    return [member](Config& config, const string& value) { return ParseValue(value, &(config.*member)); };
+}
+
+template<class T>
+static function<string(const Config&)> Getter(T Config::* member) {
+    return [member](const Config& config) { return FormatValue(config.*member); };
+}
+
+#define CONFIG_FIELD(key, member, help) { key, help, Setter(&Config::member), Getter(&Config::member) }
+
+const vector<Config::Field_>& Config::Fields_() {
+    static const vector<Field_> fields = {
+        CONFIG_FIELD("server.port", port, "监听端口"),
+        CONFIG_FIELD("server.trig_mode", trigMode, "0 LT+LT, 1 连接 ET, 2 监听 ET, 3 ET+ET"),
+        CONFIG_FIELD("server.timeout_ms", timeoutMS, "空闲连接超时（毫秒），<= 0 不超时"),
+        CONFIG_FIELD("server.linger", optLinger, "SO_LINGER 优雅关闭"),
+        CONFIG_FIELD("server.sub_reactors", subReactors, "子 Reactor 数量，0 为单 Reactor + 线程池"),
+        CONFIG_FIELD("server.reuse_port", reusePort, "子 Reactor 各自 SO_REUSEPORT 监听"),
+        CONFIG_FIELD("server.timing_wheel", timingWheel, "时间轮定时器，false 为小根堆"),
+        CONFIG_FIELD("server.backlog", backlog, "listen backlog，上限为 net.core.somaxconn"),
+        CONFIG_FIELD("server.accept_batch", acceptBatch, "每次监听事件最多接受的连接数"),
+        CONFIG_FIELD("server.max_fd", maxFd, "连接表大小"),
+        CONFIG_FIELD("server.max_events", maxEvents, "每次 epoll_wait 最多取回的事件数"),
+        CONFIG_FIELD("server.resource_dir", resourceDir, "静态资源目录，空为 ./resources/"),
+        CONFIG_FIELD("server.shutdown_timeout_ms", shutdownTimeoutMS, "优雅退出等待进行中响应的时间"),
+        CONFIG_FIELD("server.upgrade_socket", upgradeSocket, "平滑升级的 UNIX 套接字，空为不启用"),
+        CONFIG_FIELD("tcp.defer_accept", tcpDeferAccept, "TCP_DEFER_ACCEPT 秒数，0 不启用"),
+        CONFIG_FIELD("tcp.fastopen", tcpFastOpen, "TCP_FASTOPEN 队列长度，0 不启用"),
+        CONFIG_FIELD("tcp.nodelay", tcpNoDelay, "连接上设置 TCP_NODELAY"),
+        CONFIG_FIELD("tcp.cork", tcpCork, "sendfile 响应用 TCP_CORK 合并头部与文件"),
+        CONFIG_FIELD("uring.enable", uring, "子 Reactor 使用 io_uring，需要 sub_reactors > 0"),
+        CONFIG_FIELD("uring.sqpoll", uringSqpoll, "内核线程轮询提交队列"),
+        CONFIG_FIELD("uring.entries", uringEntries, "提交队列长度"),
+        CONFIG_FIELD("uring.buffers", uringBuffers, "recv 提供缓冲区块数（取整为 2 的幂）"),
+        CONFIG_FIELD("uring.buffer_size", uringBufferSize, "每块提供缓冲区大小"),
+        CONFIG_FIELD("threadpool.threads", threads, "工作线程数"),
+        CONFIG_FIELD("threadpool.queue_size", queueSize, "每个工作线程的无锁队列容量，都满时溢出到加锁队列"),
+        CONFIG_FIELD("mysql.host", sqlHost, "数据库地址"),
+        CONFIG_FIELD("mysql.port", sqlPort, "数据库端口"),
+        CONFIG_FIELD("mysql.user", sqlUser, "用户名"),
+        CONFIG_FIELD("mysql.password", sqlPwd, "密码"),
+        CONFIG_FIELD("mysql.database", dbName, "库名"),
+        CONFIG_FIELD("mysql.pool_size", connPoolNum, "连接数（也是数据库线程数）"),
+        CONFIG_FIELD("log.enable", openLog, "是否写日志"),
+        CONFIG_FIELD("log.level", logLevel, "0 debug, 1 info, 2 warn, 3 error"),
+        CONFIG_FIELD("log.queue_size", logQueSize, "异步日志最多积压的 64KB 缓冲区数，超出时丢弃并计数；0 为同步写"),
+        CONFIG_FIELD("log.dir", logDir, "日志目录"),
+        CONFIG_FIELD("buffer.init_size", initBuffSize, "连接读缓冲区初始大小"),
+        CONFIG_FIELD("cache.file_entries", fileCacheEntries, "文件缓存最大条目数"),
+        CONFIG_FIELD("cache.file_bytes", fileCacheBytes, "文件缓存最大映射字节数"),
+        CONFIG_FIELD("cache.file_ttl_ms", fileCacheTtlMS, "文件缓存 TTL，0 只靠 inotify"),
+        CONFIG_FIELD("cache.mmap_limit", mmapLimit, "超过它的文件用 sendfile"),
+        CONFIG_FIELD("cache.max_age", cacheMaxAge, "按类型覆盖 Cache-Control max-age，如 text/css=86400,image/*=604800，负数不发送"),
+        CONFIG_FIELD("cache.compress_bytes", compressCacheBytes, "压缩结果缓存字节数"),
+        CONFIG_FIELD("cache.compress_min_len", compressMinLen, "值得压缩的最小文件长度"),
+        CONFIG_FIELD("cache.user_entries", userCacheEntries, "用户缓存条目数"),
+        CONFIG_FIELD("cache.user_ttl_ms", userCacheTtlMS, "用户缓存 TTL"),
+        CONFIG_FIELD("cache.user_negative_ttl_ms", userCacheNegativeTtlMS, "查无此人结果的 TTL"),
+        CONFIG_FIELD("metrics.enable", metrics, "记录各阶段耗时和计数"),
+        CONFIG_FIELD("metrics.path", metricsPath, "指标的请求路径"),
+    };
+    return fields;
+}
+
+#undef CONFIG_FIELD
+
+bool Config::Set(const string& key, const string& value, string* err) {
+    for(const Field_& field: Fields_()) {
+        if(key == field.key) {
+            if(!field.set(*this, value)) {
+                *err = "invalid value for " + key + ": " + value;
+                return false;
+            }
+            return true;
+        }
+    }
+    *err = "unknown key: " + key;
+    return false;
+}
+
+bool Config::Load(const string& path, string* err) {
+    FILE* fp = fopen(path.c_str(), "r");
+    if(!fp) {
+        *err = path + ": " + strerror(errno);
+        return false;
+    }
+    string section;
+    char line[4096];
+    int lineNo = 0;
+    bool ok = true;
+    while(ok && fgets(line, sizeof(line), fp)) {
+        lineNo++;
+        string text = Trim(line);
+        if(text.empty() || text[0] == '#' || text[0] == ';') {
+            continue;
+        }
+        string where = path + ":" + to_string(lineNo) + ": ";
+        if(text[0] == '[') {
+            if(text.back() != ']') {
+                *err = where + "bad section";
+                ok = false;
+            }
+            section = Trim(text.substr(1, text.size() - 2));
+            continue;
+        }
+        size_t eq = text.find('=');
+        if(eq == string::npos) {
+            *err = where + "expect key = value";
+            ok = false;
+            continue;
+        }
+        string key = Trim(text.substr(0, eq)), value = Trim(text.substr(eq + 1));
+        if(value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+            value = value.substr(1, value.size() - 2);  // 允许用引号包住含空格或 # 的值
+        }
+        if(!Set(section.empty() ? key : section + "." + key, value, err)) {
+            *err = where + *err;
+            ok = false;
+        }
+    }
+    fclose(fp);
+    return ok;
+}
+
+bool Config::ParseArgs(int argc, char* argv[], string* err) {
+    /* 先找到配置文件，命令行里的其他参数无论写在前后都覆盖文件中的值 */
+    string path;
+    vector<pair<string, string>> overrides;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        string key, value;
+        bool hasValue = false;
+        if(arg == "-c") {
+            key = "config";
+        } else if(arg.compare(0, 2, "--") == 0) {
+            size_t eq = arg.find('=');
+            key = arg.substr(2, eq == string::npos ? string::npos : eq - 2);
+            if(eq != string::npos) {
+                value = arg.substr(eq + 1);
+                hasValue = true;
+            }
+        } else {
+            *err = "unexpected argument: " + arg;
+            return false;
+        }
+        if(!hasValue) {
+            if(i + 1 >= argc) {
+                *err = "missing value for " + arg;
+                return false;
+            }
+            value = argv[++i];
+        }
+        if(key == "config") {
+            path = value;
+        } else {
+            overrides.emplace_back(key, value);
+        }
+    }
+    if(path.empty() && access("server.conf", R_OK) == 0) {
+        path = "server.conf";
+    }
+    if(!path.empty() && !Load(path, err)) {
+        return false;
+    }
+    for(const auto& kv: overrides) {
+        if(!Set(kv.first, kv.second, err)) {
+            return false;
+        }
+    }
+    return Validate(err);
+}
+
+bool Config::Validate(string* err) const {
+    if(port < 1024 || port > 65535) { *err = "server.port must be in [1024, 65535]"; }
+    else if(trigMode < 0 || trigMode > 3) { *err = "server.trig_mode must be 0..3"; }
+    else if(subReactors < 0) { *err = "server.sub_reactors must be >= 0"; }
+    else if(backlog <= 0) { *err = "server.backlog must be > 0"; }
+    else if(acceptBatch <= 0) { *err = "server.accept_batch must be > 0"; }
+    else if(maxFd <= 0) { *err = "server.max_fd must be > 0"; }
+    else if(maxEvents <= 0) { *err = "server.max_events must be > 0"; }
+    else if(shutdownTimeoutMS < 0) { *err = "server.shutdown_timeout_ms must be >= 0"; }
+    else if(tcpDeferAccept < 0) { *err = "tcp.defer_accept must be >= 0"; }
+    else if(tcpFastOpen < 0) { *err = "tcp.fastopen must be >= 0"; }
+    else if(uring && subReactors == 0) { *err = "uring.enable requires server.sub_reactors > 0"; }
+    else if(uringEntries <= 0 || uringEntries > 32768) { *err = "uring.entries must be in [1, 32768]"; }
+    else if(uringBuffers <= 0 || uringBuffers > 32768) { *err = "uring.buffers must be in [1, 32768]"; }
+    else if(uringBufferSize == 0 || uringBufferSize > (1u << 30)) { *err = "uring.buffer_size must be in (0, 1G]"; }
+    else if(threads <= 0) { *err = "threadpool.threads must be > 0"; }
+    else if(queueSize <= 0) { *err = "threadpool.queue_size must be > 0"; }
+    else if(connPoolNum <= 0) { *err = "mysql.pool_size must be > 0"; }
+    else if(logLevel < 0 || logLevel > 3) { *err = "log.level must be 0..3"; }
+    else if(logQueSize < 0) { *err = "log.queue_size must be >= 0"; }
+    else if(initBuffSize == 0) { *err = "buffer.init_size must be > 0"; }
+    else if(fileCacheEntries == 0) { *err = "cache.file_entries must be > 0"; }
+    else if(userCacheEntries == 0) { *err = "cache.user_entries must be > 0"; }
+    else if(metricsPath.empty() || metricsPath[0] != '/') { *err = "metrics.path must start with /"; }
+    else { return true; }
+    return false;
+}
+
+string Config::Dump() const {
+    string out, section;
+    for(const Field_& field: Fields_()) {
+        string key = field.key;
+        size_t dot = key.find('.');
+        if(key.compare(0, dot, section) != 0 || section.size() != dot) {
+            section = key.substr(0, dot);
+            out += (out.empty() ? "[" : "\n[") + section + "]\n";
+        }
+        string value = field.get(*this);
+        if(Trim(value) != value || (!value.empty() && value.front() == '"')) {
+            value = '"' + value + '"';  // 首尾有空白的值加引号，重新加载时不被裁掉
+        }
+        out += key.substr(dot + 1) + " = " + value + "\n";
+    }
+    return out;
+}
+
+void Config::Usage(const char* prog) {
+    Config defaults;
+    printf("usage: %s [-c server.conf] [--print-config] [--section.key=value ...]\n\n", prog);
+    for(const Field_& field: Fields_()) {
+        printf("  --%-28s %s (default: %s)\n", field.key, field.help, field.get(defaults).c_str());
+    }
+}
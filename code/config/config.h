@@ -0,0 +1,108 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <string>
+#include <vector>
+#include <utility>    // pair
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>   // INT_MAX
+#include <unistd.h>   // access
+
+/* 服务器的全部可调参数。端口、触发模式、超时、数据库、线程数、日志开关和等级的默认值
+   与原先写死在 main.cpp 里的一致；其余默认值有意改过：listen backlog 由 6 改为 1024，
+   定时器默认用时间轮（原先是小根堆），默认开启 TCP_DEFER_ACCEPT 1 秒和 TCP_NODELAY，
+   log.queue_size 的单位由日志行改为 64KB 缓冲区，其余都是新增的参数。
+   依次被配置文件和命令行覆盖：默认值 < 配置文件 < 命令行。
+   配置文件为 INI 格式，[section] 下写 key = value，# 或 ; 开头为注释；
+   命令行用 --section.key=value 或 --section.key value，-c/--config 指定配置文件 */
+struct Config {
+    /* [server] */
+    int port = 1316;  // 监听端口
+    int trigMode = 3;  // 0: LT+LT, 1: 连接 ET, 2: 监听 ET, 3: ET+ET
+    int timeoutMS = 60000;  // 空闲连接超时，<= 0 不超时
+    bool optLinger = false;  // SO_LINGER 优雅关闭
+    int subReactors = 0;  // 子 Reactor 数量，0 为单 Reactor + 线程池
+    bool reusePort = true;  // 子 Reactor 各自持有 SO_REUSEPORT 监听套接字
+    bool timingWheel = true;  // 时间轮定时器，否则小根堆
+    int backlog = 1024;  // listen 的 backlog，内核以 net.core.somaxconn 为上限
+    int acceptBatch = 64;  // 每次监听事件最多接受的连接数
+    int maxFd = 65536;  // 连接表大小，fd 超过它的连接被拒绝
+    int maxEvents = 1024;  // 每次 epoll_wait 最多取回的事件数
+    std::string resourceDir;  // 静态资源目录，空表示工作目录下的 resources/
+    int shutdownTimeoutMS = 10000;  // 收到 SIGTERM/SIGINT 后等待进行中的响应发完的时间
+    std::string upgradeSocket;  // 平滑升级用的 UNIX 套接字路径，空表示不启用
+
+    /* [tcp] */
+    int tcpDeferAccept = 1;  // TCP_DEFER_ACCEPT 秒数，握手后等到请求数据再交给 accept，0 不启用
+    int tcpFastOpen = 0;  // TCP_FASTOPEN 队列长度，0 不启用（SYN 中的请求可能被重放）
+    bool tcpNoDelay = true;  // 连接上设置 TCP_NODELAY
+    bool tcpCork = true;  // 头部与 sendfile 的文件内容用 TCP_CORK 合并发送
+
+    /* [uring] */
+    bool uring = false;  // 子 Reactor 使用 io_uring，内核不支持时退回 epoll
+    bool uringSqpoll = false;  // 内核线程轮询提交队列，会多占一个 CPU
+    int uringEntries = 1024;  // 每个子 Reactor 的提交队列长度
+    int uringBuffers = 1024;  // 每个子 Reactor 的 recv 提供缓冲区块数
+    size_t uringBufferSize = 16 << 10;  // 每块大小
+
+    /* [threadpool] */
+    int threads = 6;  // 单 Reactor 模式下的工作线程数
+    int queueSize = 1024;  // 每个工作线程的任务队列容量
+
+    /* [mysql] */
+    std::string sqlHost = "localhost";
+    int sqlPort = 3306;
+    std::string sqlUser = "root";
+    std::string sqlPwd = "root";
+    std::string dbName = "webserver";
+    int connPoolNum = 12;  // 连接数，同时也是数据库线程数
+
+    /* [log] */
+    bool openLog = true;
+    int logLevel = 1;
+    int logQueSize = 1024;  // 异步日志最多积压的 64KB 缓冲区数，0 为同步写
+    std::string logDir = "./log";
+
+    /* [buffer] */
+    size_t initBuffSize = 1024;  // 连接读缓冲区第一次申请的大小
+
+    /* [cache] */
+    size_t fileCacheEntries = 1024;
+    size_t fileCacheBytes = 256 << 20;  // 映射文件的总字节数
+    int fileCacheTtlMS = 0;  // 0 表示只靠 inotify 失效
+    size_t mmapLimit = 128 << 10;  // 更大的文件用 sendfile
+    std::vector<std::pair<std::string, int>> cacheMaxAge;  // 覆盖某些 MIME 类型的 Cache-Control max-age，空为内置策略
+    size_t compressCacheBytes = 32 << 20;
+    size_t compressMinLen = 256;
+    size_t userCacheEntries = 10000;
+    int userCacheTtlMS = 60000;
+    int userCacheNegativeTtlMS = 5000;
+
+    /* [metrics] */
+    bool metrics = true;  // 记录各阶段耗时和计数
+    std::string metricsPath = "/metrics";  // 输出 Prometheus 文本的请求路径
+
+    bool Load(const std::string& path, std::string* err);  // 读取配置文件，出错时 err 为 "文件:行号: 原因"
+    bool ParseArgs(int argc, char* argv[], std::string* err);
+    // 先加载 -c 指定的文件（没有指定时若 ./server.conf 存在则加载它），再应用其余的命令行覆盖
+    bool Set(const std::string& key, const std::string& value, std::string* err);  // key 为 section.key
+    bool Validate(std::string* err) const;  // 检查取值范围
+    std::string Dump() const;  // 以配置文件格式输出当前取值
+
+    static void Usage(const char* prog);
+
+private:
+    struct Field_ {
+        const char* key;  // section.key
+        const char* help;
+        std::function<bool(Config&, const std::string&)> set;
+        std::function<std::string(const Config&)> get;
+    };
+    static const std::vector<Field_>& Fields_();
+};
+
+#endif //CONFIG_H
@@ -0,0 +1,124 @@
+#include "compresscache.h"
+
+using namespace std;
+
+CompressCache::CompressCache() {
+    maxBytes_ = 32 << 20;
+    minLen_ = 256;
+    bytes_ = 0;
+    hits_ = misses_ = 0;
+}
+
+CompressCache* CompressCache::Instance() {
+    static CompressCache inst;
+    return &inst;
+}
+
+void CompressCache::Init(size_t maxBytes, size_t minLen) {
+    lock_guard<mutex> locker(mtx_);
+    maxBytes_ = maxBytes;
+    minLen_ = minLen;
+    Evict_();
+    LOG_INFO("CompressCache maxBytes: %zu, minLen: %zu", maxBytes_, minLen_);
+}
+
+shared_ptr<const EncodedEntry> CompressCache::Get(const shared_ptr<const FileEntry>& file, bool br) {
+    assert(file);
+    if(!file->compressible || !file->data || static_cast<size_t>(file->st.st_size) < minLen_) {
+        return nullptr;  // 大文件走 sendfile，不读进用户态压缩
+    }
+    Key_ key = { file->st.st_dev, file->st.st_ino,
+                 int64_t(file->st.st_mtim.tv_sec) * 1000000000 + file->st.st_mtim.tv_nsec,
+                 file->st.st_size, br };
+    {
+        lock_guard<mutex> locker(mtx_);
+        auto it = cache_.find(key);
+        if(it != cache_.end()) {
+            hits_++;
+            lru_.splice(lru_.begin(), lru_, it->second.pos);  // 命中：移到 LRU 头部
+            return it->second.entry;
+        }
+        misses_++;
+    }
+
+    /* 未命中：不持锁压缩，省不到一成的不用压缩表示 */
+    string out;
+    shared_ptr<EncodedEntry> enc;
+    size_t len = file->st.st_size;
+    if((br ? Brotli_(file->data, len, out) : Gzip_(file->data, len, out)) && out.size() < len / 10 * 9) {
+        string etag = file->etag;
+        etag.insert(etag.size() - 1, br ? "-br" : "-gz");  // 插在结尾的引号前
+        enc = make_shared<EncodedEntry>(br ? "br" : "gzip", std::move(etag));
+        enc->data = std::move(out);
+        enc->data.shrink_to_fit();
+        enc->MakeHeader(*file);
+    }
+    size_t bytes = enc ? enc->data.size() : 0;
+    lock_guard<mutex> locker(mtx_);
+    auto it = cache_.find(key);
+    if(it != cache_.end()) {
+        return it->second.entry;  // 其他线程已经压缩过，丢弃这一份
+    }
+    if(bytes > maxBytes_) {
+        return enc;
+    }
+    lru_.push_front(key);
+    cache_[key] = { enc, lru_.begin() };
+    bytes_ += bytes;
+    Evict_();
+    return enc;
+}
+
+void CompressCache::Evict_() {
+    /* 不值得压缩的记录不占字节，按条数限制在与文件缓存同一量级 */
+    while((bytes_ > maxBytes_ || cache_.size() > 4096) && !lru_.empty()) {
+        auto it = cache_.find(lru_.back());
+        bytes_ -= it->second.entry ? it->second.entry->data.size() : 0;
+        cache_.erase(it);
+        lru_.pop_back();
+    }
+}
+
+void CompressCache::Clear() {
+    lock_guard<mutex> locker(mtx_);
+    cache_.clear();
+    lru_.clear();
+    bytes_ = 0;
+}
+
+CompressCache::Stats CompressCache::GetStats() {
+    lock_guard<mutex> locker(mtx_);
+    return { hits_, misses_, bytes_ };
+}
+
+bool CompressCache::Gzip_(const char* data, size_t len, string& out) {
+    z_stream zs = {};
+    if(deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;  // windowBits + 16 输出 gzip 格式
+    }
+    out.resize(deflateBound(&zs, len));
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = len;
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+bool CompressCache::Brotli_(const char* data, size_t len, string& out) {
+    size_t outLen = BrotliEncoderMaxCompressedSize(len);
+    if(outLen == 0) {
+        return false;
+    }
+    out.resize(outLen);
+    /* 质量 9：压缩率接近最高档，耗时只有 11 档的零头，首次请求等得起 */
+    if(!BrotliEncoderCompress(9, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, len,
+                              reinterpret_cast<const uint8_t*>(data), &outLen,
+                              reinterpret_cast<uint8_t*>(&out[0]))) {
+        return false;
+    }
+    out.resize(outLen);
+    return true;
+}
@@ -0,0 +1,80 @@
+#ifndef COMPRESS_CACHE_H
+#define COMPRESS_CACHE_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <assert.h>
+#include <zlib.h>            // gzip
+#include <brotli/encode.h>   // br
+
+#include "filecache.h"
+
+/* 现场压缩的结果缓存：以文件身份（设备、inode、mtime、大小）加编码为键，按字节数 LRU 淘汰。
+   文件改动后身份随之变化，旧结果不会再被命中，之后自然被淘汰。
+   命中只是一次查表；未命中时在调用线程压缩一次，压缩后没有明显变小的也记下，不会反复尝试 */
+class CompressCache {
+public:
+    struct Stats {
+        size_t hits;
+        size_t misses;  // 每次未命中都压缩了一次
+        size_t bytes;   // 当前缓存的压缩体字节数
+    };
+
+    static CompressCache* Instance();
+
+    void Init(size_t maxBytes = 32 << 20, size_t minLen = 256);
+    // 最大缓存字节数、值得压缩的最小文件长度
+
+    std::shared_ptr<const EncodedEntry> Get(const std::shared_ptr<const FileEntry>& file, bool br);
+    // 文件的 br 或 gzip 表示；只处理已映射到内存的可压缩文件，不适合压缩时返回 nullptr
+
+    void Clear();
+    Stats GetStats();
+
+private:
+    CompressCache();
+    ~CompressCache() = default;
+
+    struct Key_ {
+        dev_t dev;
+        ino_t ino;
+        int64_t mtime;  // 纳秒
+        off_t size;
+        bool br;
+        bool operator==(const Key_& other) const {
+            return dev == other.dev && ino == other.ino && mtime == other.mtime
+                && size == other.size && br == other.br;
+        }
+    };
+
+    struct KeyHash_ {
+        size_t operator()(const Key_& key) const {
+            size_t h = std::hash<uint64_t>()(key.ino) ^ (std::hash<int64_t>()(key.mtime) << 1);
+            return h ^ (std::hash<uint64_t>()(key.dev) << 2) ^ key.br;
+        }
+    };
+
+    struct Node_ {
+        std::shared_ptr<const EncodedEntry> entry;  // nullptr 表示不值得压缩
+        std::list<Key_>::iterator pos;  // 在 lru_ 中的位置
+    };
+
+    static bool Gzip_(const char* data, size_t len, std::string& out);
+    static bool Brotli_(const char* data, size_t len, std::string& out);
+    void Evict_();
+
+    size_t maxBytes_;
+    size_t minLen_;
+    size_t bytes_;
+    size_t hits_, misses_;
+
+    std::unordered_map<Key_, Node_, KeyHash_> cache_;
+    std::list<Key_> lru_;  // 头部为最近使用
+
+    std::mutex mtx_;
+};
+
+#endif //COMPRESS_CACHE_H
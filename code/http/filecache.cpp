@@ -0,0 +1,407 @@
+#include "filecache.h"
+
+using namespace std;
+
+const unordered_map<string, string> FileCache::SUFFIX_TYPE = {
+    { ".html",  "text/html" },
+    { ".xml",   "text/xml" },
+    { ".xhtml", "application/xhtml+xml" },
+    { ".txt",   "text/plain" },
+    { ".rtf",   "application/rtf" },
+    { ".pdf",   "application/pdf" },
+    { ".word",  "application/nsword" },
+    { ".png",   "image/png" },
+    { ".gif",   "image/gif" },
+    { ".jpg",   "image/jpeg" },
+    { ".jpeg",  "image/jpeg" },
+    { ".au",    "audio/basic" },
+    { ".mpeg",  "video/mpeg" },
+    { ".mpg",   "video/mpeg" },
+    { ".avi",   "video/x-msvideo" },
+    { ".gz",    "application/x-gzip" },
+    { ".tar",   "application/x-tar" },
+    { ".css",   "text/css" },
+    { ".js",    "text/javascript" },
+    { ".svg",   "image/svg+xml" },
+    { ".ico",   "image/x-icon" },
+    { ".woff",  "font/woff" },
+    { ".woff2", "font/woff2" },
+    { ".ttf",   "font/ttf" },
+    { ".otf",   "font/otf" },
+    { ".eot",   "application/vnd.ms-fontobject" },
+};  // 文件后缀名对应的类型
+
+FileEntry::~FileEntry() {
+    if(data) {
+        munmap(data, st.st_size);
+    }
+    if(fd >= 0) {
+        close(fd);
+    }
+}
+
+FileCache::FileCache() {
+    maxEntries_ = 1024;
+    maxBytes_ = 256 << 20;
+    bytes_ = 0;
+    mmapLimit_ = 128 << 10;
+    ttlMS_ = 1000;  // 未 Init 时没有 inotify，靠 TTL 兜底
+    inotifyFd_ = -1;
+    stopFd_ = -1;
+    gen_ = 0;
+    maxAge_ = {
+        { "text/html", 0 },  // 页面每次都带校验器重新验证，通常只得到 304
+        { "text/css", 86400 },
+        { "text/javascript", 86400 },
+        { "image/*", 604800 },
+        { "font/*", 604800 },
+        { "application/vnd.ms-fontobject", 604800 },
+    };  // 没有匹配的类型不发送 Cache-Control，由浏览器按 Last-Modified 自行推断
+}
+
+FileCache::~FileCache() {
+    if(watchThread_ && watchThread_->joinable()) {
+        uint64_t one = 1;
+        ssize_t ret = write(stopFd_, &one, sizeof(one));
+        (void)ret;
+        watchThread_->join();
+    }
+    if(inotifyFd_ >= 0) { close(inotifyFd_); }
+    if(stopFd_ >= 0) { close(stopFd_); }
+    Clear();
+}
+
+FileCache* FileCache::Instance() {
+    static FileCache inst;
+    return &inst;
+}
+
+void FileCache::Init(size_t maxEntries, size_t maxBytes, int ttlMS, size_t mmapLimit) {
+    assert(maxEntries > 0);
+    lock_guard<mutex> locker(mtx_);
+    maxEntries_ = maxEntries;
+    maxBytes_ = maxBytes;
+    mmapLimit_ = mmapLimit;
+    ttlMS_ = ttlMS;
+    if(inotifyFd_ < 0) {
+        inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        stopFd_ = eventfd(0, EFD_CLOEXEC);
+        if(inotifyFd_ < 0 || stopFd_ < 0) {
+            LOG_WARN("FileCache inotify unavailable, fall back to TTL");
+            if(inotifyFd_ >= 0) { close(inotifyFd_); }
+            inotifyFd_ = -1;
+        } else {
+            watchThread_.reset(new thread(&FileCache::WatchThread_, this));
+        }
+    }
+    if(inotifyFd_ < 0 && ttlMS_ <= 0) {
+        ttlMS_ = 1000;  // 既没有 inotify 也没有 TTL 时，修改后的文件永远不会失效
+    }
+    LOG_INFO("FileCache maxEntries: %zu, maxBytes: %zu, mmapLimit: %zu, ttl: %dms, inotify: %s",
+             maxEntries_, maxBytes_, mmapLimit_, ttlMS_, inotifyFd_ >= 0 ? "on" : "off");
+}
+
+shared_ptr<const FileEntry> FileCache::Get(const string& path) {
+    {
+        lock_guard<mutex> locker(mtx_);
+        auto it = cache_.find(path);
+        if(it != cache_.end()) {
+            const shared_ptr<FileEntry>& entry = it->second.entry;
+            if(ttlMS_ <= 0 || chrono::steady_clock::now() - entry->loadTime < chrono::milliseconds(ttlMS_)) {
+                lru_.splice(lru_.begin(), lru_, it->second.pos);  // 命中：移到 LRU 头部
+                return entry;
+            }
+            Erase_(path);  // TTL 过期
+        }
+    }
+
+    /* 未命中：先监听目录、记下失效代数，再不持锁做文件 IO。
+       载入期间文件发生变化时，事件要么在插入之后到达、删掉刚插入的条目，
+       要么已经处理过、代数变了，这一份只给本次请求用，不进入缓存 */
+    uint64_t gen;
+    {
+        lock_guard<mutex> locker(mtx_);
+        Watch_(path);
+        gen = gen_;
+    }
+    shared_ptr<FileEntry> entry = Load_(path);
+    if(!entry) {
+        return nullptr;
+    }
+    size_t size = entry->data ? entry->st.st_size : 0;
+    lock_guard<mutex> locker(mtx_);
+    auto it = cache_.find(path);
+    if(it != cache_.end()) {
+        return it->second.entry;  // 其他线程已经载入，丢弃这一份
+    }
+    if(size > maxBytes_ || gen != gen_) {
+        return entry;  // 单个文件超过容量，或载入期间有过失效：不进入缓存，由响应独占
+    }
+    lru_.push_front(path);
+    cache_[path] = { entry, lru_.begin() };
+    bytes_ += size;
+    Evict_();
+    return entry;
+}
+
+void FileCache::Invalidate(const string& path) {
+    lock_guard<mutex> locker(mtx_);
+    gen_++;
+    Erase_(path);
+}
+
+void FileCache::Clear() {
+    lock_guard<mutex> locker(mtx_);
+    gen_++;
+    cache_.clear();
+    lru_.clear();
+    bytes_ = 0;
+}
+
+vector<string> FileCache::HotPaths(size_t max) {
+    vector<string> paths;
+    lock_guard<mutex> locker(mtx_);
+    for(const string& path: lru_) {
+        if(paths.size() >= max) { break; }
+        auto it = cache_.find(path);  // 只读查找，不为 LRU 中的路径插入空表项
+        if(it != cache_.end() && it->second.entry) { paths.push_back(path); }
+    }
+    return paths;
+}
+
+string FileCache::ResolvePath(const string& dir, const string& path) {
+    string res = dir;
+    while(!res.empty() && res.back() == '/') { res.pop_back(); }
+    size_t root = res.size();  // 不允许 .. 回退到这里之前
+    size_t i = 0, n = path.size();
+    while(i < n) {
+        size_t j = path.find('/', i);
+        if(j == string::npos) { j = n; }
+        size_t len = j - i;
+        if(len == 0 || (len == 1 && path[i] == '.')) {
+            /* 空段和 . 直接跳过 */
+        }
+        else if(len == 2 && path[i] == '.' && path[i + 1] == '.') {
+            size_t pos = res.rfind('/');
+            if(res.size() > root && pos != string::npos && pos >= root) {
+                res.resize(pos);
+            }
+        }
+        else {
+            res += '/';
+            res.append(path, i, len);
+        }
+        i = j + 1;
+    }
+    return res;
+}
+
+shared_ptr<FileEntry> FileCache::Load_(const string& path) {
+    shared_ptr<FileEntry> entry = make_shared<FileEntry>();
+    entry->loadTime = chrono::steady_clock::now();
+    entry->fd = open(path.data(), O_RDONLY | O_CLOEXEC);
+    if(entry->fd < 0) {
+        /* 打不开（比如没有读权限）时仍保留 stat 信息，由响应决定 403/404 */
+        if(stat(path.data(), &entry->st) < 0) {
+            return nullptr;
+        }
+        return entry;
+    }
+    if(fstat(entry->fd, &entry->st) < 0) {
+        return nullptr;
+    }
+    if(!S_ISREG(entry->st.st_mode)) {
+        close(entry->fd);
+        entry->fd = -1;
+        return entry;
+    }
+    entry->type = ContentType(path);
+    entry->compressible = IsCompressible(entry->type);
+    shared_ptr<EncodedEntry> br, gz;
+    if(path.size() < 3 || (path.compare(path.size() - 3, 3, ".br") && path.compare(path.size() - 3, 3, ".gz"))) {
+        entry->br = br = Sibling_(*entry, path, ".br", "br");
+        entry->gz = gz = Sibling_(*entry, path, ".gz", "gzip");
+    }
+    MakeHeader_(*entry);
+    if(br) { br->MakeHeader(*entry); }  // 压缩表示的响应头依赖原文件的 cacheLines
+    if(gz) { gz->MakeHeader(*entry); }
+    if((entry->st.st_mode & S_IROTH) && entry->st.st_size > 0
+            && static_cast<size_t>(entry->st.st_size) <= mmapLimit_) {
+        /* 将文件映射到内存提高文件的访问速度
+            MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
+        void* mmRet = mmap(0, entry->st.st_size, PROT_READ, MAP_PRIVATE, entry->fd, 0);
+        if(mmRet == MAP_FAILED) {
+            LOG_ERROR("mmap %s error!", path.data());
+        } else {
+            entry->data = static_cast<char*>(mmRet);
+        }
+    }
+    return entry;
+}
+
+void FileCache::MakeHeader_(FileEntry& entry) const {
+    /* 响应头里只与文件有关的部分，载入时生成一次，命中时直接整段拷贝 */
+    char buf[128];
+    uint64_t mtime = uint64_t(entry.st.st_mtim.tv_sec) * 1000000000 + entry.st.st_mtim.tv_nsec;
+    snprintf(buf, sizeof(buf), "\"%lx-%lx-%lx\"", (unsigned long)entry.st.st_ino,
+             (unsigned long)mtime, (unsigned long)entry.st.st_size);
+    entry.etag = buf;
+    struct tm tm;
+    gmtime_r(&entry.st.st_mtim.tv_sec, &tm);
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    entry.lastModified = buf;
+
+    entry.cacheLines = "Last-Modified: " + entry.lastModified + "\r\n";
+    int maxAge = MaxAge_(entry.type);
+    if(maxAge >= 0) {
+        entry.cacheLines += "Cache-Control: max-age=" + to_string(maxAge) + "\r\n";
+    }
+    if(entry.compressible || entry.br || entry.gz) {
+        entry.cacheLines += "Vary: Accept-Encoding\r\n";  // 响应体随 Accept-Encoding 变化
+    }
+    entry.validators = "ETag: " + entry.etag + "\r\n" + entry.cacheLines;
+    entry.header = string("Content-type: ") + entry.type + "\r\n" + entry.validators
+                   + "Accept-Ranges: bytes\r\nContent-length: " + to_string(entry.st.st_size) + "\r\n\r\n";
+}
+
+int FileCache::MaxAge_(const string& type) const {
+    auto it = maxAge_.find(type);
+    if(it == maxAge_.end()) {
+        it = maxAge_.find(type.substr(0, type.find('/')) + "/*");
+    }
+    if(it == maxAge_.end()) {
+        it = maxAge_.find("*");
+    }
+    return it != maxAge_.end() ? it->second : -1;
+}
+
+void FileCache::SetMaxAge(const string& type, int seconds) {
+    {
+        lock_guard<mutex> locker(mtx_);
+        maxAge_[type] = seconds;
+    }
+    Clear();  // 已生成的响应头作废
+}
+
+shared_ptr<EncodedEntry> FileCache::Sibling_(const FileEntry& entry, const string& path,
+                                             const char* suffix, const char* encoding) {
+    struct stat st;
+    if(stat((path + suffix).data(), &st) < 0) {
+        return nullptr;  // 原文件载入时检查一次，兄弟文件增删时 inotify 会让原文件一起失效
+    }
+    shared_ptr<const FileEntry> file = Get(path + suffix);
+    if(!file || !S_ISREG(file->st.st_mode) || !(file->st.st_mode & S_IROTH) || (!file->data && file->fd < 0)
+       || file->st.st_mtim.tv_sec < entry.st.st_mtim.tv_sec) {
+        return nullptr;  // 读不了，或者比原文件旧（原文件改过但没有重新压缩）
+    }
+    shared_ptr<EncodedEntry> enc = make_shared<EncodedEntry>(encoding, file->etag);
+    enc->file = file;
+    return enc;
+}
+
+void EncodedEntry::MakeHeader(const FileEntry& base) {
+    validators = "ETag: " + etag + "\r\n" + base.cacheLines;
+    header = string("Content-type: ") + base.type + "\r\nContent-Encoding: " + encoding + "\r\n"
+             + validators + "Content-length: " + to_string(Len()) + "\r\n\r\n";
+}
+
+bool FileCache::IsCompressible(const char* type) {
+    static const unordered_set<string> TYPES = {
+        "application/xhtml+xml", "application/rtf", "image/svg+xml", "image/x-icon",
+        "font/ttf", "font/otf", "application/vnd.ms-fontobject",
+    };
+    return strncmp(type, "text/", 5) == 0 || TYPES.count(type);
+}
+
+const char* FileCache::ContentType(const string& path) {
+    string::size_type idx = path.find_last_of('.');
+    if(idx == string::npos || path.find('/', idx) != string::npos) {
+        return "text/plain";  // 没有后缀
+    }
+    auto it = SUFFIX_TYPE.find(path.substr(idx));
+    return it != SUFFIX_TYPE.end() ? it->second.c_str() : "text/plain";
+}
+
+void FileCache::Watch_(const string& path) {
+    if(inotifyFd_ < 0) { return; }
+    string dir = path.substr(0, path.rfind('/'));
+    if(dirWatch_.count(dir)) { return; }
+    int wd = inotify_add_watch(inotifyFd_, dir.data(),
+                IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+                IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF);
+    if(wd < 0) {
+        if(errno != ENOENT && errno != ENOTDIR) {  // 目录不存在时文件也载入不了，不用监听
+            LOG_WARN("inotify watch %s error!", dir.data());
+        }
+        return;
+    }
+    watchDir_[wd] = dir;
+    dirWatch_[dir] = wd;
+}
+
+void FileCache::Evict_() {
+    while((cache_.size() > maxEntries_ || bytes_ > maxBytes_) && !lru_.empty()) {
+        string victim = lru_.back();
+        Erase_(victim);
+    }
+}
+
+void FileCache::Erase_(const string& path) {
+    auto it = cache_.find(path);
+    if(it == cache_.end()) { return; }
+    const shared_ptr<FileEntry>& entry = it->second.entry;
+    bytes_ -= entry->data ? entry->st.st_size : 0;
+    lru_.erase(it->second.pos);
+    cache_.erase(it);  // 仍被响应引用的条目在最后一个引用释放时才解除映射
+}
+
+void FileCache::WatchThread_() {
+    alignas(struct inotify_event) char buff[4096];
+    struct pollfd fds[2] = { { inotifyFd_, POLLIN, 0 }, { stopFd_, POLLIN, 0 } };
+    while(true) {
+        if(poll(fds, 2, -1) < 0) {
+            if(errno == EINTR) { continue; }
+            break;
+        }
+        if(fds[1].revents) { break; }  // 退出通知
+        ssize_t len = read(inotifyFd_, buff, sizeof(buff));
+        if(len <= 0) { continue; }
+        lock_guard<mutex> locker(mtx_);
+        gen_++;  // 正在载入的文件可能受这批事件影响
+        for(char* p = buff; p < buff + len; ) {
+            struct inotify_event* ev = reinterpret_cast<struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + ev->len;
+            if(ev->mask & IN_Q_OVERFLOW) {
+                cache_.clear();  // 事件丢失，无法确定哪些文件变化
+                lru_.clear();
+                bytes_ = 0;
+                continue;
+            }
+            auto it = watchDir_.find(ev->wd);
+            if(it == watchDir_.end()) { continue; }
+            string dir = it->second;
+            if(ev->len > 0) {
+                string path = dir + "/" + ev->name;
+                Erase_(path);
+                size_t n = path.size();
+                if(n > 3 && (path.compare(n - 3, 3, ".br") == 0 || path.compare(n - 3, 3, ".gz") == 0)) {
+                    Erase_(path.substr(0, n - 3));  // 预压缩文件变化，原文件记录的兄弟文件要重新查找
+                }
+            }
+            if(ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                /* 目录本身变化：该目录下的条目全部失效 */
+                for(auto entry = cache_.begin(); entry != cache_.end(); ) {
+                    auto next = std::next(entry);
+                    if(entry->first.compare(0, dir.size() + 1, dir + "/") == 0) {
+                        Erase_(entry->first);
+                    }
+                    entry = next;
+                }
+            }
+            if(ev->mask & IN_IGNORED) {
+                dirWatch_.erase(dir);
+                watchDir_.erase(it);
+            }
+        }
+    }
+}
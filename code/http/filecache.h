@@ -0,0 +1,129 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <time.h>        // gmtime_r, strftime
+#include <unordered_map>
+#include <unordered_set>
+#include <string.h>      // strncmp
+#include <fcntl.h>       // open
+#include <unistd.h>      // close
+#include <poll.h>        // poll
+#include <sys/stat.h>    // stat
+#include <sys/mman.h>    // mmap, munmap
+#include <sys/eventfd.h> // eventfd
+#include <sys/inotify.h> // inotify
+
+#include "../log/log.h"
+
+struct EncodedEntry;
+
+/* 一个已打开的静态文件：描述符、只读映射和 stat 信息。
+   通过 shared_ptr 引用计数，被淘汰或失效后等最后一个响应释放时才 munmap/close */
+struct FileEntry {
+    FileEntry(): fd(-1), data(nullptr), st{}, type("text/plain"), compressible(false) {}
+    ~FileEntry();
+
+    int fd;          // 打开的文件描述符，-1 表示只有 stat 信息（无读权限或目录）
+    char* data;      // 只读映射，空文件或超过 mmapLimit 的大文件为 nullptr（走 sendfile）
+    struct stat st;  // 文件元信息
+    const char* type;  // MIME 类型，指向 FileCache 的静态表
+    bool compressible;  // 文本类型，可以现场压缩
+    std::string etag;  // "inode-mtime-size"，文件被替换或修改后必然变化
+    std::string lastModified;  // mtime 的 HTTP 日期
+    std::string cacheLines;  // Last-Modified、Cache-Control、Vary 头，各种编码的表示共用
+    std::string validators;  // 预先生成的 ETag + cacheLines，304 响应只发这些
+    std::string header;  // 预先生成的完整实体头（类型、校验器、Accept-Ranges、长度，以空行结尾），随条目一起失效
+    std::shared_ptr<const EncodedEntry> br, gz;  // 预压缩的兄弟文件 x.br / x.gz，没有时为空
+    std::chrono::steady_clock::time_point loadTime;  // 载入时间，用于 TTL 失效
+};
+
+/* 资源的一种压缩表示：预压缩的兄弟文件，或现场压缩后缓存在内存里的结果 */
+struct EncodedEntry {
+    EncodedEntry(const char* encoding, std::string etag): encoding(encoding), etag(std::move(etag)) {}
+
+    void MakeHeader(const FileEntry& base);  // 按原文件的类型和缓存策略生成响应头，先填好 file 或 data
+    size_t Len() const { return file ? file->st.st_size : data.size(); }
+
+    const char* encoding;  // "br" / "gzip"
+    std::string etag;  // 与原文件不同，缓存不会把压缩体当作原文
+    std::string validators;
+    std::string header;  // 完整实体头，带 Content-Encoding
+    std::shared_ptr<const FileEntry> file;  // 预压缩文件，数据来自它的映射区或描述符
+    std::string data;  // 现场压缩的结果
+};
+
+class FileCache {
+public:
+    static FileCache* Instance();
+
+    void Init(size_t maxEntries = 1024, size_t maxBytes = 256 << 20, int ttlMS = 0,
+              size_t mmapLimit = 128 << 10);
+    // 最大缓存文件数、最大映射字节数、TTL（毫秒，0 表示只依赖 inotify 失效）、
+    // mmap 阈值（更大的文件只缓存描述符，响应体用 sendfile 发送）
+
+    std::shared_ptr<const FileEntry> Get(const std::string& path);
+    // 命中时不产生任何文件系统调用；文件不存在返回 nullptr
+
+    void Invalidate(const std::string& path);  // 使某个路径失效
+    void Clear();  // 清空缓存
+    std::vector<std::string> HotPaths(size_t max);  // 最近使用的 max 个路径，平滑升级时交给新进程预热
+
+    void SetMaxAge(const std::string& type, int seconds);
+    // 设置某个 MIME 类型（或 "image/*"、"*"）的 Cache-Control max-age，负数表示不发送；
+    // 启动时、开始服务之前调用，已缓存的条目会被清掉
+
+    static const char* ContentType(const std::string& path);  // 按后缀名取 MIME 类型
+    static bool IsCompressible(const char* type);  // 文本类、字体等压缩有效的类型
+
+    static std::string ResolvePath(const std::string& dir, const std::string& path);
+    // 按字面规整 dir + path（合并 // . ..），结果不会越出 dir，作为缓存键
+
+private:
+    FileCache();
+    ~FileCache();
+
+    std::shared_ptr<FileEntry> Load_(const std::string& path);  // 打开、fstat、mmap
+    void MakeHeader_(FileEntry& entry) const;  // 生成校验器和实体头
+    std::shared_ptr<EncodedEntry> Sibling_(const FileEntry& entry, const std::string& path,
+                                           const char* suffix, const char* encoding);
+    // 比原文件新的预压缩兄弟文件
+    int MaxAge_(const std::string& type) const;  // 精确类型 > "主类型/*" > "*"
+    void Watch_(const std::string& path);  // 监听文件所在目录
+    void Evict_();  // 超出容量时按 LRU 淘汰
+    void Erase_(const std::string& path);
+    void WatchThread_();  // 读取 inotify 事件并失效对应条目
+
+    static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;  // 文件后缀名对应的类型
+
+    struct Node_ {
+        std::shared_ptr<FileEntry> entry;
+        std::list<std::string>::iterator pos;  // 在 lru_ 中的位置
+    };
+
+    size_t maxEntries_;
+    size_t maxBytes_;
+    size_t bytes_;  // 当前映射的总字节数
+    size_t mmapLimit_;
+    int ttlMS_;
+    std::unordered_map<std::string, int> maxAge_;  // MIME 类型 -> max-age 秒数
+
+    std::unordered_map<std::string, Node_> cache_;
+    std::list<std::string> lru_;  // 头部为最近使用
+    uint64_t gen_;  // 失效代数：每次失效加一，未命中时载入前后比较，载入期间有失效就不缓存
+
+    int inotifyFd_;
+    int stopFd_;  // eventfd，通知监听线程退出
+    std::unordered_map<int, std::string> watchDir_;  // watch descriptor -> 目录
+    std::unordered_map<std::string, int> dirWatch_;  // 目录 -> watch descriptor
+    std::unique_ptr<std::thread> watchThread_;
+
+    std::mutex mtx_;
+};
+
+#endif //FILE_CACHE_H
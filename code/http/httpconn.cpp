@@ -3,12 +3,21 @@ using namespace std;
 
 const char* HttpConn::srcDir;  // 资源的物理路径
 std::atomic<int> HttpConn::userCount;  // 连接的用户数量
+size_t HttpConn::initBuffSize = 1024;
+bool HttpConn::cork = true;
+std::atomic<bool> HttpConn::draining;
 bool HttpConn::isET;  // 是否使用 ET 模式
 
 HttpConn::HttpConn() { 
     fd_ = -1;   // 初始化文件描述符为 -1
+    gen_ = 0;
+    pins_ = 0;
     addr_ = { 0 };   // 初始化地址信息为全零
     isClose_ = true;  // 连接关闭
+    keepAlive_ = false;
+    served_ = false;
+    inputDrained_ = true;
+    interest_ = 0;
 };
 
 HttpConn::~HttpConn() { 
@@ -20,18 +29,35 @@ void HttpConn::init(int fd, const sockaddr_in& addr) {
     userCount++;  // 用户数量加一
     addr_ = addr;  // 保存客户端地址信息
     fd_ = fd;   // 保存文件描述符
-    writeBuff_.RetrieveAll();  // 清空写缓冲区
+    writeBuff_.Clear();  // 清空写缓冲区，上一个连接中途关闭时残留的块还给池
     readBuff_.RetrieveAll();  // 清空读缓冲区
+    readBuff_.Release();
+    readBuff_.SetHintSize(initBuffSize);  // 不沿用槽位上一个连接的缓冲区大小
+    request_.Init();  // 丢弃上一个连接残留的解析进度
+    keepAlive_ = false;
+    served_ = false;
+    inputDrained_ = true;
+    interest_ = 0;
     isClose_ = false;  // 连接未关闭
+    gen_.fetch_add(1, std::memory_order_release);  // 新连接：旧连接遗留的任务和定时器失效
+    openTime_ = Metrics::Now();
+    parseNs_ = 0;
+    Metrics::Instance()->Add(Metrics::CONN_ACCEPTED);
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(), (int)userCount);  // 记录连接信息
 }
 
 void HttpConn::Close() {
     response_.UnmapFile();  // 释放映射文件
+    writeBuff_.Clear();  // 未发完的块还给池，文件段持有的缓存引用随之释放
+    readBuff_.RetrieveAll();
+    readBuff_.Release();
     if(isClose_ == false){
         isClose_ = true;   // 标记连接为关闭
+        gen_.fetch_add(1, std::memory_order_release);  // 已投递但未执行的任务随之失效
         userCount--;  // 用户数量减一
         close(fd_);  // 关闭文件描述符
+        Metrics::Instance()->Add(Metrics::CONN_CLOSED);
+        Metrics::Instance()->Observe(Metrics::CONN_LIFETIME, Metrics::Now() - openTime_);
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIP(), GetPort(), (int)userCount);  // 记录断开连接信息
     }
 }
@@ -55,68 +81,137 @@ int HttpConn::GetPort() const {
 ssize_t HttpConn::read(int* saveErrno) {
     //  参数 saveErrno 用于传出错误码（如 EAGAIN、EWOULDBLOCK）
     ssize_t len = -1;
+    size_t total = 0, calls = 0;
+    bool drained = false;
     do {
-        len = readBuff_.ReadFd(fd_, saveErrno);
+        len = readBuff_.ReadFd(fd_, saveErrno, &drained);
+        calls++;
         if (len <= 0) {
             break;
         }
-    } while (isET);
-    // 如果启用了边缘触发模式（isET == true），则尽可能多地读取所有数据，防止漏事件
+        total += len;
+    } while (isET && !drained && readBuff_.ReadableBytes() < MAX_READ_BUFF);
+    inputDrained_ = drained || (len < 0 && *saveErrno == EAGAIN);
+    Metrics::Instance()->Add(Metrics::BYTES_READ, total);
+    Metrics::Instance()->Add(Metrics::READ_CALLS, calls);
+    // 如果启用了边缘触发模式（isET == true），则尽可能多地读取所有数据，防止漏事件；
+    // 一次读到的比空间少说明已经读空，不再多读一次等 EAGAIN；
+    // 积压到上限时先交给解析（请求体会被取走），重新注册 EPOLLIN 时还有数据会再次触发
     return len;
 }   // 客户端读取服务器数据
 
 ssize_t HttpConn::write(int* saveErrno) {
     ssize_t len = -1;  
+    StageTimer timer(Metrics::WRITE);
+    size_t before = ToWriteBytes(), calls = 0;
+    /* writev 的头部和紧接着的 sendfile 分两次交给内核，TCP_NODELAY 下头部会单独成一个小包；
+       期间塞住连接，取消时不满一帧的尾部立即发出 */
+    int corked = cork && writeBuff_.HasFile();
+    if(corked) { setsockopt(fd_, IPPROTO_TCP, TCP_CORK, &corked, sizeof(corked)); }
     do {
-        len = writev(fd_, iov_, iovCnt_);  //   通过套接字向缓存区来写  
-        // 实际写到客服端的数据长度 
+        len = writeBuff_.WriteFd(fd_, saveErrno);  // 响应头和映射的文件体一次 writev，文件区间用 sendfile
+        calls++;
         if(len <= 0) {
-            *saveErrno = errno;
             break;
         }
-        if(iov_[0].iov_len + iov_[1].iov_len  == 0) { break; }   //表示数据已全部发送完毕，退出循环
-        else if(static_cast<size_t>(len) > iov_[0].iov_len) {   // 如果写入的长度大于 iov_[0] 的长度
-            iov_[1].iov_base = (uint8_t*) iov_[1].iov_base + (len - iov_[0].iov_len);
-            iov_[1].iov_len -= (len - iov_[0].iov_len);
-            if(iov_[0].iov_len) {
-                writeBuff_.RetrieveAll();
-                iov_[0].iov_len = 0;
-            } //清空iov_[0]
-        }
-        else {
-            iov_[0].iov_base = (uint8_t*)iov_[0].iov_base + len; 
-            iov_[0].iov_len -= len; 
-            writeBuff_.Retrieve(len);  // 从写缓冲区中移除已发送的数据
-        }
-    } while(isET || ToWriteBytes() > 10240);
+    } while(ToWriteBytes() > 0);  // 写到全部发完或 EAGAIN，LT/ET 都从记录的位置续写
+    if(corked) {
+        int off = 0;
+        setsockopt(fd_, IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
+    }
+    Metrics::Instance()->Add(Metrics::BYTES_WRITTEN, before - ToWriteBytes());
+    Metrics::Instance()->Add(Metrics::WRITE_CALLS, calls);
     return len;
 }
 
+void HttpConn::Feed(const char* data, size_t len) {
+    readBuff_.Append(data, len);
+    Metrics::Instance()->Add(Metrics::BYTES_READ, len);
+    Metrics::Instance()->Add(Metrics::READ_CALLS);
+}
+
+void HttpConn::Written(size_t len) {
+    writeBuff_.Retrieve(len);
+    Metrics::Instance()->Add(Metrics::BYTES_WRITTEN, len);
+    Metrics::Instance()->Add(Metrics::WRITE_CALLS);
+}
+
 bool HttpConn::process() {
-    request_.Init();  // 初始化请求对象
-    if(readBuff_.ReadableBytes() <= 0) {
-        return false;
-    }  // 如果读缓冲区没有可读数据，返回 false
-    else if(request_.parse(readBuff_)) {
-        LOG_DEBUG("%s", request_.path().c_str());  // 解析请求路径
-        response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);  // 初始化响应对象
-    } else {
-        response_.Init(srcDir, request_.path(), false, 400);  // 如果解析失败，初始化响应对象为 400 错误
+    assert(ToWriteBytes() == 0);
+    size_t count = 0;
+    while(count < MAX_PIPELINE && !request_.IsVerifying() && readBuff_.ReadableBytes() > 0) {
+        int64_t start = Metrics::Now();
+        HttpRequest::HTTP_CODE ret = request_.parse(readBuff_);  // 请求不完整时保留解析进度
+        parseNs_ += Metrics::Now() - start;
+        if(ret != HttpRequest::NO_REQUEST) {
+            Metrics::Instance()->Observe(Metrics::PARSE, parseNs_);
+            parseNs_ = 0;
+        }
+        if(ret == HttpRequest::NO_REQUEST) {
+            if(request_.TakeContinue()) {
+                /* 请求头已收到，客户端在等服务器同意后才发送请求体 */
+                static const char CONTINUE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+                writeBuff_.Append(CONTINUE, sizeof(CONTINUE) - 1);
+                Metrics::Instance()->CountResponse(100);
+                keepAlive_ = true;  // 中间响应，发完后继续读请求体
+            }
+            break;  // 等待更多数据
+        }
+        else if(ret == HttpRequest::GET_REQUEST) {
+            if(request_.IsVerifying()) {
+                break;  // 等待数据库验证结果，已排队的响应先发出
+            }
+            LOG_DEBUG("%s", request_.path().c_str());  // 解析请求路径
+            response_.Init(srcDir, request_.path(), request_.IsKeepAlive() && !draining, 200);  // 初始化响应对象
+            if(request_.IsGetOrHead()) {
+                response_.SetConditional(request_.GetHeader("If-None-Match"),
+                                         request_.GetHeader("If-Modified-Since"));
+                response_.SetRange(request_.GetHeader("Range"), request_.GetHeader("If-Range"));
+                response_.SetAcceptEncoding(request_.GetHeader("Accept-Encoding"));
+                response_.SetHead(request_.IsHead());
+                if(Metrics::Enabled() && request_.path() == Metrics::Instance()->Path()) {
+                    response_.SetContent("text/plain; version=0.0.4; charset=utf-8", Metrics::Instance()->Render());
+                }  // 指标在内存中生成，不经过文件缓存
+            }
+        } else {
+            response_.Init(srcDir, request_.path(), false, 400);  // 如果解析失败，初始化响应对象为 400 错误
+        }
+        AppendResponse_();
+        count++;
+        if(!keepAlive_) {
+            break;  // 要关闭的连接不再处理后续请求
+        }
     }
+    readBuff_.Release();  // 读缓冲区已处理完时把内存还给池，空闲的长连接不占缓冲区
+    return ToWriteBytes() > 0;
+}
 
-    response_.MakeResponse(writeBuff_);  // 生成响应内容
-    /* 响应头 */
-    iov_[0].iov_base = const_cast<char*>(writeBuff_.Peek());
-    iov_[0].iov_len = writeBuff_.ReadableBytes();
-    iovCnt_ = 1;  
-
-    /* 文件 */
-    if(response_.FileLen() > 0  && response_.File()) {  // 如果文件长度大于 0 且文件存在
-        iov_[1].iov_base = response_.File();
-        iov_[1].iov_len = response_.FileLen();
-        // 设置 iov_[1] 的基地址和长度
-        iovCnt_ = 2;
-    }
-    LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen() , iovCnt_, ToWriteBytes());
-    return true;   
+unique_ptr<VerifyTask> HttpConn::MakeVerifyTask() const {
+    assert(request_.IsVerifying());
+    return unique_ptr<VerifyTask>(new VerifyTask{ fd_, GetGen(), request_.GetPost("username"),
+                                  request_.GetPost("password"), request_.IsLogin(), false });
+}
+
+void HttpConn::FinishVerify(bool ok) {
+    request_.FinishVerify(ok);
+    LOG_DEBUG("%s", request_.path().c_str());
+    assert(ToWriteBytes() == 0);
+    response_.Init(srcDir, request_.path(), request_.IsKeepAlive() && !draining, 200);
+    AppendResponse_();
+}
+
+void HttpConn::RejectVerify() {
+    request_.FinishVerify(false);
+    assert(ToWriteBytes() == 0);
+    response_.Init(srcDir, request_.path(), request_.IsKeepAlive() && !draining, 503);
+    AppendResponse_();
+}
+
+void HttpConn::AppendResponse_() {
+    StageTimer timer(Metrics::RESPONSE);
+    response_.MakeResponse(writeBuff_);  // 响应头和文件体（映射区引用或文件区间）都挂到写缓冲区
+    keepAlive_ = response_.IsKeepAlive();
+    served_ = true;
+    Metrics::Instance()->CountResponse(response_.Code());
+    LOG_DEBUG("filesize:%d to %d", response_.FileLen(), ToWriteBytes());
 }
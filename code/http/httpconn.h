@@ -4,16 +4,34 @@
 #include <sys/types.h>
 #include <sys/uio.h>     // readv/writev
 #include <arpa/inet.h>   // sockaddr_in
+#include <netinet/tcp.h> // TCP_CORK
 #include <stdlib.h>      // atoi()
 #include <errno.h>      
+#include <memory>      // unique_ptr
+#include <vector>
 
 #include "../log/log.h"
 #include "../pool/sqlconnRAII.h"
 #include "../buffer/buffer.h"
+#include "../buffer/chainbuffer.h"
+#include "../metrics/metrics.h"
 #include "httprequest.h"
 #include "httpresponse.h"
 
-class HttpConn {
+/* 登录/注册的数据库验证：在数据库线程中执行，结果再交回连接所属的 Reactor 线程 */
+struct VerifyTask {
+    int fd;
+    uint32_t gen;  // 发起时连接的代数，结果返回时用来识别 fd 是否已被关闭或复用
+    std::string name;
+    std::string pwd;
+    bool isLogin;
+    bool ok;
+};
+
+/* 连接对象按缓存行对齐，存放在以 fd 为下标的连接表中：
+   每次事件都要访问的热字段（fd、状态、缓冲区）放在前面，
+   体积大、只在解析/生成响应时访问的请求和响应对象从新的缓存行开始 */
+class alignas(64) HttpConn {
 public:
     HttpConn();
 
@@ -25,6 +43,12 @@ public:
 
     ssize_t write(int* saveErrno);  // 发送数据
 
+    /* 完成式 I/O（io_uring）：读写由内核完成，这里只交接数据 */
+    void Feed(const char* data, size_t len);  // 内核读到的数据追加到读缓冲区
+    int PeekWriteIov(struct iovec* iov, int maxIov) const { return writeBuff_.PeekIov(iov, maxIov); }
+    // 待发送的内存段，队首是文件区间时返回 0（文件区间仍用 write() 的 sendfile）
+    void Written(size_t len);  // 内核已发出 len 字节
+
     void Close();  // 关闭连接
  
     int GetFd() const;  // 获取文件描述符
@@ -36,34 +60,85 @@ public:
     sockaddr_in GetAddr() const;  // 获取地址信息
     
     bool process();  // 处理 HTTP 请求
+    // 处理读缓冲区中所有完整的请求（流水线），响应按顺序排队，一次 writev 发出；
+    // 不完整的尾部请求留在缓冲区等下次读取。
+    // 返回 true 表示有响应待发送；返回 false 且 IsVerifying() 时请求需要查库，
+    // 调用方应把 MakeVerifyTask() 交给数据库线程，拿到结果后调用 FinishVerify()
+
+    bool IsVerifying() const {
+        return request_.IsVerifying();
+    }
+
+    std::unique_ptr<VerifyTask> MakeVerifyTask() const;
+
+    void FinishVerify(bool ok);  // 填入验证结果并生成响应
+
+    void RejectVerify();  // 数据库线程的队列已满：不查库，直接生成 503
+
+    uint32_t GetGen() const { return gen_.load(std::memory_order_acquire); }
+    // 连接的代数，init 和 Close 时各加一：投递任务或定时器时记下，执行前比较即可识别连接已关闭或被复用
+
+    bool IsClosed() const { return isClose_; }
+
+    void Pin() { pins_.fetch_add(1, std::memory_order_relaxed); }  // 主线程把连接交给工作线程之前
+    void Unpin() { pins_.fetch_sub(1, std::memory_order_release); }  // 工作线程处理完、不再访问连接之后
 
-    int ToWriteBytes() { 
-        return iov_[0].iov_len + iov_[1].iov_len; 
+    bool IsIdle() const {
+        return pins_.load(std::memory_order_acquire) == 0 && served_ && ToWriteBytes() == 0
+            && !request_.IsVerifying() && readBuff_.ReadableBytes() == 0 && !request_.InProgress();
+    }  // 已处理过请求的长连接，没有工作线程持有、没有待发送的响应、也没有收到一半的请求：退出时可以直接关闭。
+    // 刚 accept 的连接请求可能还在路上，不算空闲
+
+    size_t ToWriteBytes() const { 
+        return writeBuff_.ReadableBytes(); 
     }  // 获取待写入的字节数
 
+    size_t ToReadBytes() const { return readBuff_.ReadableBytes(); }  // 已读入、尚未解析的字节数
+
     bool IsKeepAlive() const {
-        return request_.IsKeepAlive();
-    }  // 检查连接是否保持活跃
+        return keepAlive_;
+    }  // 最后一个已排队的响应是否保持连接
+
+    bool InputDrained() const { return inputDrained_; }
+    // 上次 read 已把套接字读空（EAGAIN 或短读）；为 false 时 ET 模式下不会再有新的边沿，需要重新注册才能触发
+
+    uint32_t Interest() const { return interest_; }  // 当前在 epoll 中注册的 EPOLLIN/EPOLLOUT，0 表示都没有
+    void SetInterest(uint32_t events) { interest_ = events; }
 
     static bool isET;    // 是否使用 ET 模式
     static const char* srcDir;  // 资源的物理路径
     static std::atomic<int> userCount;  // 连接的用户数量
+    static size_t initBuffSize;  // 新连接读缓冲区第一次申请的大小
+    static bool cork;  // 有文件区间的响应发送期间设置 TCP_CORK，头部与文件内容合并成满帧
+    static std::atomic<bool> draining;  // 正在退出：之后的响应都带 Connection: close，发完即关闭
     
 private:
-   
+    void AppendResponse_();  // 生成响应并追加到写缓冲区
+
+    static const size_t MAX_READ_BUFF = 64 << 10;  // 一次读事件最多读入的数据量，上传的大请求体分批解析
+    static const size_t MAX_PIPELINE = 32;  // 每批最多处理的流水线请求数
+
+    /* 热字段 */
     int fd_;  //客户端连接的 socket 文件描述符。
-    struct  sockaddr_in addr_;  // 客户端地址信息。
+    std::atomic<uint32_t> gen_;  // 连接代数
+    std::atomic<int> pins_;  // 持有连接的工作线程数，槽位复用时不清零
 
     bool isClose_;  // 是否关闭连接
     
-    int iovCnt_;  // iov 数组的元素个数
-    struct iovec iov_[2];  // iov 数组，用于分散写操作
-    
+    bool keepAlive_;
+    bool served_;  // 已经生成过响应
+    bool inputDrained_;  // 上次 read 已读空套接字
+    uint32_t interest_;  // 由所属的 Reactor 维护，兴趣集不变时省去 epoll_ctl
+
     Buffer readBuff_; // 读缓冲区
-    Buffer writeBuff_; // 写缓冲区
+    ChainBuffer writeBuff_; // 写缓冲区：本批响应头拷贝进块链，文件体以映射区引用或文件区间挂在链上
 
-    HttpRequest request_;  // HTTP 请求对象，用于解析和存储请求信息
+    /* 冷字段 */
+    alignas(64) HttpRequest request_;  // HTTP 请求对象，用于解析和存储请求信息
     HttpResponse response_;  // HTTP 响应对象，用于生成响应信息
+    struct  sockaddr_in addr_;  // 客户端地址信息。
+    int64_t openTime_;  // accept 的时刻，关闭时记录连接寿命
+    int64_t parseNs_;  // 当前请求已花在解析上的时间，请求可能分多次读入
 };
 
 
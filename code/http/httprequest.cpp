@@ -9,55 +9,148 @@ const unordered_set<string> HttpRequest::DEFAULT_HTML{
 const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG {
             {"/register.html", 0}, {"/login.html", 1},  };
     // 这些路径对应的标签，用于处理用户注册和登录请求
+
+HttpRequest::VerifyBackend HttpRequest::verifyBackend = nullptr;
+
 void HttpRequest::Init() {
-    method_ = path_ = version_ = body_ = "";  // 初始化成员变量
+    method_ = version_ = string_view();  // 初始化成员变量
+    path_.clear();
+    body_.clear();
+    head_.clear();
     state_ = REQUEST_LINE;   // 设置初始解析状态为 REQUEST_LINE
+    checked_ = 0;
+    contentLen_ = bodyLeft_ = bodyLen_ = 0;
+    CloseBody_();
+    methodLen_ = versionOff_ = versionLen_ = 0;
+    isKeepAlive_ = false;
+    verifying_ = isLogin_ = false;
+    expectContinue_ = false;
+    fields_.clear();  // clear 保留容量，长连接上反复解析不再分配内存
     header_.clear();  // 清空头部信息
     post_.clear();   // 清空 POST 数据
 }
 
 bool HttpRequest::IsKeepAlive() const {
-    if(header_.count("Connection") == 1) {
-        return header_.find("Connection")->second == "keep-alive" && version_ == "1.1";
+    return isKeepAlive_;
+}   // 请求头完整时根据 Connection 字段和 HTTP 协议版本计算，判断是否启用持久连接（Keep-Alive）。
+
+HttpRequest::HTTP_CODE HttpRequest::parse(Buffer& buff) {
+    if(state_ == FINISH) {
+        Init();  // 上一个请求已完成，开始解析新的请求
     }
-    return false;
-}   // 该函数通过检查请求头中的 Connection 字段和 HTTP 协议版本，判断是否启用持久连接（Keep-Alive）。
+    const char* begin = buff.Peek();  // 本次请求的起点，扩容后会变化，所以只保存偏移
+    const char* end = buff.BeginWriteConst();
+    while(state_ != FINISH) {
+        if(state_ == BODY || state_ == CHUNK_DATA) {
+            /* 请求体随到随取走，不在 buff 中堆积 */
+            size_t len = min(static_cast<size_t>(end - begin), bodyLeft_);
+            if(len > 0 && !AppendBody_(begin, len)) {
+                return BadRequest_(buff);
+            }
+            buff.Retrieve(len);
+            begin += len;
+            bodyLeft_ -= len;
+            if(bodyLeft_ > 0) {
+                return NO_REQUEST;  // 请求体还没收全，等待下一次读
+            }
+            if(state_ == BODY) {
+                FinishBody_();
+                break;
+            }
+            state_ = CHUNK_END;
+            continue;
+        }
+        /* 只从上次停下的位置继续找行尾，已扫描过的字节不再重复扫描 */
+        const char* lineEnd = static_cast<const char*>(
+                memchr(begin + checked_, '\n', end - begin - checked_));
+        if(lineEnd == nullptr) {
+            if(static_cast<size_t>(end - begin) > MAX_HEAD_LEN) {
+                LOG_ERROR("Request head too long");
+                return BadRequest_(buff);
+            }
+            return NO_REQUEST;  // 行不完整，等待下一次读
+        }
+        const char* line = begin + checked_;
+        checked_ = lineEnd + 1 - begin;
+        if(lineEnd > line && *(lineEnd - 1) == '\r') { lineEnd--; }  // 去掉 \r，兼容只有 \n 的客户端
 
-bool HttpRequest::parse(Buffer& buff) {
-    const char CRLF[] = "\r\n";  // 定义请求头的结束标志
-    if(buff.ReadableBytes() <= 0) {
-        return false;
-    }  // 如果缓冲区没有可读数据，则返回 false，表示解析失败。
-    while(buff.ReadableBytes() && state_ != FINISH) {  // 有可读数据且 能继续解析
-        const char* lineEnd = search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);  
-        //[first1, last1)：主序列（待搜索的序列）  [first2, last2)：目标子序列（要查找的内容）
-        //返回的指针指向第一个检索到的\r
-        std::string line(buff.Peek(), lineEnd); // buff.Peek()-lineEnd-1 作为字符串line的值
         switch(state_)
         {
-        case REQUEST_LINE:  
-            if(!ParseRequestLine_(line)) {   // 解析请求行
-                return false;
+        case REQUEST_LINE:
+            if(line == lineEnd) {
+                /* 请求行之前的空行直接丢弃 */
+                buff.Retrieve(checked_);
+                begin = buff.Peek();
+                checked_ = 0;
+                continue;
+            }
+            if(!ParseRequestLine_(line, lineEnd)) {   // 解析请求行
+                break;
             }
             ParsePath_();  // 将路径映射为实际的 HTML 文件路径
-            break;    
+            continue;
         case HEADERS:
-            ParseHeader_(line);   //解析请求头
-            if(buff.ReadableBytes() <= 2) {  // 如果缓冲区没有足够的数据来读取请求体，则返回 false。
-                state_ = FINISH;
+            if(checked_ > MAX_HEAD_LEN) {
+                LOG_ERROR("Request head too long");
+                break;
+            }
+            if(line == lineEnd) {
+                /* 空行：请求头结束 */
+                if(!FinishHead_(begin) || !StartBody_(begin)) {
+                    break;
+                }
+                if(state_ == FINISH) {
+                    ParsePost_();
+                } else {
+                    buff.Retrieve(checked_);  // 请求头已复制到 head_
+                    begin = buff.Peek();
+                    checked_ = 0;
+                }
+                continue;
+            }
+            if(ParseHeader_(begin, line, lineEnd)) {   //解析请求头
+                continue;
             }
             break;
-        case BODY:  // 解析请求体
-            ParseBody_(line);
-            break;
+        case CHUNK_SIZE:
+            if(!ParseChunkSize_(line, lineEnd)) {
+                break;
+            }
+            buff.Retrieve(checked_);
+            begin = buff.Peek();
+            checked_ = 0;
+            continue;
+        case CHUNK_END:
+            if(line != lineEnd) {
+                LOG_ERROR("Chunk Error");
+                break;
+            }
+            buff.Retrieve(checked_);
+            begin = buff.Peek();
+            checked_ = 0;
+            state_ = CHUNK_SIZE;
+            continue;
+        case TRAILER:
+            /* 尾部字段不使用，只跳过；和请求头一样限制长度 */
+            if(checked_ > MAX_HEAD_LEN) {
+                LOG_ERROR("Request trailer too long");
+                break;
+            }
+            if(line == lineEnd) {
+                buff.Retrieve(checked_);
+                checked_ = 0;
+                FinishBody_();
+            }
+            continue;
         default:
             break;
         }
-        if(lineEnd == buff.BeginWrite()) { break; }  //没有更多数据可读，跳出循环。
-        buff.RetrieveUntil(lineEnd + 2); //还可以读取的话跳过\r\n继续读取 改变read_pos位置
+        return BadRequest_(buff);  // 走到这里说明格式错误
     }
-    LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(), path_.c_str(), version_.c_str());
-    return true;
+    buff.Retrieve(checked_);  // 取走整个请求，视图仍指向原处直到下一次写入
+    LOG_DEBUG("[%.*s], [%s], [%.*s]", (int)method_.size(), method_.data(), path_.c_str(),
+                (int)version_.size(), version_.data());
+    return GET_REQUEST;
 }
 
 void HttpRequest::ParsePath_() {
@@ -74,13 +167,16 @@ void HttpRequest::ParsePath_() {
     }
 }
 
-bool HttpRequest::ParseRequestLine_(const string& line) {
-    regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");  // 正则表达式匹配请求行格式
-    smatch subMatch;
-    if(regex_match(line, subMatch, patten)) {   
-        method_ = subMatch[1];  // httpp请求方法
-        path_ = subMatch[2];   // httpp请求路径
-        version_ = subMatch[3];  // httpp版本
+bool HttpRequest::ParseRequestLine_(const char* line, const char* end) {
+    /* 方法 SP 路径 SP HTTP/版本 */
+    const char* sp1 = static_cast<const char*>(memchr(line, ' ', end - line));
+    const char* sp2 = sp1 ? static_cast<const char*>(memchr(sp1 + 1, ' ', end - sp1 - 1)) : nullptr;
+    if(sp1 && sp2 && sp1 != line && sp2 != sp1 + 1 && end - sp2 > 5
+            && memcmp(sp2 + 1, "HTTP/", 5) == 0 && !memchr(sp2 + 6, ' ', end - sp2 - 6)) {
+        methodLen_ = sp1 - line;  // httpp请求方法
+        path_.assign(sp1 + 1, sp2);   // httpp请求路径
+        versionOff_ = sp2 + 6 - line;  // httpp版本
+        versionLen_ = end - sp2 - 6;
         state_ = HEADERS;  // 设置解析状态为 HEADERS，准备解析请求头
         return true;
     }
@@ -88,22 +184,196 @@ bool HttpRequest::ParseRequestLine_(const string& line) {
     return false;
 }
 
-void HttpRequest::ParseHeader_(const string& line) {
-    regex patten("^([^:]*): ?(.*)$");  // 正则表达式匹配请求头格式
-    smatch subMatch;
-    if(regex_match(line, subMatch, patten)) {
-        header_[subMatch[1]] = subMatch[2];  // 将请求头的键值对存储到 header_ 中
+bool HttpRequest::ParseHeader_(const char* begin, const char* line, const char* end) {
+    /* 字段名: 可选空白 字段值 可选空白 */
+    const char* colon = static_cast<const char*>(memchr(line, ':', end - line));
+    if(colon == nullptr || colon == line) {
+        LOG_ERROR("Header Error");
+        return false;
+    }
+    const char* val = colon + 1;
+    while(val < end && (*val == ' ' || *val == '\t')) { val++; }
+    const char* valEnd = end;
+    while(valEnd > val && (*(valEnd - 1) == ' ' || *(valEnd - 1) == '\t')) { valEnd--; }
+    fields_.push_back({ static_cast<uint32_t>(line - begin), static_cast<uint32_t>(colon - line),
+                        static_cast<uint32_t>(val - begin), static_cast<uint32_t>(valEnd - val) });
+    return true;
+}
+
+HttpRequest::HTTP_CODE HttpRequest::BadRequest_(Buffer& buff) {
+    /* 无法再确定请求边界：丢弃剩余数据，连接随后关闭 */
+    state_ = FINISH;
+    isKeepAlive_ = false;
+    buff.RetrieveAll();
+    return BAD_REQUEST;
+}
+
+bool HttpRequest::FinishHead_(const char* begin) {
+    method_ = string_view(begin, methodLen_);
+    version_ = string_view(begin + versionOff_, versionLen_);
+    header_.clear();
+    for(const auto& f: fields_) {
+        header_.emplace_back(string_view(begin + f.keyOff, f.keyLen),
+                             string_view(begin + f.valOff, f.valLen));
+    }
+    /* HTTP/1.1 默认持久连接，带 close 才关闭；HTTP/1.0 默认关闭，带 keep-alive 才保持 */
+    if(version_ == "1.1") {
+        isKeepAlive_ = !HasConnToken_("close");
+    } else {
+        isKeepAlive_ = version_ == "1.0" && HasConnToken_("keep-alive");
+    }
+
+    string_view len = GetHeader("Content-Length");
+    contentLen_ = 0;
+    for(char ch: len) {
+        if(ch < '0' || ch > '9' || contentLen_ > (SIZE_MAX - 9) / 10) {
+            LOG_ERROR("Content-Length Error");
+            return false;
+        }
+        contentLen_ = contentLen_ * 10 + (ch - '0');
+    }
+    return true;
+}
+
+bool HttpRequest::StartBody_(const char* begin) {
+    string_view te = GetHeader("Transfer-Encoding");
+    if(!te.empty()) {
+        /* 只支持 chunked；同时带 Content-Length 时边界有歧义（请求走私），直接拒绝 */
+        if(te.size() != 7 || strncasecmp(te.data(), "chunked", 7) != 0
+                || !GetHeader("Content-Length").empty()) {
+            LOG_ERROR("Transfer-Encoding Error");
+            return false;
+        }
+        state_ = CHUNK_SIZE;
+    }
+    else if(contentLen_ > MAX_BODY_LEN) {
+        LOG_ERROR("Content-Length too large: %zu", contentLen_);
+        return false;
+    }
+    else if(contentLen_ > 0) {
+        bodyLeft_ = contentLen_;
+        state_ = BODY;
     }
     else {
-        state_ = BODY;  // 请求头解析完毕
+        state_ = FINISH;
+        return true;
     }
+    string_view expect = GetHeader("Expect");
+    expectContinue_ = version_ == "1.1" && expect.size() == 12
+                      && strncasecmp(expect.data(), "100-continue", 12) == 0;
+    /* 请求体会边收边从 buff 取走，buff 随后可能搬移，视图改为指向请求头的副本 */
+    head_.assign(begin, checked_);
+    FinishHead_(head_.data());
+    return true;
 }
 
-void HttpRequest::ParseBody_(const string& line) {
-    body_ = line;  // 将请求体存储到 body_ 中
-    ParsePost_();   /// 解析请求体
+bool HttpRequest::ParseChunkSize_(const char* line, const char* end) {
+    /* 块大小 [;扩展]，大小为 0 表示最后一块，后面跟尾部字段 */
+    size_t size = 0;
+    const char* p = line;
+    for(; p < end && isxdigit(static_cast<unsigned char>(*p)); p++) {
+        if(size > (MAX_BODY_LEN >> 4)) {
+            break;
+        }
+        size = size * 16 + (isdigit(static_cast<unsigned char>(*p)) ? *p - '0' : ConverHex(*p));
+    }
+    while(p < end && (*p == ' ' || *p == '\t')) { p++; }
+    if(p == line || (p < end && *p != ';') || bodyLen_ + size > MAX_BODY_LEN) {
+        LOG_ERROR("Chunk size Error");
+        return false;
+    }
+    if(size == 0) {
+        state_ = TRAILER;
+    } else {
+        bodyLeft_ = size;
+        state_ = CHUNK_DATA;
+    }
+    return true;
+}
+
+bool HttpRequest::AppendBody_(const char* data, size_t len) {
+    if(bodyFd_ < 0 && body_.size() + len <= MAX_BODY_MEM) {
+        body_.append(data, len);
+        bodyLen_ += len;
+        return true;
+    }
+    if(bodyFd_ < 0) {
+        /* 超过内存上限：转存到已 unlink 的临时文件，连接关闭或下一个请求时自动释放 */
+        bodyFd_ = open(P_tmpdir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+        if(bodyFd_ < 0 && (errno == EOPNOTSUPP || errno == EISDIR)) {
+            char name[] = P_tmpdir "/webserver-body-XXXXXX";  // 文件系统不支持 O_TMPFILE
+            bodyFd_ = mkstemp(name);
+            if(bodyFd_ >= 0) { unlink(name); }
+        }
+        if(bodyFd_ < 0) {
+            LOG_ERROR("Body spill failed: %s", strerror(errno));
+            return false;
+        }
+        string mem;
+        mem.swap(body_);  // 释放内存中的部分
+        bodyLen_ = 0;
+        if(!AppendBody_(mem.data(), mem.size())) {
+            return false;
+        }
+    }
+    while(len > 0) {
+        ssize_t n = write(bodyFd_, data, len);
+        if(n <= 0) {
+            LOG_ERROR("Body spill failed: %s", strerror(errno));
+            return false;
+        }
+        data += n;
+        len -= n;
+        bodyLen_ += n;
+    }
+    return true;
+}
+
+void HttpRequest::FinishBody_() {
     state_ = FINISH;  // 设置解析状态为 FINISH，表示请求解析完成
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());  // 打印请求体信息
+    if(bodyFd_ >= 0) {
+        lseek(bodyFd_, 0, SEEK_SET);  // 交给使用者从头读
+        LOG_DEBUG("Body spilled to file, len:%zu", bodyLen_);
+        return;  // 表单只从内存中的请求体解析
+    }
+    ParsePost_();   /// 解析请求体
+    LOG_DEBUG("Body:%s, len:%d", body_.c_str(), body_.size());  // 打印请求体信息
+}
+
+void HttpRequest::CloseBody_() {
+    if(bodyFd_ >= 0) {
+        close(bodyFd_);
+        bodyFd_ = -1;
+    }
+}
+
+string_view HttpRequest::GetHeader(string_view key) const {
+    for(const auto& field: header_) {
+        if(field.first.size() == key.size()
+                && strncasecmp(field.first.data(), key.data(), key.size()) == 0) {
+            return field.second;
+        }
+    }
+    return string_view();
+}
+
+bool HttpRequest::HasConnToken_(string_view token) const {
+    /* Connection 是逗号分隔的选项列表，可能出现多行，选项不区分大小写 */
+    for(const auto& field: header_) {
+        if(field.first.size() != 10 || strncasecmp(field.first.data(), "Connection", 10) != 0) { continue; }
+        string_view list = field.second;
+        while(!list.empty()) {
+            size_t comma = list.find(',');
+            string_view item = list.substr(0, comma);
+            list = comma == string_view::npos ? string_view() : list.substr(comma + 1);
+            while(!item.empty() && (item.front() == ' ' || item.front() == '\t')) { item.remove_prefix(1); }
+            while(!item.empty() && (item.back() == ' ' || item.back() == '\t')) { item.remove_suffix(1); }
+            if(item.size() == token.size() && strncasecmp(item.data(), token.data(), token.size()) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
 }
 
 int HttpRequest::ConverHex(char ch) {
@@ -114,20 +384,17 @@ int HttpRequest::ConverHex(char ch) {
 
 //处理post请求体
 void HttpRequest::ParsePost_() {
-    if(method_ == "POST" && header_["Content-Type"] == "application/x-www-form-urlencoded") {
+    string_view type = GetHeader("Content-Type");
+    type = type.substr(0, type.find(';'));  // 忽略 charset 等参数
+    if(method_ == "POST" && type == "application/x-www-form-urlencoded") {
         // 使用"application/x-www-form-urlencoded" 来进行数据交付
         ParseFromUrlencoded_();  
         if(DEFAULT_HTML_TAG.count(path_)) {
             int tag = DEFAULT_HTML_TAG.find(path_)->second;
             LOG_DEBUG("Tag:%d", tag);
             if(tag == 0 || tag == 1) {
-                bool isLogin = (tag == 1);  // 如果 tag 为 1，则表示登录请求，否则为注册请求
-                if(UserVerify(post_["username"], post_["password"], isLogin)) {
-                    path_ = "/welcome.html";  // 登录成功
-                } 
-                else {
-                    path_ = "/error.html";  // 登录失败
-                }
+                isLogin_ = (tag == 1);  // 如果 tag 为 1，则表示登录请求，否则为注册请求
+                verifying_ = true;  // 查库交给数据库线程，结果通过 FinishVerify 带回
             }
         }
     }   
@@ -182,13 +449,34 @@ void HttpRequest::ParseFromUrlencoded_() {
 }
 
 
+void HttpRequest::FinishVerify(bool ok) {
+    assert(verifying_);
+    verifying_ = false;
+    path_ = ok ? "/welcome.html" : "/error.html";  // 验证成功 / 失败
+}
+
+int HttpRequest::CachedVerify(const string &name, const string &pwd, bool isLogin) {
+    if(name == "" || pwd == "") { return 0; }  //输入为空
+    string password;
+    UserCache::RESULT res = UserCache::Instance()->Get(name, &password);
+    if(res == UserCache::FOUND) {
+        return isLogin && pwd == password;  // 注册时用户名已被使用
+    }
+    if(res == UserCache::NOT_FOUND && isLogin) {
+        return 0;  // 最近查过，用户不存在
+    }
+    return -1;  // 需要查库
+}
+
 //传入post_["username"], post_["password"]对应的值
 bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin) {
     if(name == "" || pwd == "") { return false; }  //输入为空
     LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
+    StageTimer timer(Metrics::DB);  // 含等待空闲连接的时间
+    if(verifyBackend) { return verifyBackend(name, pwd, isLogin); }
     MYSQL* sql;  
-    SqlConnRAII(&sql,  SqlConnPool::Instance());  //从连接池中获取一个数据库连接。
-    assert(sql);  //确保连接成功，否则程序终止。
+    SqlConnRAII sqlRAII(&sql,  SqlConnPool::Instance());  //从连接池中获取一个数据库连接，函数返回时归还。
+    if(!sql) { return false; }  // 连接池为空
     
     bool flag = false;  //表示是否成功（登录或注册）
     unsigned int j = 0;  //字段数量
@@ -211,9 +499,12 @@ bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin
     j = mysql_num_fields(res);   // 获取结果集中的字段数量
     fields = mysql_fetch_fields(res);  // 获取字段信息
 
+    bool found = false;  // 是否查到该用户
     while(MYSQL_ROW row = mysql_fetch_row(res)) {
+        found = true;
         LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);  // 打印结果集中的数据
         string password(row[1]);                       // 获取查询到的密码
+        UserCache::Instance()->Put(name, password);
         /* 注册行为 且 用户名未被使用*/
         if(isLogin) {
             if(pwd == password) { flag = true; }  // 密码匹配
@@ -227,6 +518,9 @@ bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin
             LOG_DEBUG("user used!");
         }
     }
+    if(isLogin && !found) {
+        UserCache::Instance()->PutMissing(name);  // 用户不存在
+    }
     mysql_free_result(res);  // 释放结果集
 
     /* 注册行为 且 用户名未被使用*/
@@ -240,10 +534,10 @@ bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin
             // 执行 SQL 插入语句  失败执行下面代码
             LOG_DEBUG( "Insert error!");
             flag = false; 
+        } else {
+            UserCache::Instance()->Put(name, pwd);  // 写穿到缓存，新用户马上可以登录
         }
-        flag = true;
     }
-    SqlConnPool::Instance()->FreeConn(sql);  // 释放数据库连接
     LOG_DEBUG( "UserVerify success!!");
     return flag;
 }
@@ -256,11 +550,11 @@ std::string& HttpRequest::path(){
     return path_;
 }
 std::string HttpRequest::method() const {
-    return method_;
+    return std::string(method_);
 }
 
 std::string HttpRequest::version() const {
-    return version_;
+    return std::string(version_);
 }
 
 std::string HttpRequest::GetPost(const std::string& key) const {
@@ -4,14 +4,21 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
-#include <regex>
+#include <string_view>
+#include <vector>
 #include <errno.h>     
+#include <fcntl.h>       // open
+#include <unistd.h>      // write/lseek/close
+#include <stdio.h>       // P_tmpdir
+#include <algorithm>
 #include <mysql/mysql.h>  //mysql
 
 #include "../buffer/buffer.h"
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
 #include "../pool/sqlconnRAII.h"
+#include "../pool/usercache.h"
+#include "../metrics/metrics.h"
 
 class HttpRequest {
 public:
@@ -19,12 +26,17 @@ public:
         REQUEST_LINE,
         HEADERS,
         BODY,
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_END,
+        TRAILER,
         FINISH,        
     };
     // 表示解析状态： 
     // REQUEST_LINE：解析请求行（方法、路径、版本）。
     // HEADERS：解析请求头。
-    // BODY：解析请求体。
+    // BODY：按 Content-Length 读取请求体。
+    // CHUNK_SIZE / CHUNK_DATA / CHUNK_END / TRAILER：chunked 请求体的块大小行、块数据、块后的 CRLF、尾部字段。
     // FINISH：解析完成。
 
     enum HTTP_CODE {
@@ -48,20 +60,50 @@ public:
     // CLOSED_CONNECTION：连接关闭。
 
     
-    HttpRequest() { Init(); }
-    ~HttpRequest() = default;
+    HttpRequest(): bodyFd_(-1) { Init(); }
+    ~HttpRequest() { CloseBody_(); }
 
     void Init();  // 初始化请求
-    bool parse(Buffer& buff);  // 解析请求
+    HTTP_CODE parse(Buffer& buff);  
+    // 增量解析请求：直接扫描 buff 中的字节，数据不完整时返回 NO_REQUEST 并记住扫描位置，
+    // 下次读到新数据后从断点继续；完整时返回 GET_REQUEST，格式错误返回 BAD_REQUEST。
+    // 完成后请求字节会从 buff 中取走，method/version/header 是指向 buff 的视图，
+    // 在 buff 下一次写入或 Release 前有效（即生成响应之前）。
+    // 带请求体时请求头先复制出来，请求体随到随取走，buff 不会随请求体增长：
+    // 不超过 MAX_BODY_MEM 的保存在内存中，更大的写入临时文件，超过 MAX_BODY_LEN 返回 BAD_REQUEST。
 
     std::string path() const;  // 获取请求路径
     std::string& path();  // 获取请求路径
     std::string method() const;  // 获取请求方法
     std::string version() const;  //获取 HTTP 版本
+    std::string_view GetHeader(std::string_view key) const;  // 获取请求头（不区分大小写），不存在返回空
     std::string GetPost(const std::string& key) const; // 获取 POST 请求参数
     std::string GetPost(const char* key) const; // 获取 POST 请求参数
+    const std::string& body() const { return body_; }  // 内存中的请求体，写入临时文件后为空
+    int BodyFd() const { return bodyFd_; }  // 临时文件（已 unlink，偏移在开头），没有时为 -1
+    size_t BodyLen() const { return bodyLen_; }  // 请求体总长度
+    bool TakeContinue() {
+        bool ret = expectContinue_;
+        expectContinue_ = false;
+        return ret;
+    }  // 客户端带 Expect: 100-continue 等待发送请求体，只返回一次 true
 
     bool IsKeepAlive() const;  // 检查连接是否保持活跃
+    bool IsGetOrHead() const { return method_ == "GET" || method_ == "HEAD"; }  // 可以按条件头返回 304
+    bool IsHead() const { return method_ == "HEAD"; }  // 响应只有头部
+
+    bool IsVerifying() const { return verifying_; }  // 登录/注册请求已解析完，等待数据库验证结果
+    bool InProgress() const { return state_ != REQUEST_LINE && state_ != FINISH; }  // 收到了请求头或请求体的一部分
+    bool IsLogin() const { return isLogin_; }  // 待验证的是登录（否则是注册）
+    void FinishVerify(bool ok);  // 填入验证结果，改写响应路径
+
+    static bool UserVerify(const std::string& name, const std::string& pwd, bool isLogin);
+    // 用户验证：同步查询数据库并把结果写入用户缓存，只应在数据库线程中调用
+    static int CachedVerify(const std::string& name, const std::string& pwd, bool isLogin);
+    // 只查用户缓存，不阻塞：返回 1 通过、0 不通过、-1 需要调用 UserVerify 查库
+
+    typedef bool (*VerifyBackend)(const std::string& name, const std::string& pwd, bool isLogin);
+    static VerifyBackend verifyBackend;  // 非空时 UserVerify 用它代替 MySQL（测试用的桩）
 
     /* 
     todo 
@@ -70,19 +112,44 @@ public:
     */
 
 private:
-    bool ParseRequestLine_(const std::string& line);  // 解析请求行
-    void ParseHeader_(const std::string& line);  // 解析请求头
-    void ParseBody_(const std::string& line);  // 解析请求体
+    bool ParseRequestLine_(const char* line, const char* end);  // 解析请求行
+    bool ParseHeader_(const char* begin, const char* line, const char* end);  // 解析请求头
+    bool FinishHead_(const char* begin);  // 请求头完整后生成视图，Content-Length 非法时返回 false
+    bool StartBody_(const char* begin);  // 确定请求体的长度或 chunked 编码，并把请求头复制出来
+    bool ParseChunkSize_(const char* line, const char* end);  // 解析块大小行，忽略块扩展
+    bool AppendBody_(const char* data, size_t len);  // 追加请求体，超过内存上限时转存临时文件
+    void FinishBody_();
+    void CloseBody_();
+    HTTP_CODE BadRequest_(Buffer& buff);  // 格式错误：结束解析并丢弃剩余数据
+    bool HasConnToken_(std::string_view token) const;  // Connection 头里是否有该选项
 
     void ParsePath_();  // 解析路径
     void ParsePost_();  // 解析 POST 请求
     void ParseFromUrlencoded_();  // 解析 URL 编码的表单数据
 
-    static bool UserVerify(const std::string& name, const std::string& pwd, bool isLogin);  // 用户验证
+    struct FieldRef_ {
+        uint32_t keyOff, keyLen, valOff, valLen;
+    };  // 请求头在本次请求字节中的偏移，buff 扩容搬移后依然有效
+
+    static const size_t MAX_HEAD_LEN = 8192;  // 请求行 + 请求头的最大长度
+    static const size_t MAX_BODY_MEM = 64 << 10;  // 内存中保存的请求体上限
+    static const size_t MAX_BODY_LEN = 64 << 20;  // 请求体的最大长度
 
     PARSE_STATE state_;  // 当前解析状态
-    std::string method_, path_, version_, body_;  //存储 HTTP 请求的方法、路径、版本和请求体。
-    std::unordered_map<std::string, std::string> header_;   // 存储请求头 
+    size_t checked_;  // 已扫描的字节数（相对本次请求起点），续读时从这里开始
+    size_t contentLen_;  // Content-Length
+    size_t bodyLeft_;  // 当前请求体（或当前块）还差多少字节
+    size_t bodyLen_;  // 已收到的请求体字节数
+    int bodyFd_;  // 请求体转存的临时文件
+    uint32_t methodLen_, versionOff_, versionLen_;  // 请求行中方法、版本的位置
+    bool isKeepAlive_;
+    bool verifying_, isLogin_;
+    bool expectContinue_;
+    std::string_view method_, version_;  // 指向读缓冲区
+    std::string path_, body_;  // 路径可能被改写，请求体需要解码，因此单独保存
+    std::string head_;  // 带请求体时复制出的请求头，视图改为指向这里
+    std::vector<FieldRef_> fields_;  // 解析中的请求头偏移
+    std::vector<std::pair<std::string_view, std::string_view>> header_;   // 存储请求头，指向读缓冲区
     std::unordered_map<std::string, std::string> post_;    // 存储 POST 请求参数
 
     static const std::unordered_set<std::string> DEFAULT_HTML;  // 默认 HTML 文件集合
@@ -4,36 +4,19 @@
  * @copyleft Apache 2.0
  */ 
 #include "httpresponse.h"
+#include <random>
 
 using namespace std;
 
-const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
-    { ".html",  "text/html" },
-    { ".xml",   "text/xml" },
-    { ".xhtml", "application/xhtml+xml" },
-    { ".txt",   "text/plain" },
-    { ".rtf",   "application/rtf" },
-    { ".pdf",   "application/pdf" },
-    { ".word",  "application/nsword" },
-    { ".png",   "image/png" },
-    { ".gif",   "image/gif" },
-    { ".jpg",   "image/jpeg" },
-    { ".jpeg",  "image/jpeg" },
-    { ".au",    "audio/basic" },
-    { ".mpeg",  "video/mpeg" },
-    { ".mpg",   "video/mpeg" },
-    { ".avi",   "video/x-msvideo" },
-    { ".gz",    "application/x-gzip" },
-    { ".tar",   "application/x-tar" },
-    { ".css",   "text/css "},
-    { ".js",    "text/javascript "},
-};  // 文件后缀名对应的类型
-
 const unordered_map<int, string> HttpResponse::CODE_STATUS = {
     { 200, "OK" },
+    { 206, "Partial Content" },
+    { 304, "Not Modified" },
     { 400, "Bad Request" },
     { 403, "Forbidden" },
     { 404, "Not Found" },
+    { 416, "Range Not Satisfiable" },
+    { 503, "Service Unavailable" },
 };  // 状态码对应的描述
 
 const unordered_map<int, string> HttpResponse::CODE_PATH = {
@@ -42,12 +25,54 @@ const unordered_map<int, string> HttpResponse::CODE_PATH = {
     { 404, "/404.html" },
 };   // 状态码对应的错误页面路径
 
+const unordered_map<int, array<string, 2>> HttpResponse::HEADER_BLOCK = HttpResponse::BuildHeaderBlock_();
+
+const string HttpResponse::BOUNDARY = HttpResponse::MakeBoundary_();
+
+string HttpResponse::MakeBoundary_() {
+    random_device rd;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%08x%08x", rd(), rd());
+    return buf;
+}
+
+unordered_map<int, array<string, 2>> HttpResponse::BuildHeaderBlock_() {
+    unordered_map<int, array<string, 2>> blocks;
+    for(const auto& status: CODE_STATUS) {
+        string line = "HTTP/1.1 " + to_string(status.first) + " " + status.second + "\r\n";
+        blocks[status.first][0] = line + "Connection: close\r\n";
+        blocks[status.first][1] = line + "Connection: keep-alive\r\nkeep-alive: max=6, timeout=120\r\n";
+    }
+    return blocks;
+}
+
+char* HttpResponse::FormatUint_(char* end, size_t value) {
+    static const char DIGITS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char* p = end;
+    while(value >= 100) {  // 每次两位，查表代替一半的除法
+        size_t i = (value % 100) * 2;
+        value /= 100;
+        *--p = DIGITS[i + 1];
+        *--p = DIGITS[i];
+    }
+    if(value >= 10) {
+        *--p = DIGITS[value * 2 + 1];
+        *--p = DIGITS[value * 2];
+    } else {
+        *--p = static_cast<char>('0' + value);
+    }
+    return p;
+}
+
 HttpResponse::HttpResponse() {
     code_ = -1;   // 响应状态码
     path_ = srcDir_ = "";  // 请求的资源路径和资源的物理路径
     isKeepAlive_ = false;  // 是否保持连接
-    mmFile_ = nullptr;   // 内存映射的文件指针
-    mmFileStat_ = { 0 };  // 内存映射的文件状态
+    isHead_ = false;
+    contentType_ = nullptr;
 };
 
 HttpResponse::~HttpResponse() {
@@ -56,22 +81,34 @@ HttpResponse::~HttpResponse() {
 
 void HttpResponse::Init(const string& srcDir, string& path, bool isKeepAlive, int code){
     assert(srcDir != "");
-    if(mmFile_) { UnmapFile(); }  // 如果当前有文件被映射到内存中，先解除映射
+    UnmapFile();  // 释放上一个响应引用的文件
     code_ = code;  // 响应状态码
     isKeepAlive_ = isKeepAlive;   // 是否保持连接
+    isHead_ = false;
     path_ = path;  // 请求的资源路径
     srcDir_ = srcDir;  // 资源的物理路径
-    mmFile_ = nullptr;   // 内存映射的文件指针
-    mmFileStat_ = { 0 };  // 内存映射的文件状态
+    ifNoneMatch_ = ifModifiedSince_ = string_view();
+    range_ = ifRange_ = acceptEncoding_ = string_view();
+    contentType_ = nullptr;
+    content_.clear();
 }
 
-void HttpResponse::MakeResponse(Buffer& buff) {
-    /* 判断请求的资源文件 */
-    if(stat((srcDir_ + path_).data(), &mmFileStat_) < 0 || S_ISDIR(mmFileStat_.st_mode)) {
+void HttpResponse::MakeResponse(ChainBuffer& buff) {
+    if(contentType_ && code_ == 200) {
+        AddStateLine_(buff);
+        AddGenerated_(buff);
+        return;
+    }
+    /* 判断请求的资源文件，命中缓存时没有 stat/open/mmap */
+    if(code_ >= 400) {
+        file_.reset();  // 请求本身有错（如 400），不再查找资源，以免被 404 覆盖
+    }
+    else if(!(file_ = FileCache::Instance()->Get(FileCache::ResolvePath(srcDir_, path_)))
+            || S_ISDIR(file_->st.st_mode)) {
         // 如果文件不存在或者是目录，则返回404错误
         code_ = 404;
     }
-    else if(!(mmFileStat_.st_mode & S_IROTH)) {
+    else if(!(file_->st.st_mode & S_IROTH)) {
         // 如果文件不可读，则返回403错误
         code_ = 403;
     }
@@ -79,97 +116,287 @@ void HttpResponse::MakeResponse(Buffer& buff) {
         // 如果前面的条件都不满足，且 code_ 仍为 -1
         code_ = 200; 
     }
+    if(code_ == 200 && range_.empty() && !acceptEncoding_.empty()) {
+        ChooseEncoding_();  // 带 Range 时发原文件，区间总是相对原文件
+    }
+    if(code_ == 200 && NotModified_()) {
+        code_ = 304;  // 客户端缓存仍然有效，只发校验器，不发文件
+    }
+    else if(code_ == 200 && !range_.empty() && ParseRange_()) {
+        code_ = ranges_.empty() ? 416 : 206;  // 没有一个区间落在文件内时 416
+    }
     ErrorHtml_();
     AddStateLine_(buff);
-    AddHeader_(buff);
     AddContent_(buff);
 }
 
 char* HttpResponse::File() {
-    return mmFile_;
+    return file_ ? file_->data : nullptr;
 }  // 获取内存映射的文件指针
 
 size_t HttpResponse::FileLen() const {
-    return mmFileStat_.st_size;
+    return file_ ? file_->st.st_size : 0;
 }  // 获取内存映射的文件长度
 
+static bool ParseOffset(string_view str, size_t* value) {
+    if(str.empty()) { return false; }
+    size_t v = 0;
+    for(char ch: str) {
+        if(ch < '0' || ch > '9') { return false; }
+        v = v > (SIZE_MAX - 9) / 10 ? SIZE_MAX : v * 10 + (ch - '0');  // 溢出时饱和，相当于到文件末尾
+    }
+    *value = v;
+    return true;
+}
+
+static string_view Trim(string_view str) {
+    while(!str.empty() && (str.front() == ' ' || str.front() == '\t')) { str.remove_prefix(1); }
+    while(!str.empty() && (str.back() == ' ' || str.back() == '\t')) { str.remove_suffix(1); }
+    return str;
+}
+
+bool HttpResponse::NotModified_() const {
+    if(file_->header.empty()) {
+        return false;  // 没有生成校验器的条目（打不开的文件）
+    }
+    if(!ifNoneMatch_.empty()) {
+        /* 有 If-None-Match 时忽略 If-Modified-Since；弱比较，W/ 前缀不影响结果 */
+        size_t pos = 0;
+        while(pos < ifNoneMatch_.size()) {
+            size_t comma = ifNoneMatch_.find(',', pos);
+            if(comma == string_view::npos) { comma = ifNoneMatch_.size(); }
+            string_view tag = Trim(ifNoneMatch_.substr(pos, comma - pos));
+            if(tag.substr(0, 2) == "W/") { tag.remove_prefix(2); }
+            if(tag == "*" || tag == (encoded_ ? encoded_->etag : file_->etag)) { return true; }
+            pos = comma + 1;
+        }
+        return false;
+    }
+    if(ifModifiedSince_.empty()) {
+        return false;
+    }
+    if(ifModifiedSince_ == file_->lastModified) {
+        return true;  // 浏览器通常原样带回 Last-Modified，不必解析日期
+    }
+    struct tm tm = {};
+    string date(ifModifiedSince_);
+    const char* end = strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if(!end || *end != '\0') {
+        return false;  // 无法识别的日期按无条件请求处理
+    }
+    return file_->st.st_mtim.tv_sec <= timegm(&tm);
+}
+
+bool HttpResponse::ParseRange_() {
+    ranges_.clear();
+    if(file_->header.empty()) {
+        return false;
+    }
+    if(!ifRange_.empty() && ifRange_ != file_->etag && ifRange_ != file_->lastModified) {
+        return false;  // 客户端手里的部分内容已过期，发送整个文件；ETag 强比较
+    }
+    if(range_.size() < 6 || strncasecmp(range_.data(), "bytes=", 6) != 0) {
+        return false;  // 不认识的单位
+    }
+    string_view spec = range_.substr(6);
+    size_t size = FileLen(), count = 0, pos = 0;
+    while(pos <= spec.size()) {
+        size_t comma = spec.find(',', pos);
+        if(comma == string_view::npos) { comma = spec.size(); }
+        string_view item = Trim(spec.substr(pos, comma - pos));
+        pos = comma + 1;
+        if(item.empty()) { continue; }
+        if(++count > MAX_RANGES) { return false; }
+        size_t dash = item.find('-');
+        if(dash == string_view::npos) { return false; }
+        size_t first = 0, last = 0;
+        if(dash == 0) {
+            /* 后缀区间 -n：最后 n 个字节 */
+            if(!ParseOffset(item.substr(1), &last)) { return false; }
+            if(last == 0 || size == 0) { continue; }
+            first = last >= size ? 0 : size - last;
+            last = size - 1;
+        } else {
+            if(!ParseOffset(item.substr(0, dash), &first)) { return false; }
+            if(dash + 1 == item.size()) {
+                last = SIZE_MAX;  // first-：到文件末尾
+            } else if(!ParseOffset(item.substr(dash + 1), &last) || last < first) {
+                return false;
+            }
+            if(first >= size) { continue; }  // 不可满足的区间
+            last = min(last, size - 1);
+        }
+        ranges_.emplace_back(first, last);
+    }
+    return count > 0;
+}
+
+bool HttpResponse::AcceptsEncoding_(string_view coding) const {
+    bool star = false;
+    size_t pos = 0;
+    while(pos < acceptEncoding_.size()) {
+        size_t comma = acceptEncoding_.find(',', pos);
+        if(comma == string_view::npos) { comma = acceptEncoding_.size(); }
+        string_view item = acceptEncoding_.substr(pos, comma - pos);
+        pos = comma + 1;
+        size_t semi = item.find(';');
+        string_view name = Trim(item.substr(0, semi));
+        bool accept = true;
+        if(semi != string_view::npos) {
+            /* q=0、q=0.0、q=0.000 都是拒绝 */
+            string_view param = Trim(item.substr(semi + 1));
+            if(param.size() >= 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                accept = param.find_first_not_of("0.", 2) != string_view::npos;
+            }
+        }
+        if(name.size() == coding.size() && strncasecmp(name.data(), coding.data(), name.size()) == 0) {
+            return accept;
+        }
+        if(name == "*") { star = accept; }
+    }
+    return star;
+}
+
+void HttpResponse::ChooseEncoding_() {
+    if(file_->header.empty()) {
+        return;
+    }
+    /* 预压缩文件优先，其次是现场压缩的缓存；br 压缩率更高，优先于 gzip */
+    bool br = AcceptsEncoding_("br"), gzip = AcceptsEncoding_("gzip");
+    if(br && file_->br) {
+        encoded_ = file_->br;
+    } else if(gzip && file_->gz) {
+        encoded_ = file_->gz;
+    } else if(br) {
+        encoded_ = CompressCache::Instance()->Get(file_, true);
+    }
+    if(!encoded_ && gzip) {
+        encoded_ = CompressCache::Instance()->Get(file_, false);
+    }
+}
+
 void HttpResponse::ErrorHtml_() {
     if(CODE_PATH.count(code_) == 1) {
         path_ = CODE_PATH.find(code_)->second;
-        stat((srcDir_ + path_).data(), &mmFileStat_);
+        file_ = FileCache::Instance()->Get(FileCache::ResolvePath(srcDir_, path_));
     }  // 如果状态码对应的错误页面路径存在，则使用该路径
 }
 
-void HttpResponse::AddStateLine_(Buffer& buff) {
-    string status;
-    if(CODE_STATUS.count(code_) == 1) {
-        status = CODE_STATUS.find(code_)->second;
-        // 如果状态码对应的描述存在，则使用该描述
-    }
-    else {
+void HttpResponse::AddStateLine_(ChainBuffer& buff) {
+    auto it = HEADER_BLOCK.find(code_);
+    if(it == HEADER_BLOCK.end()) {
         code_ = 400;  // 如果状态码不存在，则默认为400错误
-        status = CODE_STATUS.find(400)->second;  // 设置状态描述为 "Bad Request"
+        it = HEADER_BLOCK.find(400);
     }
-    buff.Append("HTTP/1.1 " + to_string(code_) + " " + status + "\r\n");
-}  //响应的状态行
+    buff.Append(it->second[isKeepAlive_]);
+}  // 状态行和 Connection 头整段拷贝，不再拼接临时字符串
 
-void HttpResponse::AddHeader_(Buffer& buff) {
-    buff.Append("Connection: ");
-    if(isKeepAlive_) {
-        buff.Append("keep-alive\r\n");
-        buff.Append("keep-alive: max=6, timeout=120\r\n");
-    } else{
-        buff.Append("close\r\n");
+void HttpResponse::AddContent_(ChainBuffer& buff) {
+    if(code_ == 304) {
+        buff.Append(encoded_ ? encoded_->validators : file_->validators);
+        buff.Append("\r\n", 2);
+        return;
     }
-    buff.Append("Content-type: " + GetFileType_() + "\r\n");
-}  //将完整的 HTTP 响应头写入缓冲区，供后续发送
-
-void HttpResponse::AddContent_(Buffer& buff) {
-    int srcFd = open((srcDir_ + path_).data(), O_RDONLY);  // 打开文件以仅可读  返回文件描述符
-    if(srcFd < 0) { 
-        ErrorContent(buff, "File NotFound!");
-        return; 
+    if(code_ == 206 || code_ == 416) {
+        AddRanges_(buff);
+        return;
+    }
+    if(!file_ || (FileLen() > 0 && !file_->data && file_->fd < 0)) {
+        ErrorContent(buff, code_ == 503 ? "Server busy, please retry later." : "File NotFound!");  // 文件打不开
+        return;
     }
-
-    /* 将文件映射到内存提高文件的访问速度 
-        MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
     LOG_DEBUG("file path %s", (srcDir_ + path_).data());  //    打印当前处理文件的路径
-    int* mmRet = (int*)mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if(*mmRet == -1) {
-        ErrorContent(buff, "File NotFound!");  // 如果映射失败，返回错误内容
-        return; 
+    if(encoded_) {
+        buff.Append(encoded_->header);
+        if(isHead_) { return; }
+        if(encoded_->file) {
+            const FileEntry& file = *encoded_->file;  // 预压缩文件
+            if(file.data) {
+                buff.AppendRef(file.data, encoded_->Len(), encoded_);
+            } else {
+                buff.AppendFile(file.fd, 0, encoded_->Len(), encoded_);
+            }
+        } else {
+            buff.AppendRef(encoded_->data.data(), encoded_->Len(), encoded_);
+        }
+        return;
     }
-    mmFile_ = (char*)mmRet;  // 将映射的文件指针赋值给 mmFile_
-    close(srcFd);  // 关闭源文件描述符  
-    buff.Append("Content-length: " + to_string(mmFileStat_.st_size) + "\r\n\r\n");
-    // 将文件内容添加到缓冲区
+    buff.Append(file_->header);  // 类型和长度在文件载入时已生成
+    AppendFile_(buff, 0, FileLen());
 }
 
-void HttpResponse::UnmapFile() {
-    if(mmFile_) {
-        //  如果不为空，说明当前有文件被映射到内存中，需要解除映射。
-        //  mmFile_：指向内存映射区域的起始地址。
-        //  mmFileStat_.st_size：映射区域的大小（即文件大小）。
-        munmap(mmFile_, mmFileStat_.st_size);
-        mmFile_ = nullptr;
+void HttpResponse::AddGenerated_(ChainBuffer& buff) {
+    static const char CACHE[] = "\r\nCache-Control: no-store\r\nContent-length: ";
+    buff.Append("Content-type: ", 14);
+    buff.Append(contentType_, strlen(contentType_));
+    buff.Append(CACHE, sizeof(CACHE) - 1);
+    char num[24];
+    char* end = num + sizeof(num);
+    char* p = FormatUint_(end, content_.size());
+    buff.Append(p, end - p);
+    buff.Append("\r\n\r\n", 4);
+    if(isHead_) {
+        content_.clear();
+        return;
     }
+    auto body = make_shared<const string>(std::move(content_));  // 发完即释放，不留在连接里
+    buff.AppendRef(body->data(), body->size(), body);
+    content_.clear();
 }
 
-string HttpResponse::GetFileType_() {
-    /* 判断文件类型 */
-    string::size_type idx = path_.find_last_of('.');  //没有找到返回 string::npos
-    if(idx == string::npos) {
-        // 没有后缀
-        return "text/plain";
+void HttpResponse::AppendFile_(ChainBuffer& buff, size_t offset, size_t len) {
+    if(len == 0 || isHead_) { return; }  // HEAD 的 Content-length 仍是文件长度，但不挂文件体
+    if(file_->data) {
+        buff.AppendRef(file_->data + offset, len, file_);  // 和响应头一起 writev
+    } else {
+        buff.AppendFile(file_->fd, offset, len, file_);  // 超过 mmap 阈值的大文件
     }
-    string suffix = path_.substr(idx);  // 获取文件后缀名
-    if(SUFFIX_TYPE.count(suffix) == 1) {
-        return SUFFIX_TYPE.find(suffix)->second;
+}
+
+string HttpResponse::ContentRange_(size_t first, size_t last, size_t size) {
+    return "Content-Range: bytes " + to_string(first) + "-" + to_string(last) + "/" + to_string(size) + "\r\n";
+}
+
+void HttpResponse::AddRanges_(ChainBuffer& buff) {
+    size_t size = FileLen();
+    if(code_ == 416) {
+        buff.Append("Content-Range: bytes */" + to_string(size) + "\r\nContent-length: 0\r\n\r\n");
+        return;
+    }
+    if(ranges_.size() == 1) {
+        size_t first = ranges_[0].first, last = ranges_[0].second;
+        buff.Append("Content-type: " + string(file_->type) + "\r\n" + file_->validators
+                    + ContentRange_(first, last, size)
+                    + "Content-length: " + to_string(last - first + 1) + "\r\n\r\n");
+        AppendFile_(buff, first, last - first + 1);
+        return;
+    }
+    /* 多个区间：每段前面是分隔串和本段的类型、范围，总长度要先算出来 */
+    vector<string> parts;
+    size_t total = 0;
+    for(const auto& r: ranges_) {
+        parts.push_back("\r\n--" + BOUNDARY + "\r\nContent-type: " + file_->type + "\r\n"
+                        + ContentRange_(r.first, r.second, size) + "\r\n");
+        total += parts.back().size() + r.second - r.first + 1;
+    }
+    string tail = "\r\n--" + BOUNDARY + "--\r\n";
+    total += tail.size();
+    buff.Append("Content-type: multipart/byteranges; boundary=" + BOUNDARY + "\r\n" + file_->validators
+                + "Content-length: " + to_string(total) + "\r\n\r\n");
+    if(isHead_) { return; }
+    for(size_t i = 0; i < ranges_.size(); i++) {
+        buff.Append(parts[i]);
+        AppendFile_(buff, ranges_[i].first, ranges_[i].second - ranges_[i].first + 1);
     }
-    return "text/plain";  // 如果后缀名不在 SUFFIX_TYPE 中，则默认为 "text/plain"
+    buff.Append(tail);
+}
+
+void HttpResponse::UnmapFile() {
+    file_.reset();
+    encoded_.reset();  // 映射由 FileCache 管理，最后一个引用释放时才会 munmap
 }
 
-void HttpResponse::ErrorContent(Buffer& buff, string message) 
+void HttpResponse::ErrorContent(ChainBuffer& buff, string message) 
 {
     //message 是错误信息
     string body;
@@ -185,7 +412,14 @@ void HttpResponse::ErrorContent(Buffer& buff, string message)
     body += "<p>" + message + "</p>";
     body += "<hr><em>TinyWebServer</em></body></html>";
 
-    buff.Append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
-    buff.Append(body);
+    static const char TYPE[] = "Content-type: text/html\r\nContent-length: ";
+    char head[sizeof(TYPE) + 24];
+    char* end = head + sizeof(head) - 4;
+    char* p = FormatUint_(end, body.size());
+    memcpy(end, "\r\n\r\n", 4);
+    p -= sizeof(TYPE) - 1;
+    memcpy(p, TYPE, sizeof(TYPE) - 1);
+    buff.Append(p, head + sizeof(head) - p);
+    if(!isHead_) { buff.Append(body); }
 }
 // 生成错误响应内容，将错误信息写入缓冲区
\ No newline at end of file
@@ -2,13 +2,19 @@
 #define HTTP_RESPONSE_H
 
 #include <unordered_map>
-#include <fcntl.h>       // open
-#include <unistd.h>      // close
+#include <vector>
+#include <array>
+#include <memory>
+#include <string_view>
+#include <time.h>        // strptime, timegm
+#include <string.h>      // memcpy
+#include <strings.h>     // strncasecmp
 #include <sys/stat.h>    // stat
-#include <sys/mman.h>    // mmap, munmap
 
-#include "../buffer/buffer.h"
+#include "../buffer/chainbuffer.h"
 #include "../log/log.h"
+#include "filecache.h"
+#include "compresscache.h"
 
 class HttpResponse {
 public:
@@ -17,33 +23,72 @@ public:
 
     void Init(const std::string& srcDir, std::string& path, bool isKeepAlive = false, int code = -1);
     // 生成HTTP响应内容
-    void MakeResponse(Buffer& buff);  //生成HTTP响应内容
-    void UnmapFile();  //取消内存映射
-    char* File();  // 获取内存映射的文件指针
-    size_t FileLen() const;   // 获取内存映射的文件长度
-    void ErrorContent(Buffer& buff, std::string message);  // 生成错误响应内容
+    void SetConditional(std::string_view ifNoneMatch, std::string_view ifModifiedSince) {
+        ifNoneMatch_ = ifNoneMatch;
+        ifModifiedSince_ = ifModifiedSince;
+    }  // GET/HEAD 请求的条件头，视图只需在 MakeResponse 之前有效
+    void SetRange(std::string_view range, std::string_view ifRange) {
+        range_ = range;
+        ifRange_ = ifRange;
+    }  // GET 请求的 Range / If-Range 头，同上
+    void SetAcceptEncoding(std::string_view acceptEncoding) {
+        acceptEncoding_ = acceptEncoding;
+    }  // 客户端接受的压缩编码，同上
+    void SetHead(bool isHead) { isHead_ = isHead; }  // HEAD 请求：头部照常生成（含 Content-length），不发响应体
+    void SetContent(const char* type, std::string body) {
+        contentType_ = type;
+        content_ = std::move(body);
+    }  // 响应体由调用方生成（如 /metrics），不查找文件
+    void MakeResponse(ChainBuffer& buff);  //生成HTTP响应内容
+    void UnmapFile();  //释放对缓存文件的引用
+    char* File();  // 获取内存映射的文件指针，大文件不映射时为 nullptr
+    size_t FileLen() const;   // 获取文件长度
+    void ErrorContent(ChainBuffer& buff, std::string message);  // 生成错误响应内容
     int Code() const { return code_; }  // 获取响应状态码
+    bool IsKeepAlive() const { return isKeepAlive_; }
 
 private:
-    void AddStateLine_(Buffer &buff);  // 添加状态行
-    void AddHeader_(Buffer &buff);  // 添加响应头
-    void AddContent_(Buffer &buff);  // 添加响应内容
+    void AddStateLine_(ChainBuffer &buff);  // 添加状态行和 Connection 头
+    void AddContent_(ChainBuffer &buff);  // 添加 Content-type/Content-length 和响应内容
+    void AddGenerated_(ChainBuffer &buff);  // SetContent 设置的响应体，不缓存
+    void AddRanges_(ChainBuffer &buff);  // 206 的单段或 multipart/byteranges 响应，以及 416
+    void AppendFile_(ChainBuffer &buff, size_t offset, size_t len);
+    // 文件体挂到写缓冲区：映射的文件挂映射区引用，大文件挂文件区间（sendfile），都不拷贝
 
     void ErrorHtml_();  // 添加错误响应内容
-    std::string GetFileType_();  // 获取文件类型
+    bool NotModified_() const;  // 条件请求的校验器与文件一致，应返回 304
+    void ChooseEncoding_();  // 按 Accept-Encoding 选择预压缩文件或现场压缩的缓存结果
+    bool AcceptsEncoding_(std::string_view coding) const;  // q=0 表示拒绝
+    bool ParseRange_();
+    // 解析 Range 到 ranges_，只保留可满足的区间；格式错误、If-Range 不匹配或区间过多时返回 false（发整个文件）
+
+    static char* FormatUint_(char* end, size_t value);  // 从 end 向前写十进制数，返回起点
+    static std::unordered_map<int, std::array<std::string, 2>> BuildHeaderBlock_();
+    static std::string ContentRange_(size_t first, size_t last, size_t size);
+    static std::string MakeBoundary_();
 
     int code_;  // 响应状态码  
     bool isKeepAlive_;  // 是否保持连接
+    bool isHead_;  // HEAD 请求，只发头部
 
     std::string path_;  // 请求的资源路径
     std::string srcDir_;  // 资源的物理路径
+    std::string_view ifNoneMatch_, ifModifiedSince_;  // 条件请求头，指向请求的读缓冲区
+    std::string_view range_, ifRange_;
+    std::string_view acceptEncoding_;
+    std::vector<std::pair<size_t, size_t>> ranges_;  // 要发送的区间 [first, last]
     
-    char* mmFile_;   // 内存映射的文件指针  使用这个指针来对内容进行访问
-    struct stat mmFileStat_;  // 内存映射的文件状态
+    std::shared_ptr<const FileEntry> file_;  // 来自 FileCache 的文件（映射 + stat），持有期间不会被解除映射
+    std::shared_ptr<const EncodedEntry> encoded_;  // 选中的压缩表示，没有时发送原文件
+    const char* contentType_;  // SetContent 设置的类型，nullptr 表示发送文件
+    std::string content_;
 
-    static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;  // 文件后缀名对应的类型
     static const std::unordered_map<int, std::string> CODE_STATUS;  // 状态码对应的描述
     static const std::unordered_map<int, std::string> CODE_PATH; // 状态码对应的错误页面路径
+    static const std::unordered_map<int, std::array<std::string, 2>> HEADER_BLOCK;
+    // 状态码 -> {close, keep-alive} 时的状态行 + Connection 头，启动时生成后只读
+    static const std::string BOUNDARY;  // multipart/byteranges 的分隔串，启动时随机生成
+    static const size_t MAX_RANGES = 16;  // 一个请求最多的区间数，防止用大量重叠区间放大响应
 };
 
 
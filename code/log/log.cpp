@@ -2,187 +2,338 @@
  * @Author       : mark
  * @Date         : 2020-06-16
  * @copyleft Apache 2.0
- */ 
+ */
 #include "log.h"
 
+#include <algorithm>  // find
+
 using namespace std;
 
 Log::Log() {
     lineCount_ = 0;
+    fileIndex_ = 0;
     isAsync_ = false;
+    isRunning_ = false;
+    sweep_ = false;
+    maxBuffers_ = 0;
+    dropped_ = 0;
+    reported_ = 0;
+    flushSec_ = 0;
+    isOpen_ = false;
+    level_ = 1;
     writeThread_ = nullptr;
-    deque_ = nullptr;
     toDay_ = 0;
     fp_ = nullptr;
 }
 
 Log::~Log() {
-    if(writeThread_ && writeThread_->joinable()) {
-        while(!deque_->empty()) {
-            deque_->flush();
-        };
-        deque_->Close();
-        writeThread_->join();
-    }
+    StopThread_();
     if(fp_) {
         lock_guard<mutex> locker(mtx_);
-        flush();
+        fflush(fp_);
         fclose(fp_);
     }
 }
 
 int Log::GetLevel() {
-    lock_guard<mutex> locker(mtx_);
-    return level_;
+    return level_.load(std::memory_order_relaxed);  // 每条日志都要判断，不加锁
 }
 
 void Log::SetLevel(int level) {
-    lock_guard<mutex> locker(mtx_);
     level_ = level;
 }
 
 void Log::init(int level = 1, const char* path, const char* suffix,
     int maxQueueSize) {
-    isOpen_ = true;
+    StopThread_();  // 重新初始化前先把旧配置下缓冲的日志写完
     level_ = level;
-    if(maxQueueSize > 0) {
-        isAsync_ = true;
-        if(!deque_) {
-            unique_ptr<BlockDeque<std::string>> newDeque(new BlockDeque<std::string>);
-            deque_ = move(newDeque);
-            
-            std::unique_ptr<std::thread> NewThread(new thread(FlushLogThread));
-            writeThread_ = move(NewThread);
-        }
-    } else {
-        isAsync_ = false;
-    }
-
-    lineCount_ = 0;
-
-    time_t timer = time(nullptr);
-    struct tm *sysTime = localtime(&timer);
-    struct tm t = *sysTime;
     path_ = path;
     suffix_ = suffix;
-    char fileName[LOG_NAME_LEN] = {0};
-    snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s", 
-            path_, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, suffix_);
-    toDay_ = t.tm_mday;
 
+    time_t timer = time(nullptr);
+    struct tm t;
+    localtime_r(&timer, &t);
     {
         lock_guard<mutex> locker(mtx_);
-        buff_.RetrieveAll();
-        if(fp_) { 
-            flush();
-            fclose(fp_); 
+        toDay_ = t.tm_mday;
+        lineCount_ = 0;
+        if(fp_) {
+            fflush(fp_);
+            fclose(fp_);
+            fp_ = nullptr;
         }
+        OpenFile_(0);
+        assert(fp_ != nullptr);
 
+        isAsync_ = maxQueueSize > 0;
+        if(isAsync_) {
+            maxBuffers_ = maxQueueSize;
+            reported_ = dropped_;
+            buffers_.clear();
+            isRunning_ = true;
+            writeThread_.reset(new thread(FlushLogThread));
+        }
+    }
+    isOpen_ = true;
+}
+
+void Log::OpenFile_(int index) {
+    time_t timer = time(nullptr);
+    struct tm t;
+    localtime_r(&timer, &t);
+    char fileName[LOG_NAME_LEN] = {0};
+    if(index == 0) {
+        snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s",
+                path_.c_str(), t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, suffix_.c_str());
+    } else {
+        snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d-%d%s",
+                path_.c_str(), t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, index, suffix_.c_str());
+    }
+    fileIndex_ = index;
+
+    if(fp_) {
+        fflush(fp_);
+        fclose(fp_);
+    }
+    fp_ = fopen(fileName, "a");
+    if(fp_ == nullptr) {
+        mkdir(path_.c_str(), 0777);
         fp_ = fopen(fileName, "a");
-        if(fp_ == nullptr) {
-            mkdir(path_, 0777);
-            fp_ = fopen(fileName, "a");
-        } 
-        assert(fp_ != nullptr);
     }
+    assert(fp_ != nullptr);
 }
 
 void Log::write(int level, const char *format, ...) {
+    /* 每个线程在自己的栈外缓冲区里格式化，时间前缀按秒缓存，只有秒变化时才调用 localtime_r */
+    thread_local char line[LOG_LINE_LEN];
+    thread_local time_t cachedSec = -1;
+    thread_local char cachedTime[32];
+    thread_local size_t cachedLen = 0;
+    thread_local int cachedDay = 0;
+
     struct timeval now = {0, 0};
     gettimeofday(&now, nullptr);
-    time_t tSec = now.tv_sec;
-    struct tm *sysTime = localtime(&tSec);
-    struct tm t = *sysTime;
+    if(now.tv_sec != cachedSec) {
+        struct tm t;
+        localtime_r(&now.tv_sec, &t);
+        cachedLen = snprintf(cachedTime, sizeof(cachedTime), "%d-%02d-%02d %02d:%02d:%02d.",
+                    t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+                    t.tm_hour, t.tm_min, t.tm_sec);
+        cachedSec = now.tv_sec;
+        cachedDay = t.tm_mday;
+    }
+    size_t n = cachedLen;
+    memcpy(line, cachedTime, n);
+    long usec = now.tv_usec;
+    for(int i = 5; i >= 0; i--) {
+        line[n + i] = '0' + usec % 10;
+        usec /= 10;
+    }
+    n += 6;
+    line[n++] = ' ';
+    memcpy(line + n, LevelTitle_(level), 9);
+    n += 9;
+
     va_list vaList;
+    va_start(vaList, format);
+    int m = vsnprintf(line + n, LOG_LINE_LEN - n - 1, format, vaList);
+    va_end(vaList);
+    if(m > 0) {
+        n += min(static_cast<size_t>(m), LOG_LINE_LEN - n - 2);  // 超长时截断
+    }
+    line[n++] = '\n';
+
+    Append_(line, n, level, now.tv_sec, cachedDay);
+}
 
-    /* 日志日期 日志行数 */
-    if (toDay_ != t.tm_mday || (lineCount_ && (lineCount_  %  MAX_LINES == 0)))
+void Log::Append_(const char* line, size_t len, int level, time_t sec, int day) {
+    if(!isAsync_.load(std::memory_order_relaxed)) {
+        /* 同步模式：写入 stdio 缓冲，每秒最多 fflush 一次；WARN/ERROR 马上落盘，进程随后崩溃也不丢 */
+        lock_guard<mutex> locker(mtx_);
+        WriteFile_(line, len, 1, day);
+        if(level >= 2 || sec != flushSec_) {
+            fflush(fp_);
+            flushSec_ = sec;
+        }
+        return;
+    }
+    Staging_& staging = LocalStaging_();
+    unique_lock<mutex> stagingLocker(staging.mtx);
+    if(staging.buf && staging.buf->Avail() >= len) {
+        staging.buf->Append(line, len);
+        return;
+    }
+    /* 写满了：交给后台线程，换一个空缓冲区。先放开自己的锁，加锁顺序始终是 mtx_ 在前 */
+    unique_ptr<LogBuffer_> full = move(staging.buf);
+    stagingLocker.unlock();
+    unique_ptr<LogBuffer_> fresh;
     {
-        unique_lock<mutex> locker(mtx_);
-        locker.unlock();
-        
-        char newFile[LOG_NAME_LEN];
-        char tail[36] = {0};
-        snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
-
-        if (toDay_ != t.tm_mday)
-        {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", path_, tail, suffix_);
-            toDay_ = t.tm_mday;
-            lineCount_ = 0;
+        lock_guard<mutex> locker(mtx_);
+        if(full && buffers_.size() < maxBuffers_) {
+            buffers_.push_back(move(full));
+            cond_.notify_one();
+        } else if(full) {
+            dropped_.fetch_add(full->lines, std::memory_order_relaxed);
+            full->Reset();  // 后台写盘跟不上，丢弃这一批，避免内存无限增长
+            fresh = move(full);
         }
-        else {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", path_, tail, (lineCount_  / MAX_LINES), suffix_);
+        if(!fresh && !freeBuffers_.empty()) {
+            fresh = move(freeBuffers_.back());
+            freeBuffers_.pop_back();
         }
-        
-        locker.lock();
-        flush();
-        fclose(fp_);
-        fp_ = fopen(newFile, "a");
-        assert(fp_ != nullptr);
     }
+    if(!fresh) { fresh.reset(new LogBuffer_); }  // 锁外分配
+    fresh->Append(line, len);
+    stagingLocker.lock();
+    staging.buf = move(fresh);
+}
 
-    {
-        unique_lock<mutex> locker(mtx_);
-        lineCount_++;
-        int n = snprintf(buff_.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
-                    t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-                    t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
-                    
-        buff_.HasWritten(n);
-        AppendLogLevelTitle_(level);
-
-        va_start(vaList, format);
-        int m = vsnprintf(buff_.BeginWrite(), buff_.WritableBytes(), format, vaList);
-        va_end(vaList);
-
-        buff_.HasWritten(m);
-        buff_.Append("\n\0", 2);
-
-        if(isAsync_ && deque_ && !deque_->full()) {
-            deque_->push_back(buff_.RetrieveAllToStr());
-        } else {
-            fputs(buff_.Peek(), fp_);
+Log::Staging_& Log::LocalStaging_() {
+    thread_local Staging_ staging;
+    if(!staging.registered) {
+        lock_guard<mutex> locker(mtx_);
+        stagings_.push_back(&staging);
+        staging.registered = true;
+    }
+    return staging;
+}
+
+void Log::Retire_(Staging_* staging) {
+    lock_guard<mutex> locker(mtx_);
+    stagings_.erase(find(stagings_.begin(), stagings_.end(), staging));
+    lock_guard<mutex> stagingLocker(staging->mtx);
+    if(staging->buf && staging->buf->len > 0 && isRunning_) {
+        buffers_.push_back(move(staging->buf));  // 线程退出前没写满的日志交给后台线程
+        cond_.notify_one();
+    }
+}
+
+void Log::WriteFile_(const char* data, size_t len, int lines, int day) {
+    if(toDay_ != day) {
+        /* 日期变化：切到新一天的文件 */
+        toDay_ = day;
+        lineCount_ = 0;
+        OpenFile_(0);
+    }
+    while(lines > 0) {
+        if(lineCount_ >= (fileIndex_ + 1) * MAX_LINES) {
+            OpenFile_(lineCount_ / MAX_LINES);  // 单个文件行数达到上限
+        }
+        int room = (fileIndex_ + 1) * MAX_LINES - lineCount_;
+        if(lines <= room) {
+            fwrite(data, 1, len, fp_);
+            lineCount_ += lines;
+            return;
         }
-        buff_.RetrieveAll();
+        /* 一批日志跨过了行数上限：写到第 room 行为止，剩下的写进下一个文件 */
+        const char* end = data;
+        for(int i = 0; i < room; i++) {
+            end = static_cast<const char*>(memchr(end, '\n', data + len - end)) + 1;
+        }
+        fwrite(data, 1, end - data, fp_);
+        lineCount_ += room;
+        lines -= room;
+        len -= end - data;
+        data = end;
     }
 }
 
-void Log::AppendLogLevelTitle_(int level) {
+const char* Log::LevelTitle_(int level) {
     switch(level) {
     case 0:
-        buff_.Append("[debug]: ", 9);
-        break;
+        return "[debug]: ";
     case 1:
-        buff_.Append("[info] : ", 9);
-        break;
+        return "[info] : ";
     case 2:
-        buff_.Append("[warn] : ", 9);
-        break;
+        return "[warn] : ";
     case 3:
-        buff_.Append("[error]: ", 9);
-        break;
+        return "[error]: ";
     default:
-        buff_.Append("[info] : ", 9);
-        break;
+        return "[info] : ";
     }
 }
 
 void Log::flush() {
-    if(isAsync_) { 
-        deque_->flush(); 
+    lock_guard<mutex> locker(mtx_);
+    if(isAsync_) {
+        sweep_ = true;
+        cond_.notify_one();  // 让后台线程马上收走各线程的日志，写出并 fflush
+        return;
     }
-    fflush(fp_);
+    if(fp_) { fflush(fp_); }
 }
 
 void Log::AsyncWrite_() {
-    string str = "";
-    while(deque_->pop(str)) {
-        lock_guard<mutex> locker(mtx_);
-        fputs(str.c_str(), fp_);
+    vector<unique_ptr<LogBuffer_>> toWrite;
+    auto lastSweep = chrono::steady_clock::now();
+    bool running = true;
+    while(running) {
+        {
+            unique_lock<mutex> locker(mtx_);
+            if(buffers_.empty() && isRunning_ && !sweep_) {
+                cond_.wait_for(locker, chrono::seconds(FLUSH_INTERVAL));
+            }
+            toWrite.swap(buffers_);
+            /* 忙时只写整块；空闲超时、flush、退出或距上次超过 FLUSH_INTERVAL 时，
+               才把各线程未写满的缓冲区换下来。同一线程写满的缓冲区已在 toWrite 前面，先后顺序不变 */
+            auto now = chrono::steady_clock::now();
+            if(toWrite.empty() || sweep_ || !isRunning_ || now - lastSweep >= chrono::seconds(FLUSH_INTERVAL)) {
+                for(Staging_* staging: stagings_) {
+                    lock_guard<mutex> stagingLocker(staging->mtx);
+                    if(staging->buf && staging->buf->len > 0) {
+                        toWrite.push_back(move(staging->buf));  // 前台下次追加时再取空缓冲区
+                    }
+                }
+                sweep_ = false;
+                lastSweep = now;
+            }
+            running = isRunning_;
+        }
+
+        /* 锁外写文件，前台线程可以继续追加 */
+        time_t timer = time(nullptr);
+        struct tm t;
+        localtime_r(&timer, &t);
+        for(auto& buff: toWrite) {
+            WriteFile_(buff->data.get(), buff->len, buff->lines, t.tm_mday);
+        }
+        size_t dropped = dropped_.load(std::memory_order_relaxed);
+        if(dropped != reported_) {
+            /* 丢弃的日志在文件里留一行记录，看日志的人知道中间缺了多少 */
+            char note[160];
+            int n = snprintf(note, sizeof(note), "%d-%02d-%02d %02d:%02d:%02d.000000 %sLog dropped %zu line(s), "
+                             "backlog exceeded %zu buffer(s)\n", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+                             t.tm_hour, t.tm_min, t.tm_sec, LevelTitle_(2), dropped - reported_, maxBuffers_);
+            WriteFile_(note, n, 1, t.tm_mday);
+            reported_ = dropped;
+        }
+        fflush(fp_);
+
+        /* 回收缓冲区给前台复用，多余的释放 */
+        {
+            lock_guard<mutex> locker(mtx_);
+            for(auto& buff: toWrite) {
+                if(freeBuffers_.size() >= MAX_FREE_BUFFERS) { break; }
+                buff->Reset();
+                freeBuffers_.push_back(move(buff));
+            }
+        }
+        toWrite.clear();
     }
 }
 
+void Log::StopThread_() {
+    if(writeThread_ && writeThread_->joinable()) {
+        {
+            lock_guard<mutex> locker(mtx_);
+            isRunning_ = false;
+        }
+        cond_.notify_one();
+        writeThread_->join();  // 后台线程退出前会写完所有缓冲区
+    }
+    writeThread_ = nullptr;
+}
+
 Log* Log::Instance() {
     static Log inst;
     return &inst;
@@ -190,4 +341,4 @@ Log* Log::Instance() {
 
 void Log::FlushLogThread() {
     Log::Instance()->AsyncWrite_();
-}
\ No newline at end of file
+}
@@ -2,66 +2,116 @@
  * @Author       : mark
  * @Date         : 2020-06-16
  * @copyleft Apache 2.0
- */ 
+ */
 #ifndef LOG_H
 #define LOG_H
 
 #include <mutex>
 #include <string>
 #include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <condition_variable>
 #include <sys/time.h>
 #include <string.h>
 #include <stdarg.h>           // vastart va_end
 #include <assert.h>
 #include <sys/stat.h>         //mkdir
-#include "blockqueue.h"
-#include "../buffer/buffer.h"
 
 class Log {
 public:
-    void init(int level, const char* path = "./log", 
+    void init(int level, const char* path = "./log",
                 const char* suffix =".log",
                 int maxQueueCapacity = 1024);
+    // maxQueueCapacity > 0 时为异步模式：前台只做格式化和一次 memcpy，后台线程批量写文件；
+    // 不同线程的日志按缓冲区成批写出，文件里只保证同一线程内的先后顺序。
+    // maxQueueCapacity 是最多积压的缓冲区数（每个 BUFFER_SIZE 字节），磁盘跟不上时超出的整批丢弃并计数。
+    // 0 为同步模式：秒数变化时和每条 WARN/ERROR 之后 fflush
 
     static Log* Instance();
     static void FlushLogThread();
 
     void write(int level, const char *format,...);
-    void flush();
+    void flush();  // 异步模式下只是唤醒后台线程，不会阻塞调用方
+    size_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }  // 因积压超限丢弃的行数
 
     int GetLevel();
     void SetLevel(int level);
-    bool IsOpen() { return isOpen_; }
-    
+    bool IsOpen() { return isOpen_.load(std::memory_order_relaxed); }
+
 private:
     Log();
-    void AppendLogLevelTitle_(int level);
     virtual ~Log();
-    void AsyncWrite_();
+    struct Staging_;
+    void Append_(const char* line, size_t len, int level, time_t sec, int day);
+    // 把格式化好的一行放进本线程的暂存缓冲区或直接写文件
+    Staging_& LocalStaging_();  // 本线程的暂存缓冲区，首次使用时登记
+    void Retire_(Staging_* staging);  // 线程退出：交出剩余日志并注销
+    void AsyncWrite_();  // 后台线程：收集写满的缓冲区并写文件
+    void WriteFile_(const char* data, size_t len, int lines, int day);  // 写文件，按日期和行数切分
+    void OpenFile_(int index);  // 打开当天的第 index 个日志文件
+    void StopThread_();  // 把已缓冲的日志全部写完并结束后台线程
+
+    static const char* LevelTitle_(int level);
 
 private:
     static const int LOG_PATH_LEN = 256;
     static const int LOG_NAME_LEN = 256;
     static const int MAX_LINES = 50000;
+    static const size_t LOG_LINE_LEN = 4096;  // 单行最大长度
+    static const size_t BUFFER_SIZE = 64 << 10;  // 每个前台线程的暂存缓冲区大小
+    static const size_t MAX_FREE_BUFFERS = 64;  // 写完后留着复用的缓冲区个数
+    static constexpr int FLUSH_INTERVAL = 3;  // 后台线程最长刷盘间隔（秒）
+
+    struct LogBuffer_ {
+        LogBuffer_(): data(new char[BUFFER_SIZE]), len(0), lines(0) {}
+        size_t Avail() const { return BUFFER_SIZE - len; }
+        void Append(const char* line, size_t n) {
+            memcpy(data.get() + len, line, n);
+            len += n;
+            lines++;
+        }
+        void Reset() { len = 0; lines = 0; }
+
+        std::unique_ptr<char[]> data;
+        size_t len;
+        int lines;
+    };
 
-    const char* path_;
-    const char* suffix_;
+    /* 每个前台线程一个暂存缓冲区：追加时只锁自己的 mtx，不同线程之间不争锁；
+       这把锁只有后台线程在超时、flush 或退出时收走未写满的缓冲区时才会碰 */
+    struct Staging_ {
+        ~Staging_() { if(registered) { Log::Instance()->Retire_(this); } }
+        std::mutex mtx;
+        std::unique_ptr<LogBuffer_> buf;
+        bool registered = false;
+    };
 
-    int MAX_LINES_;
+    std::string path_;  // 复制一份：调用方的字符串（如配置）可能先于日志析构
+    std::string suffix_;
 
-    int lineCount_;
+    int lineCount_;  // 当天已写入的行数（只在写文件的线程里访问）
+    int fileIndex_;  // 当天第几个文件
     int toDay_;
 
-    bool isOpen_;
- 
-    Buffer buff_;
-    int level_;
-    bool isAsync_;
+    std::atomic<bool> isOpen_;
+    std::atomic<int> level_;
+    std::atomic<bool> isAsync_;
+    bool isRunning_;  // 后台线程是否应继续运行
+    bool sweep_;  // 下一轮把各线程未写满的缓冲区也收走（flush 时置位）
+    size_t maxBuffers_;  // 积压的缓冲区上限，超出时丢弃（磁盘跟不上时保护内存）
+    std::atomic<size_t> dropped_;  // 累计丢弃的行数
+    size_t reported_;  // 已在日志文件里报告过的丢弃行数（只在后台线程访问）
+    time_t flushSec_;  // 同步模式下上次 fflush 的秒数
 
     FILE* fp_;
-    std::unique_ptr<BlockDeque<std::string>> deque_; 
+    std::vector<Staging_*> stagings_;  // 已登记的前台线程
+    std::vector<std::unique_ptr<LogBuffer_>> buffers_;  // 已写满、待后台写出的缓冲区，同一线程的按写入顺序排列
+    std::vector<std::unique_ptr<LogBuffer_>> freeBuffers_;  // 写完后回收的空缓冲区
     std::unique_ptr<std::thread> writeThread_;
-    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::mutex mtx_;  // 保护文件、buffers_、freeBuffers_ 和 stagings_，前台线程每写满一个缓冲区才拿一次
 };
 
 #define LOG_BASE(level, format, ...) \
@@ -69,7 +119,6 @@ private:
         Log* log = Log::Instance();\
         if (log->IsOpen() && log->GetLevel() <= level) {\
             log->write(level, format, ##__VA_ARGS__); \
-            log->flush();\
         }\
     } while(0);
 
@@ -78,4 +127,4 @@ private:
 #define LOG_WARN(format, ...) do {LOG_BASE(2, format, ##__VA_ARGS__)} while(0);
 #define LOG_ERROR(format, ...) do {LOG_BASE(3, format, ##__VA_ARGS__)} while(0);
 
-#endif //LOG_H
\ No newline at end of file
+#endif //LOG_H
@@ -1,14 +1,32 @@
 #include <unistd.h>
+#include <string.h>
 #include "server/webserver.h"
 
-int main() {
+int main(int argc, char* argv[]) {
     /* 守护进程 后台运行 */
     //daemon(1, 0); 
 
-    WebServer server(
-        1316, 3, 60000, false,             /* 端口 ET模式 timeoutMs 优雅退出  */
-        3306, "root", "root", "webserver", /* Mysql配置 */
-        12, 6, true, 1, 1024);             /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+    /* 参数取值：默认值 < 配置文件（-c 指定，或工作目录下的 server.conf）< 命令行 --section.key=value */
+    bool printConfig = false;
+    int n = 1;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            Config::Usage(argv[0]);
+            return 0;
+        }
+        if(strcmp(argv[i], "--print-config") == 0) { printConfig = true; }  // 输出最终取值后退出
+        else { argv[n++] = argv[i]; }
+    }
+    Config config;
+    std::string err;
+    if(!config.ParseArgs(n, argv, &err)) {
+        fprintf(stderr, "%s\n", err.c_str());
+        return 1;
+    }
+    if(printConfig) {
+        printf("%s", config.Dump().c_str());
+        return 0;
+    }
+    WebServer server(config);
     server.Start();
 } 
-  
\ No newline at end of file
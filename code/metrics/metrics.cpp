@@ -0,0 +1,227 @@
+#include "metrics.h"
+#include "../http/httpconn.h"
+#include "../http/compresscache.h"
+#include "../pool/usercache.h"
+#include "../buffer/bufferpool.h"
+
+using namespace std;
+
+bool Metrics::enabled_ = true;
+thread_local Metrics::ThreadData_* Metrics::local_ = nullptr;
+
+Metrics::ThreadData_::ThreadData_() {
+    for(auto& counter: counters) { counter.store(0, memory_order_relaxed); }
+    for(auto& code: codes) { code.store(0, memory_order_relaxed); }
+    for(auto& stage: stages) {
+        for(auto& bucket: stage.buckets) { bucket.store(0, memory_order_relaxed); }
+        stage.count.store(0, memory_order_relaxed);
+        stage.sum.store(0, memory_order_relaxed);
+    }
+}
+
+Metrics::Metrics(): path_("/metrics") {}
+
+Metrics* Metrics::Instance() {
+    /* 不析构：退出时仍在运行的线程记录指标也不会访问已销毁的对象 */
+    static Metrics* inst = new Metrics();
+    return inst;
+}
+
+void Metrics::Init(bool enable, const string& path) {
+    enabled_ = enable;
+    path_ = path;
+}
+
+Metrics::ThreadData_* Metrics::Register_() {
+    unique_ptr<ThreadData_> data(new ThreadData_());
+    ThreadData_* p = data.get();
+    lock_guard<mutex> locker(mtx_);
+    locals_.push_back(std::move(data));
+    return p;
+}
+
+int Metrics::CodeIndex_(int code) {
+    switch(code) {
+        case 100: return 0;
+        case 200: return 1;
+        case 206: return 2;
+        case 304: return 3;
+        case 400: return 4;
+        case 403: return 5;
+        case 404: return 6;
+        case 416: return 7;
+        default: return 8;
+    }
+}
+
+void Metrics::CountResponse(int code) {
+    if(!enabled_) { return; }
+    Inc_(Local_().codes[CodeIndex_(code)], 1);
+}
+
+uint64_t Metrics::Total(COUNTER counter) {
+    uint64_t total = 0;
+    lock_guard<mutex> locker(mtx_);
+    for(const auto& local: locals_) {
+        total += local->counters[counter].load(memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t Metrics::BucketMax(int bucket) {
+    assert(bucket >= 0 && bucket < BUCKETS);
+    if(bucket < SUB_BUCKETS) { return bucket; }
+    if(bucket == BUCKETS - 1) { return UINT64_MAX; }  // 兼收超出范围的值
+    int exp = bucket / SUB_BUCKETS + SUB_BITS - 1;
+    uint64_t width = uint64_t(1) << (exp - SUB_BITS);
+    return uint64_t(SUB_BUCKETS + bucket % SUB_BUCKETS) * width + width - 1;
+}
+
+uint64_t Metrics::Snapshot::CountAtMost(uint64_t ns) const {
+    uint64_t total = 0;
+    for(int i = 0; i < BUCKETS && BucketMax(i) <= ns; i++) {
+        total += buckets[i];
+    }
+    return total;
+}
+
+uint64_t Metrics::Snapshot::Quantile(double q) const {
+    if(count == 0) { return 0; }
+    uint64_t rank = static_cast<uint64_t>(q * count);
+    uint64_t seen = 0;
+    for(int i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if(seen > rank) { return BucketMax(i); }
+    }
+    return BucketMax(BUCKETS - 1);
+}
+
+Metrics::Snapshot Metrics::Merge(STAGE stage) {
+    Snapshot snap;
+    snap.buckets.assign(BUCKETS, 0);
+    lock_guard<mutex> locker(mtx_);
+    for(const auto& local: locals_) {
+        const Histogram_& h = local->stages[stage];
+        for(int i = 0; i < BUCKETS; i++) {
+            snap.buckets[i] += h.buckets[i].load(memory_order_relaxed);
+        }
+        snap.sum += h.sum.load(memory_order_relaxed);
+    }
+    /* count 按桶重新求和，和各桶的计数保持一致（写线程可能正在两次写入之间） */
+    for(uint64_t n: snap.buckets) { snap.count += n; }
+    return snap;
+}
+
+static void AppendLine(string& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void AppendLine(string& out, const char* fmt, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if(n > 0) { out.append(line, min<size_t>(n, sizeof(line) - 1)); }
+    out += '\n';
+}
+
+static void AppendMetric(string& out, const char* name, const char* type, const char* help) {
+    AppendLine(out, "# HELP webserver_%s %s", name, help);
+    AppendLine(out, "# TYPE webserver_%s %s", name, type);
+}
+
+string Metrics::Render() {
+    /* 对外的桶边界（秒），由细粒度的 HDR 桶按上界归并得到 */
+    static const struct { const char* le; uint64_t ns; } BOUNDS[] = {
+        { "0.000001", 1000 }, { "0.0000025", 2500 }, { "0.000005", 5000 },
+        { "0.00001", 10000 }, { "0.000025", 25000 }, { "0.00005", 50000 },
+        { "0.0001", 100000 }, { "0.00025", 250000 }, { "0.0005", 500000 },
+        { "0.001", 1000000 }, { "0.0025", 2500000 }, { "0.005", 5000000 },
+        { "0.01", 10000000 }, { "0.025", 25000000 }, { "0.05", 50000000 },
+        { "0.1", 100000000 }, { "0.25", 250000000 }, { "0.5", 500000000 },
+        { "1", 1000000000 }, { "2.5", 2500000000 }, { "5", 5000000000 },
+        { "10", 10000000000 }, { "30", 30000000000 }, { "60", 60000000000 },
+        { "300", 300000000000 }, { "3600", 3600000000000 },
+    };
+    static const struct { const char* name; const char* help; } STAGES[STAGE_COUNT] = {
+        { "queue_wait_seconds", "Time read/write tasks wait in the thread pool queue." },
+        { "request_parse_seconds", "Time spent parsing one request." },
+        { "response_build_seconds", "Time spent building one response." },
+        { "write_seconds", "Time spent in one write to the socket (writev/sendfile)." },
+        { "db_query_seconds", "Time of one login/register query, including pool wait." },
+        { "connection_lifetime_seconds", "Time from accept to close." },
+        { "event_loop_batch_seconds", "Time to dispatch one batch of epoll events." },
+    };
+    static const struct { const char* name; const char* help; } COUNTERS[COUNTER_COUNT] = {
+        { "connections_accepted_total", "Accepted connections." },
+        { "connections_closed_total", "Closed connections." },
+        { "read_bytes_total", "Bytes read from clients." },
+        { "written_bytes_total", "Bytes written to clients." },
+        { "epoll_waits_total", "epoll_wait (io_uring_enter for the io_uring backend) calls that returned events." },
+        { "epoll_events_total", "Events returned by epoll_wait (completions reaped for the io_uring backend)." },
+        { "epoll_ctl_total", "epoll_ctl calls (add/mod/del)." },
+        { "read_calls_total", "readv calls (recv completions for io_uring) on client connections." },
+        { "write_calls_total", "writev/sendfile calls (sendmsg completions for io_uring) on client connections." },
+    };
+    static const char* CODES[CODE_COUNT] = { "100", "200", "206", "304", "400", "403", "404", "416", "other" };
+
+    uint64_t counters[COUNTER_COUNT] = { 0 };
+    uint64_t codes[CODE_COUNT] = { 0 };
+    {
+        lock_guard<mutex> locker(mtx_);
+        for(const auto& local: locals_) {
+            for(int i = 0; i < COUNTER_COUNT; i++) { counters[i] += local->counters[i].load(memory_order_relaxed); }
+            for(int i = 0; i < CODE_COUNT; i++) { codes[i] += local->codes[i].load(memory_order_relaxed); }
+        }
+    }
+
+    string out;
+    out.reserve(16 << 10);
+    for(int i = 0; i < COUNTER_COUNT; i++) {
+        AppendMetric(out, COUNTERS[i].name, "counter", COUNTERS[i].help);
+        AppendLine(out, "webserver_%s %lu", COUNTERS[i].name, (unsigned long)counters[i]);
+    }
+    AppendMetric(out, "responses_total", "counter", "Responses by status code.");
+    for(int i = 0; i < CODE_COUNT; i++) {
+        AppendLine(out, "webserver_responses_total{code=\"%s\"} %lu", CODES[i], (unsigned long)codes[i]);
+    }
+    AppendMetric(out, "connections", "gauge", "Open connections.");
+    AppendLine(out, "webserver_connections %d", (int)HttpConn::userCount);
+
+    for(int s = 0; s < STAGE_COUNT; s++) {
+        Snapshot snap = Merge(static_cast<STAGE>(s));
+        const char* name = STAGES[s].name;
+        AppendMetric(out, name, "histogram", STAGES[s].help);
+        for(const auto& bound: BOUNDS) {
+            AppendLine(out, "webserver_%s_bucket{le=\"%s\"} %lu", name, bound.le,
+                       (unsigned long)snap.CountAtMost(bound.ns));
+        }
+        AppendLine(out, "webserver_%s_bucket{le=\"+Inf\"} %lu", name, (unsigned long)snap.count);
+        AppendLine(out, "webserver_%s_sum %.9f", name, snap.sum / 1e9);
+        AppendLine(out, "webserver_%s_count %lu", name, (unsigned long)snap.count);
+    }
+
+    CompressCache::Stats compress = CompressCache::Instance()->GetStats();
+    AppendMetric(out, "compress_cache_hits_total", "counter", "Compressed bodies served from cache.");
+    AppendLine(out, "webserver_compress_cache_hits_total %zu", compress.hits);
+    AppendMetric(out, "compress_cache_misses_total", "counter", "Bodies compressed on demand.");
+    AppendLine(out, "webserver_compress_cache_misses_total %zu", compress.misses);
+    AppendMetric(out, "compress_cache_bytes", "gauge", "Bytes held by the compress cache.");
+    AppendLine(out, "webserver_compress_cache_bytes %zu", compress.bytes);
+
+    UserCache::Stats user = UserCache::Instance()->GetStats();
+    AppendMetric(out, "user_cache_lookups_total", "counter", "User cache lookups by result.");
+    AppendLine(out, "webserver_user_cache_lookups_total{result=\"hit\"} %zu", user.hits);
+    AppendLine(out, "webserver_user_cache_lookups_total{result=\"negative_hit\"} %zu", user.negativeHits);
+    AppendLine(out, "webserver_user_cache_lookups_total{result=\"miss\"} %zu", user.misses);
+    AppendMetric(out, "user_cache_entries", "gauge", "Entries in the user cache.");
+    AppendLine(out, "webserver_user_cache_entries %zu", user.entries);
+
+    BufferPool::Stats pool = BufferPool::Instance()->GetStats();
+    AppendMetric(out, "buffer_pool_allocs_total", "counter", "Buffer allocations.");
+    AppendLine(out, "webserver_buffer_pool_allocs_total %zu", pool.allocs);
+    AppendMetric(out, "buffer_pool_mallocs_total", "counter", "Buffer allocations that fell through to malloc.");
+    AppendLine(out, "webserver_buffer_pool_mallocs_total %zu", pool.mallocs);
+    AppendMetric(out, "buffer_pool_free_bytes", "gauge", "Free bytes in the global buffer pool.");
+    AppendLine(out, "webserver_buffer_pool_free_bytes %zu", pool.pooled);
+    return out;
+}
@@ -0,0 +1,155 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <time.h>     // clock_gettime
+
+/* 运行时指标：每个线程一份计数器和直方图，只有本线程写，用 relaxed 原子读写、不加锁；
+   /metrics 请求到来时把所有线程的数据合并，输出 Prometheus 文本格式。
+   直方图按 HDR 的方式分桶：2 的幂为一级，每级再等分 16 个子桶，相对误差不超过 1/16 */
+class Metrics {
+public:
+    enum STAGE {
+        QUEUE_WAIT = 0,  // 读写任务在线程池队列中的等待
+        PARSE,           // 一个请求在 HttpRequest::parse 中花的时间（跨多次读取累计）
+        RESPONSE,        // 生成一个响应（查文件缓存、拼响应头）
+        WRITE,           // 一次 write：writev/sendfile 直到发完或 EAGAIN
+        DB,              // 一次登录/注册查库，含等待连接池
+        CONN_LIFETIME,   // 连接从 accept 到关闭
+        LOOP,            // epoll_wait 返回后处理这一批事件
+        STAGE_COUNT
+    };
+
+    enum COUNTER {
+        CONN_ACCEPTED = 0,
+        CONN_CLOSED,
+        BYTES_READ,
+        BYTES_WRITTEN,
+        EPOLL_WAITS,
+        EPOLL_EVENTS,
+        EPOLL_CTLS,   // epoll_ctl 调用次数（ADD/MOD/DEL）
+        READ_CALLS,   // 连接上的 readv 次数
+        WRITE_CALLS,  // 连接上的 writev/sendfile 次数
+        COUNTER_COUNT
+    };
+
+    static Metrics* Instance();
+
+    void Init(bool enable, const std::string& path);
+    static bool Enabled() { return enabled_; }
+    const std::string& Path() const { return path_; }  // 输出指标的请求路径
+
+    static int64_t Now() {
+        /* 关闭时不读时钟，Observe 也直接返回 */
+        if(!enabled_) { return 0; }
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    void Observe(STAGE stage, int64_t ns) {
+        if(!enabled_) { return; }
+        Local_().stages[stage].Record(ns < 0 ? 0 : ns);
+    }
+
+    void Add(COUNTER counter, uint64_t n = 1) {
+        if(!enabled_) { return; }
+        Inc_(Local_().counters[counter], n);
+    }
+
+    void CountResponse(int code);  // 按状态码计数
+
+    uint64_t Total(COUNTER counter);  // 所有线程的合计
+
+    std::string Render();  // 合并各线程的数据，生成 Prometheus 文本
+
+    /* 合并后的直方图，也供测试直接检查 */
+    struct Snapshot {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sum = 0;  // 纳秒
+        uint64_t CountAtMost(uint64_t ns) const;  // 不超过 ns 的样本数（按桶的上界判断）
+        uint64_t Quantile(double q) const;  // 分位数所在桶的上界
+    };
+    Snapshot Merge(STAGE stage);
+
+    static const int SUB_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int MAX_BITS = 44;  // 超过 2^44 纳秒（约 4.9 小时）的值记在最后一个桶
+    static const int BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+    static int BucketOf(uint64_t ns) {
+        if(ns < SUB_BUCKETS) { return static_cast<int>(ns); }
+        if(ns >> MAX_BITS) { return BUCKETS - 1; }
+        int exp = 63 - __builtin_clzll(ns);  // 最高位，>= SUB_BITS
+        return (exp - SUB_BITS + 1) * SUB_BUCKETS + static_cast<int>((ns >> (exp - SUB_BITS)) & (SUB_BUCKETS - 1));
+    }
+    static uint64_t BucketMax(int bucket);  // 桶内的最大值
+
+private:
+    Metrics();
+    ~Metrics() = default;
+
+    static void Inc_(std::atomic<uint64_t>& value, uint64_t n) {
+        /* 只有所属线程写，读改写不需要 lock 前缀 */
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    struct Histogram_ {
+        std::atomic<uint64_t> buckets[BUCKETS];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        void Record(uint64_t ns) {
+            Inc_(buckets[BucketOf(ns)], 1);
+            Inc_(count, 1);
+            Inc_(sum, ns);
+        }
+    };
+
+    static const int CODE_COUNT = 9;  // 100 200 206 304 400 403 404 416 和其他
+    static int CodeIndex_(int code);
+
+    struct alignas(64) ThreadData_ {
+        ThreadData_();
+        std::atomic<uint64_t> counters[COUNTER_COUNT];
+        std::atomic<uint64_t> codes[CODE_COUNT];
+        Histogram_ stages[STAGE_COUNT];
+    };
+
+    ThreadData_& Local_() {
+        if(!local_) { local_ = Register_(); }
+        return *local_;
+    }
+    ThreadData_* Register_();  // 线程第一次记录时登记，线程退出后数据保留
+
+    static thread_local ThreadData_* local_;
+
+    static bool enabled_;  // 启动时设置一次，之后只读
+    std::string path_;
+    std::vector<std::unique_ptr<ThreadData_>> locals_;
+    std::mutex mtx_;  // 只保护 locals_ 的登记和遍历
+};
+
+/* 作用域计时：析构时把经过的时间记到对应阶段 */
+class StageTimer {
+public:
+    explicit StageTimer(Metrics::STAGE stage): stage_(stage), start_(Metrics::Now()) {}
+    ~StageTimer() { Metrics::Instance()->Observe(stage_, Metrics::Now() - start_); }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    Metrics::STAGE stage_;
+    int64_t start_;
+};
+
+#endif //METRICS_H
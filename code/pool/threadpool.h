@@ -2,42 +2,202 @@
  * @Author       : mark
  * @Date         : 2020-06-15
  * @copyleft Apache 2.0
- */ 
+ */
 
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <deque>
 #include <thread>
-#include <functional>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+#include <assert.h>
+
+/* 任务对象：可调用对象直接构造在内联存储里，入队出队都不分配内存；只需可移动，能捕获 unique_ptr */
+class Task {
+public:
+    static const size_t INLINE_SIZE = 48;
+
+    Task(): invoke_(nullptr), manage_(nullptr) {}
+
+    template<class F, class Fn = typename std::decay<F>::type,
+             class = typename std::enable_if<!std::is_same<Fn, Task>::value>::type>
+    Task(F&& f) {
+        static_assert(sizeof(Fn) <= INLINE_SIZE, "task too large for inline storage");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "task over-aligned");
+        new (buf_) Fn(std::forward<F>(f));
+        invoke_ = [](void* p) { (*static_cast<Fn*>(p))(); };
+        manage_ = [](void* dst, void* src) {
+            if(dst) { new (dst) Fn(std::move(*static_cast<Fn*>(src))); }
+            static_cast<Fn*>(src)->~Fn();
+        };
+    }
+
+    Task(Task&& other): invoke_(other.invoke_), manage_(other.manage_) {
+        if(manage_) { manage_(buf_, other.buf_); }
+        other.invoke_ = nullptr;
+        other.manage_ = nullptr;
+    }
+
+    Task& operator=(Task&& other) {
+        if(this != &other) {
+            Reset();
+            invoke_ = other.invoke_;
+            manage_ = other.manage_;
+            if(manage_) { manage_(buf_, other.buf_); }
+            other.invoke_ = nullptr;
+            other.manage_ = nullptr;
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { Reset(); }
+
+    void operator()() { invoke_(buf_); }
+
+    explicit operator bool() const { return invoke_ != nullptr; }
+
+    void Reset() {
+        if(manage_) { manage_(nullptr, buf_); }
+        invoke_ = nullptr;
+        manage_ = nullptr;
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char buf_[INLINE_SIZE];
+    void (*invoke_)(void*);
+    void (*manage_)(void*, void*);  // dst 非空时移动构造到 dst，然后析构 src
+};
+
+/* 有界多生产者多消费者环形队列（Vyukov），每个槽位用序号区分空/满，无锁 */
+class TaskQueue {
+public:
+    explicit TaskQueue(size_t capacity): mask_(RoundUp_(capacity) - 1), cells_(new Cell_[mask_ + 1]) {
+        for(size_t i = 0; i <= mask_; i++) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        enqueuePos_.store(0, std::memory_order_relaxed);
+        dequeuePos_.store(0, std::memory_order_relaxed);
+    }
+
+    bool Push(Task& task) {
+        Cell_* cell;
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        while(true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if(diff == 0) {
+                if(enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            }
+            else if(diff < 0) {
+                return false;  // 队列已满
+            }
+            else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->task = std::move(task);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(Task& task) {
+        Cell_* cell;
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        while(true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if(diff == 0) {
+                if(dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            }
+            else if(diff < 0) {
+                return false;  // 队列为空
+            }
+            else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        task = std::move(cell->task);
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const {
+        return enqueuePos_.load(std::memory_order_seq_cst) == dequeuePos_.load(std::memory_order_seq_cst);
+    }
+
+private:
+    static size_t RoundUp_(size_t n) {
+        size_t cap = 2;
+        while(cap < n) { cap <<= 1; }
+        return cap;
+    }
+
+    struct Cell_ {
+        std::atomic<size_t> seq;
+        Task task;
+    };
+
+    const size_t mask_;
+    std::unique_ptr<Cell_[]> cells_;
+    alignas(64) std::atomic<size_t> enqueuePos_;  // 生产者、消费者的位置分开放，避免伪共享
+    alignas(64) std::atomic<size_t> dequeuePos_;
+};
+
+/* 每个工作线程一个有界无锁队列，投递时轮询分散，工作线程先取自己的队列，空了再去别的队列里偷。
+   所有队列都满时放进加锁的溢出队列，AddTask 和原版一样从不阻塞调用方（主 Reactor 线程） */
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t threadCount = 8): pool_(std::make_shared<Pool>()) {
-            assert(threadCount > 0);
+    explicit ThreadPool(size_t threadCount = 8, size_t queueSize = 1024): pool_(std::make_shared<Pool>()) {
+            assert(threadCount > 0 && queueSize > 0);
+            pool_->isClosed = false;
+            pool_->idle = 0;
+            pool_->next = 0;
+            pool_->overflowed = false;
             for(size_t i = 0; i < threadCount; i++) {
-                std::thread([pool = pool_] {
-                    std::unique_lock<std::mutex> locker(pool->mtx);
+                pool_->queues.emplace_back(new TaskQueue(queueSize));
+            }
+            for(size_t i = 0; i < threadCount; i++) {
+                threads_.emplace_back([pool = pool_, i] {
+                    Task task;
                     while(true) {
-                        if(!pool->tasks.empty()) {
-                            auto task = std::move(pool->tasks.front());
-                            pool->tasks.pop();
-                            locker.unlock();
+                        bool closed = pool->isClosed;  // 先读关闭标志：看到关闭时，之前投递的任务一定取得到
+                        /* 先取自己的队列，空了再去别的线程的队列里偷 */
+                        if(pool->TryPop(i, task)) {
                             task();
-                            locker.lock();
-                        } 
-                        else if(pool->isClosed) break;
-                        else pool->cond.wait(locker);
+                            task.Reset();
+                            continue;
+                        }
+                        if(closed) break;  // 关闭前把已投递的任务做完
+                        std::unique_lock<std::mutex> locker(pool->mtx);
+                        pool->idle.fetch_add(1);
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+                        if(!pool->HasTask() && !pool->isClosed) {
+                            pool->cond.wait(locker);
+                        }
+                        pool->idle.fetch_sub(1);
                     }
-                }).detach();
+                });
             }
     }
 
     ThreadPool() = default;
 
     ThreadPool(ThreadPool&&) = default;
-    
+
     ~ThreadPool() {
         if(static_cast<bool>(pool_)) {
             {
@@ -46,26 +206,88 @@ public:
             }
             pool_->cond.notify_all();
         }
+        for(auto& thread: threads_) {
+            thread.join();  // 等已投递的任务执行完，退出时不丢下正在生成或发送的响应
+        }
     }
 
     template<class F>
-    void AddTask(F&& task) {
-        {
+    void AddTask(F&& f) {
+        Task task(std::forward<F>(f));
+        if(!pool_->TryPush(task)) {
             std::lock_guard<std::mutex> locker(pool_->mtx);
-            pool_->tasks.emplace(std::forward<F>(task));
+            pool_->overflow.push_back(std::move(task));  // 各队列都满：溢出到无界队列，不阻塞调用方
+            pool_->overflowed.store(true, std::memory_order_relaxed);
+            if(pool_->idle.load(std::memory_order_relaxed) > 0) { pool_->cond.notify_one(); }
+            return;
         }
-        pool_->cond.notify_one();
+        pool_->Wake();
+    }
+
+    template<class F>
+    bool TryAddTask(F&& f) {
+        Task task(std::forward<F>(f));
+        if(!pool_->TryPush(task)) { return false; }  // 各队列都满时不排队，由调用方拒绝请求
+        pool_->Wake();
+        return true;
     }
 
 private:
     struct Pool {
-        std::mutex mtx;
+        std::mutex mtx;  // 只用于空闲线程休眠/唤醒和溢出队列
         std::condition_variable cond;
-        bool isClosed;
-        std::queue<std::function<void()>> tasks;
+        std::atomic<bool> isClosed;
+        std::atomic<int> idle;  // 正在休眠的线程数
+        std::atomic<size_t> next;  // 下一次投递的队列
+        std::vector<std::unique_ptr<TaskQueue>> queues;  // 每个工作线程一个队列
+        std::atomic<bool> overflowed;  // 溢出队列非空，工作线程空闲时才去加锁取
+        std::deque<Task> overflow;
+
+        bool TryPush(Task& task) {
+            size_t n = queues.size();
+            size_t start = next.fetch_add(1, std::memory_order_relaxed);
+            for(size_t i = 0; i < n; i++) {
+                if(queues[(start + i) % n]->Push(task)) { return true; }
+            }
+            return false;
+        }
+
+        bool TryPop(size_t self, Task& task) {
+            size_t n = queues.size();
+            for(size_t i = 0; i < n; i++) {
+                if(queues[(self + i) % n]->Pop(task)) { return true; }
+            }
+            if(overflowed.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> locker(mtx);
+                if(!overflow.empty()) {
+                    task = std::move(overflow.front());
+                    overflow.pop_front();
+                    overflowed.store(!overflow.empty(), std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool HasTask() const {  // 调用时持有 mtx
+            for(const auto& queue: queues) {
+                if(!queue->Empty()) { return true; }
+            }
+            return !overflow.empty();
+        }
+
+        void Wake() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(idle.load(std::memory_order_relaxed) > 0) {
+                /* 只有存在休眠线程时才加锁唤醒，忙碌时入队不碰互斥锁 */
+                std::lock_guard<std::mutex> locker(mtx);
+                cond.notify_one();
+            }
+        }
     };
     std::shared_ptr<Pool> pool_;
+    std::vector<std::thread> threads_;
 };
 
 
-#endif //THREADPOOL_H
\ No newline at end of file
+#endif //THREADPOOL_H
@@ -0,0 +1,113 @@
+#include "usercache.h"
+
+using namespace std;
+
+UserCache::UserCache() {
+    maxPerShard_ = 0;  // Init 之前不缓存
+    ttlMS_ = 60000;
+    negativeTtlMS_ = 5000;
+}
+
+UserCache* UserCache::Instance() {
+    static UserCache inst;
+    return &inst;
+}
+
+void UserCache::Init(size_t maxEntries, int ttlMS, int negativeTtlMS) {
+    Clear();
+    maxPerShard_ = (maxEntries + SHARDS - 1) / SHARDS;
+    ttlMS_ = ttlMS;
+    negativeTtlMS_ = negativeTtlMS;
+}
+
+UserCache::RESULT UserCache::Get(const string& name, string* pwd) {
+    assert(pwd);
+    Shard_& shard = ShardOf_(name);
+    lock_guard<mutex> locker(shard.mtx);
+    auto it = shard.map.find(name);
+    if(it == shard.map.end()) {
+        shard.misses++;
+        return MISS;
+    }
+    Entry_& entry = it->second;
+    if(chrono::steady_clock::now() >= entry.expires) {
+        shard.lru.erase(entry.pos);  // 过期：当作未命中，由查库结果重新写入
+        shard.map.erase(it);
+        shard.misses++;
+        return MISS;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry.pos);
+    if(!entry.exists) {
+        shard.negativeHits++;
+        return NOT_FOUND;
+    }
+    shard.hits++;
+    *pwd = entry.pwd;
+    return FOUND;
+}
+
+void UserCache::Put(const string& name, const string& pwd) {
+    if(maxPerShard_ == 0 || ttlMS_ <= 0) { return; }
+    Shard_& shard = ShardOf_(name);
+    lock_guard<mutex> locker(shard.mtx);
+    Insert_(shard, name, true, pwd, ttlMS_);
+}
+
+void UserCache::PutMissing(const string& name) {
+    if(maxPerShard_ == 0 || negativeTtlMS_ <= 0) { return; }
+    Shard_& shard = ShardOf_(name);
+    lock_guard<mutex> locker(shard.mtx);
+    Insert_(shard, name, false, string(), negativeTtlMS_);
+}
+
+void UserCache::Erase(const string& name) {
+    Shard_& shard = ShardOf_(name);
+    lock_guard<mutex> locker(shard.mtx);
+    auto it = shard.map.find(name);
+    if(it != shard.map.end()) {
+        shard.lru.erase(it->second.pos);
+        shard.map.erase(it);
+    }
+}
+
+void UserCache::Clear() {
+    for(auto& shard: shards_) {
+        lock_guard<mutex> locker(shard.mtx);
+        shard.map.clear();
+        shard.lru.clear();
+    }
+}
+
+UserCache::Stats UserCache::GetStats() {
+    Stats stats = { 0, 0, 0, 0, 0 };
+    for(auto& shard: shards_) {
+        lock_guard<mutex> locker(shard.mtx);
+        stats.hits += shard.hits;
+        stats.negativeHits += shard.negativeHits;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.entries += shard.map.size();
+    }
+    return stats;
+}
+
+void UserCache::Insert_(Shard_& shard, const string& name, bool exists,
+                        const string& pwd, int ttlMS) {
+    auto it = shard.map.find(name);
+    if(it == shard.map.end()) {
+        shard.lru.push_front(name);
+        it = shard.map.emplace(name, Entry_()).first;
+        it->second.pos = shard.lru.begin();
+    } else {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second.pos);
+    }
+    Entry_& entry = it->second;
+    entry.exists = exists;
+    entry.pwd = pwd;
+    entry.expires = chrono::steady_clock::now() + chrono::milliseconds(ttlMS);
+    while(shard.map.size() > maxPerShard_) {
+        shard.map.erase(shard.lru.back());  // 按 LRU 淘汰
+        shard.lru.pop_back();
+        shard.evictions++;
+    }
+}
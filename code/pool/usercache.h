@@ -0,0 +1,76 @@
+#ifndef USER_CACHE_H
+#define USER_CACHE_H
+
+#include <string>
+#include <list>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <assert.h>
+
+/* 登录验证的用户缓存：按用户名哈希分片，每个分片一把锁、一条 LRU 链。
+   命中时不访问 MySQL；查无此人的结果也缓存一小段时间，挡住重复的错误登录 */
+class UserCache {
+public:
+    enum RESULT {
+        MISS = 0,   // 缓存里没有，需要查库
+        FOUND,      // 用户存在，pwd 为其密码
+        NOT_FOUND,  // 最近查过，用户不存在
+    };
+
+    struct Stats {
+        size_t hits;          // FOUND
+        size_t negativeHits;  // NOT_FOUND
+        size_t misses;        // MISS（含过期）
+        size_t evictions;     // 容量不足被淘汰的条目
+        size_t entries;       // 当前条目数
+    };
+
+    static UserCache* Instance();
+
+    void Init(size_t maxEntries = 10000, int ttlMS = 60000, int negativeTtlMS = 5000);
+    // 最大条目数（0 表示关闭缓存）、用户条目的 TTL、不存在结果的 TTL（毫秒）
+
+    RESULT Get(const std::string& name, std::string* pwd);
+
+    void Put(const std::string& name, const std::string& pwd);  // 查库命中或注册成功后写入
+    void PutMissing(const std::string& name);  // 查库确认用户不存在
+    void Erase(const std::string& name);
+    void Clear();
+
+    Stats GetStats();
+
+private:
+    UserCache();
+    ~UserCache() = default;
+
+    static const size_t SHARDS = 16;
+
+    struct Entry_ {
+        bool exists;
+        std::string pwd;
+        std::chrono::steady_clock::time_point expires;
+        std::list<std::string>::iterator pos;  // 在 lru 中的位置
+    };
+
+    struct Shard_ {
+        std::mutex mtx;
+        std::unordered_map<std::string, Entry_> map;
+        std::list<std::string> lru;  // 头部为最近使用
+        size_t hits = 0, negativeHits = 0, misses = 0, evictions = 0;
+    };
+
+    Shard_& ShardOf_(const std::string& name) {
+        return shards_[std::hash<std::string>()(name) % SHARDS];
+    }
+    void Insert_(Shard_& shard, const std::string& name, bool exists,
+                 const std::string& pwd, int ttlMS);
+
+    size_t maxPerShard_;
+    int ttlMS_;
+    int negativeTtlMS_;
+    Shard_ shards_[SHARDS];
+};
+
+#endif //USER_CACHE_H
@@ -0,0 +1,15 @@
+#include "conntable.h"
+
+ConnTable::ConnTable(int maxFd): maxFd_(maxFd),
+            chunks_((maxFd + CHUNK_SIZE - 1) >> CHUNK_BITS) {
+    assert(maxFd > 0);
+}
+
+HttpConn* ConnTable::Get(int fd) {
+    assert(fd >= 0 && fd < maxFd_);
+    std::unique_ptr<HttpConn[]>& chunk = chunks_[fd >> CHUNK_BITS];
+    if(!chunk) {
+        chunk.reset(new HttpConn[CHUNK_SIZE]);  // HttpConn 按缓存行对齐，new[] 走对齐分配
+    }
+    return &chunk[fd & (CHUNK_SIZE - 1)];
+}
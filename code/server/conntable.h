@@ -0,0 +1,46 @@
+#ifndef CONN_TABLE_H
+#define CONN_TABLE_H
+
+#include <vector>
+#include <memory>
+#include <assert.h>
+
+#include "../http/httpconn.h"
+
+/* 连接表：以 fd 为下标的 HttpConn slab，查找只是两次数组下标，没有哈希。
+   每 256 个 fd 为一块，第一次用到时整块分配，之后地址不变，工作线程持有的指针一直有效。
+   槽位被复用时 HttpConn 的代数（GetGen）会变，过期的定时器回调和任务凭 (fd, gen) 识别出来丢弃 */
+class ConnTable {
+public:
+    explicit ConnTable(int maxFd);
+
+    HttpConn* Get(int fd);  // 新连接用：所在块不存在时分配
+
+    HttpConn* Find(int fd) const {  // 块未分配时返回 nullptr
+        assert(fd >= 0 && fd < maxFd_);
+        HttpConn* chunk = chunks_[fd >> CHUNK_BITS].get();
+        return chunk ? chunk + (fd & (CHUNK_SIZE - 1)) : nullptr;
+    }
+
+    HttpConn* Find(int fd, uint32_t gen) const {  // 连接已关闭或 fd 已被复用时返回 nullptr
+        HttpConn* conn = Find(fd);
+        return conn && conn->GetGen() == gen ? conn : nullptr;
+    }
+
+    template<class F>
+    void ForEach(F&& func) {  // 遍历所有已分配的槽位
+        for(auto& chunk: chunks_) {
+            if(!chunk) { continue; }
+            for(int i = 0; i < CHUNK_SIZE; i++) { func(chunk[i]); }
+        }
+    }
+
+private:
+    static const int CHUNK_BITS = 8;
+    static const int CHUNK_SIZE = 1 << CHUNK_BITS;
+
+    int maxFd_;
+    std::vector<std::unique_ptr<HttpConn[]>> chunks_;
+};
+
+#endif //CONN_TABLE_H
@@ -14,6 +14,7 @@ bool Epoller::AddFd(int fd, uint32_t events) {
     epoll_event ev = {0};
     ev.data.fd = fd;
     ev.events = events;
+    Metrics::Instance()->Add(Metrics::EPOLL_CTLS);
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);  // 添加描述符。 返回零表示成功
 }
 
@@ -22,12 +23,14 @@ bool Epoller::ModFd(int fd, uint32_t events) {
     epoll_event ev = {0};
     ev.data.fd = fd;
     ev.events = events;
+    Metrics::Instance()->Add(Metrics::EPOLL_CTLS);
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev); // 修改描述符。 
 }
 
 bool Epoller::DelFd(int fd) {
     if(fd < 0) return false;
     epoll_event ev = {0};
+    Metrics::Instance()->Add(Metrics::EPOLL_CTLS);
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, &ev);  // 删除文件描述符
 }
 
@@ -8,6 +8,8 @@
 #include <vector>
 #include <errno.h>
 
+#include "../metrics/metrics.h"
+
 class Epoller {
 public:
     explicit Epoller(int maxEvent = 1024);  //初始化 epoll 文件描述符并设置事件列表大小。
@@ -0,0 +1,236 @@
+#include "handover.h"
+
+using namespace std;
+
+static bool MakeAddr(const string& path, sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if(path.empty() || path.size() >= sizeof(addr->sun_path)) {
+        return false;
+    }
+    memcpy(addr->sun_path, path.c_str(), path.size());
+    return true;
+}
+
+static bool IsListener(int fd, int port) {
+    /* 只接受监听同一端口的 TCP 套接字 */
+    int accepting = 0;
+    socklen_t len = sizeof(accepting);
+    if(getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &len) < 0 || !accepting) {
+        return false;
+    }
+    struct sockaddr_in addr;
+    len = sizeof(addr);
+    if(getsockname(fd, (struct sockaddr*)&addr, &len) < 0 || addr.sin_family != AF_INET) {
+        return false;
+    }
+    return ntohs(addr.sin_port) == port;
+}
+
+Handover::Handover(const string& path):
+    path_(path), listenFd_(-1), connFd_(-1), sent_(false), takenOver_(false) {}
+
+Handover::~Handover() {
+    CloseConn();
+    Close();
+}
+
+bool Handover::Fetch(int port, vector<int>* fds, vector<string>* paths) {
+    assert(fds && paths && connFd_ < 0);
+    sockaddr_un addr;
+    if(!MakeAddr(path_, &addr)) {
+        LOG_ERROR("Handover path too long: %s", path_.c_str());
+        return false;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0) { return false; }
+    if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);  // 没有旧进程在等待升级，正常冷启动
+        return false;
+    }
+    struct timeval tv = { 5, 0 };  // 旧进程卡住时不无限等待
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    connFd_ = fd;
+    if(!Send_("TAKEOVER\n", 9)) {
+        CloseConn();
+        return false;
+    }
+
+    /* 第一条消息带监听套接字，只读这一条，后面的路径按字节流读 */
+    char data[64];
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { data, sizeof(data) - 1 };
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    ssize_t len = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    vector<int> received;
+    for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const int* p = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+            received.insert(received.end(), p, p + n);
+        }
+    }
+    if(len <= 0 || (msg.msg_flags & MSG_CTRUNC) || received.empty()) {
+        for(int f: received) { close(f); }
+        CloseConn();
+        return false;
+    }
+    buf_.assign(data, len);
+    char chunk[4096];
+    while(buf_.find("\n\n") == string::npos) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if(n <= 0) { break; }  // 路径只用于预热，不完整也不影响接管
+        buf_.append(chunk, n);
+    }
+    size_t pos = buf_.find('\n');  // 跳过 "FDS n" 行
+    while(pos != string::npos && pos + 1 < buf_.size()) {
+        size_t next = buf_.find('\n', pos + 1);
+        if(next == string::npos || next == pos + 1) { break; }
+        paths->push_back(buf_.substr(pos + 1, next - pos - 1));
+        pos = next;
+    }
+    buf_.clear();
+    for(int f: received) {
+        if(IsListener(f, port)) {
+            fds->push_back(f);
+        } else {
+            close(f);
+        }
+    }
+    if(fds->empty()) {
+        CloseConn();
+        return false;
+    }
+    return true;
+}
+
+void Handover::Confirm() {
+    if(connFd_ < 0) { return; }
+    Send_("OK\n", 3);
+    CloseConn();
+}
+
+bool Handover::Listen() {
+    assert(listenFd_ < 0);
+    sockaddr_un addr;
+    if(!MakeAddr(path_, &addr)) { return false; }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0) { return false; }
+    unlink(path_.c_str());  // 上一个进程留下的套接字文件，它已经不再等待升级
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        LOG_ERROR("Handover listen on %s error: %s", path_.c_str(), strerror(errno));
+        close(fd);
+        return false;
+    }
+    listenFd_ = fd;
+    takenOver_ = false;
+    return true;
+}
+
+int Handover::Accept() {
+    int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if(fd < 0) { return -1; }
+    if(connFd_ >= 0) {
+        close(fd);  // 同一时间只进行一次升级
+        return -1;
+    }
+    struct timeval tv = { 1, 0 };  // 回复很短，用阻塞发送，只防对端不读
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    connFd_ = fd;
+    sent_ = false;
+    buf_.clear();
+    return fd;
+}
+
+Handover::STATE Handover::OnReadable(const vector<int>& fds, const vector<string>& paths) {
+    assert(connFd_ >= 0);
+    char chunk[256];
+    ssize_t n = recv(connFd_, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if(n < 0 && (errno == EAGAIN || errno == EINTR)) { return WAITING; }
+    if(n <= 0) { return FAILED; }  // 新进程启动失败，继续服务
+    buf_.append(chunk, n);
+    size_t end = buf_.find('\n');
+    if(end == string::npos) {
+        return buf_.size() > 64 ? FAILED : WAITING;
+    }
+    string line = buf_.substr(0, end);
+    buf_.erase(0, end + 1);
+    if(!sent_ && line == "TAKEOVER") {
+        string list;
+        for(const string& path: paths) {
+            if(path.find('\n') == string::npos) { list += path + "\n"; }
+        }
+        list += "\n";
+        if(!SendFds_(fds) || !Send_(list.data(), list.size())) {
+            return FAILED;
+        }
+        sent_ = true;
+        LOG_INFO("Handover: sent %zu listener(s) and %zu hot path(s)", fds.size(), paths.size());
+        return WAITING;
+    }
+    if(sent_ && line == "OK") {
+        takenOver_ = true;
+        return DONE;
+    }
+    return FAILED;
+}
+
+void Handover::CloseConn() {
+    if(connFd_ >= 0) {
+        close(connFd_);
+        connFd_ = -1;
+    }
+    sent_ = false;
+    buf_.clear();
+}
+
+void Handover::Close() {
+    if(listenFd_ < 0) { return; }
+    close(listenFd_);
+    listenFd_ = -1;
+    if(!takenOver_) {
+        unlink(path_.c_str());  // 被接管时套接字文件已属于新进程
+    }
+}
+
+bool Handover::Send_(const char* data, size_t len) {
+    while(len > 0) {
+        ssize_t n = send(connFd_, data, len, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR) { continue; }
+        if(n <= 0) { return false; }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool Handover::SendFds_(const vector<int>& fds) {
+    if(fds.empty() || fds.size() > MAX_FDS) { return false; }
+    char data[32];
+    int len = snprintf(data, sizeof(data), "FDS %zu\n", fds.size());
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    memset(control.buf, 0, sizeof(control.buf));
+    struct iovec iov = { data, static_cast<size_t>(len) };
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    return sendmsg(connFd_, &msg, MSG_NOSIGNAL) == len;
+}
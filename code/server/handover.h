@@ -0,0 +1,66 @@
+#ifndef HANDOVER_H
+#define HANDOVER_H
+
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>       // sockaddr_un
+#include <netinet/in.h>   // sockaddr_in
+#include <assert.h>
+
+#include "../log/log.h"
+
+/* 平滑升级：新进程通过 UNIX 套接字向旧进程要监听套接字（SCM_RIGHTS），接过去继续 accept，
+   排队中的连接不会被拒绝；顺带取回旧进程文件缓存里的热点路径，启动后先预热。
+   协议：新 -> 旧 "TAKEOVER\n"；旧 -> 新 一条带监听套接字的 "FDS n\n"，接着每行一个路径，空行结束；
+   新进程初始化完成后回 "OK\n"，旧进程收到后停止 accept 并进入优雅退出。
+   新进程没有回 OK 就断开时，旧进程照常服务 */
+class Handover {
+public:
+    enum STATE {
+        WAITING = 0,  // 还在交换中
+        DONE,         // 新进程已接管
+        FAILED,       // 对端断开或协议错误
+    };
+
+    explicit Handover(const std::string& path);
+    ~Handover();
+
+    Handover(const Handover&) = delete;
+    Handover& operator=(const Handover&) = delete;
+
+    /* 新进程 */
+    bool Fetch(int port, std::vector<int>* fds, std::vector<std::string>* paths);
+    // 连接旧进程，取回监听 port 的套接字和热点路径；没有旧进程或交换失败时返回 false
+    void Confirm();  // 初始化完成，通知旧进程停止 accept
+
+    /* 两边都用：在 path 上等待下一次升级 */
+    bool Listen();
+    int ListenFd() const { return listenFd_; }
+
+    /* 旧进程：ListenFd 可读时 Accept，ConnFd 可读时 OnReadable */
+    int Accept();  // 返回新的控制连接，已有连接在交换时拒绝
+    int ConnFd() const { return connFd_; }
+    STATE OnReadable(const std::vector<int>& fds, const std::vector<std::string>& paths);
+    void CloseConn();
+    void Close();  // 不再接受升级；没有被接管时删除套接字文件
+
+    static const int MAX_FDS = 64;
+
+private:
+    bool Send_(const char* data, size_t len);
+    bool SendFds_(const std::vector<int>& fds);
+
+    std::string path_;
+    int listenFd_;
+    int connFd_;  // 当前的控制连接（旧进程）或到旧进程的连接（新进程）
+    bool sent_;  // 旧进程已发出监听套接字，等待 OK
+    bool takenOver_;
+    std::string buf_;  // 控制连接上收到的数据
+};
+
+#endif //HANDOVER_H
@@ -0,0 +1,115 @@
+#include "listener.h"
+
+int Listener::Open(bool reusePort) const {
+    int ret;
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(options_.port);
+
+    struct linger optLinger = { 0 };
+    if(options_.linger) {
+        /* 优雅关闭: 直到所剩数据发送完毕或超时 */
+        optLinger.l_onoff = 1;  // 开启 SO_LINGER 选项
+        optLinger.l_linger = 1;  // 关闭 socket 时最多等待 1 秒发送未发送的数据
+    }
+
+    int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);  // 创建监听套接字
+    if(listenFd < 0) {
+        LOG_ERROR("Create socket error!");
+        return -1;
+    }  // 创建监听套接字失败
+
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));  // 设置 SO_LINGER 选项
+    if(ret < 0) {
+        close(listenFd);
+        LOG_ERROR("Init linger error!");
+        return -1;
+    } // 设置 SO_LINGER 选项失败
+
+    int optval = 1;
+    /* 端口复用 */
+    ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval, sizeof(int));  // 设置端口复用选项
+    //  SO_REUSEADDR 允许服务器在 TIME_WAIT 状态下重新绑定端口
+    if(ret == -1) {
+        LOG_ERROR("set socket setsockopt error !");
+        close(listenFd);
+        return -1;
+    }
+
+    if(reusePort) {
+        /* 多个套接字绑定同一端口，内核按四元组哈希分发新连接 */
+        ret = setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, (const void*)&optval, sizeof(int));
+        if(ret == -1) {
+            LOG_ERROR("set SO_REUSEPORT error !");
+            close(listenFd);
+            return -1;
+        }
+    }
+
+    ret = bind(listenFd, (struct sockaddr *)&addr, sizeof(addr));
+    if(ret < 0) {
+        LOG_ERROR("Bind Port:%d error!", options_.port);
+        close(listenFd);
+        return -1;
+    }
+
+    if(!Tune(listenFd)) {
+        close(listenFd);
+        return -1;
+    }
+    return listenFd;
+}
+
+bool Listener::Tune(int listenFd) const {
+    assert(listenFd >= 0);
+    /* 下面两项只影响建连的快慢，内核不支持时照常服务 */
+    int optval = options_.deferAcceptS;
+    if(setsockopt(listenFd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &optval, sizeof(optval)) < 0) {
+        LOG_WARN("set TCP_DEFER_ACCEPT error: %s", strerror(errno));
+    }
+    optval = options_.fastOpen;
+    if(setsockopt(listenFd, IPPROTO_TCP, TCP_FASTOPEN, &optval, sizeof(optval)) < 0 && options_.fastOpen > 0) {
+        LOG_WARN("set TCP_FASTOPEN error: %s", strerror(errno));  // 关闭时失败无所谓（从未开启过）
+    }
+
+    /* 已在监听的套接字再次 listen 只更新 backlog */
+    if(listen(listenFd, options_.backlog) < 0) {  // 最多 backlog 个已完成握手、尚未 accept 的连接排队
+        LOG_ERROR("Listen port:%d error!", options_.port);
+        return false;
+    }
+    fcntl(listenFd, F_SETFD, FD_CLOEXEC);  // 继承来的套接字不一定带 close-on-exec
+    return SetNonblock(listenFd) == 0;
+}
+
+int Listener::Accept(int listenFd, struct sockaddr_in* addr) const {
+    int fd;
+    do {
+        socklen_t len = sizeof(*addr);
+        fd = accept4(listenFd, (struct sockaddr *)addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    } while(fd < 0 && (errno == EINTR || errno == ECONNABORTED));  // 排队期间被对端重置的连接跳过
+    if(fd < 0) {
+        if(errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_WARN("accept error: %s", strerror(errno));  // EMFILE/ENFILE 等，连接留在队列里下次再取
+        }
+        return -1;
+    }
+    SetupConn(fd);
+    return fd;
+}
+
+void Listener::SetupConn(int fd) const {
+    if(options_.noDelay) {
+        /* 响应都是一次性整块交给内核的，不必等 Nagle 攒包；
+           sendfile 的头部与文件内容由 HttpConn 用 TCP_CORK 合并 */
+        int optval = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+    }
+}
+
+int Listener::SetNonblock(int fd) {
+    assert(fd >= 0);
+    int flags = fcntl(fd, F_GETFL, 0);  // 文件状态标志，F_GETFD 取到的是描述符标志（FD_CLOEXEC）
+    if(flags < 0) { return -1; }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
@@ -0,0 +1,68 @@
+#ifndef LISTENER_H
+#define LISTENER_H
+
+#include <fcntl.h>       // fcntl()
+#include <unistd.h>      // close()
+#include <assert.h>
+#include <errno.h>
+#include <string.h>     // strerror()
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>  // TCP_DEFER_ACCEPT, TCP_FASTOPEN, TCP_NODELAY
+#include <arpa/inet.h>
+
+#include "../log/log.h"
+
+/* 监听套接字的创建、调优和接受连接，主 Reactor 与各子 Reactor 共用一个只读实例：
+   - backlog 可配置（内核再以 net.core.somaxconn 为上限），突发建连不再因队列满而丢 SYN
+   - TCP_DEFER_ACCEPT：握手完成后等到第一段数据才放进 accept 队列，accept 到的连接立即可读
+   - TCP_FASTOPEN：SYN 携带数据，重复访问的客户端少一个往返（请求可能被重放，默认关闭）
+   - accept4 一次得到非阻塞、close-on-exec 的连接，不再额外调用 fcntl
+   - 每次监听事件最多接受 acceptBatch 个连接，突发建连时不会长时间占住事件循环 */
+class Listener {
+public:
+    struct Options {
+        int port;
+        int backlog;       // listen 的 backlog
+        bool linger;       // SO_LINGER 优雅关闭
+        int deferAcceptS;  // TCP_DEFER_ACCEPT 等待数据的秒数，0 为不启用
+        int fastOpen;      // TCP_FASTOPEN 队列长度，0 为不启用
+        bool noDelay;      // 连接上设置 TCP_NODELAY
+        int acceptBatch;   // 每次监听事件最多接受的连接数
+    };
+
+    explicit Listener(const Options& options): options_(options) {}
+
+    int Open(bool reusePort) const;  // 创建、绑定并监听一个套接字，失败返回 -1
+    bool Tune(int listenFd) const;
+    // 按配置设置 backlog、TCP_DEFER_ACCEPT、TCP_FASTOPEN 和非阻塞；
+    // 从旧进程接过来的监听套接字也调用一次，以本进程的配置为准
+
+    int Accept(int listenFd, struct sockaddr_in* addr) const;
+    // 接受一个连接并设置连接选项；没有新连接或出错时返回 -1，原因见 errno
+    template<class F>
+    int AcceptSome(int listenFd, F&& onConn) const {
+        struct sockaddr_in addr;
+        int n = 0;
+        while(n < options_.acceptBatch) {
+            int fd = Accept(listenFd, &addr);
+            if(fd < 0) { break; }  // 队列已取空或出错
+            n++;
+            onConn(fd, addr);
+        }
+        return n;
+    }
+    // 一次监听事件：最多接受 acceptBatch 个连接，逐个交给 onConn(fd, addr)，返回接受的个数；
+    // 等于 acceptBatch 时队列里可能还有连接
+    void SetupConn(int fd) const;  // 新连接的套接字选项，io_uring 的 accept 也要调用
+
+    int AcceptBatch() const { return options_.acceptBatch; }
+    const Options& GetOptions() const { return options_; }
+
+    static int SetNonblock(int fd);  // 设置非阻塞，失败返回 -1
+
+private:
+    Options options_;
+};
+
+#endif //LISTENER_H
@@ -0,0 +1,28 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <netinet/in.h>  // sockaddr_in
+
+#include "../timer/timer.h"
+
+/* 子 Reactor 接口：one loop per thread，每个实例独占一个线程和一部分连接。
+   主 Reactor 只负责创建、分发连接（轮询模式）和通知退出。
+   SubReactor 基于 epoll，UringReactor 基于 io_uring */
+class Reactor {
+public:
+    virtual ~Reactor() {}
+
+    virtual void Start() = 0;  // 启动事件循环线程
+    virtual void Stop() = 0;   // 通知事件循环退出并等待线程结束
+
+    virtual void AddConn(int fd, const sockaddr_in& addr) = 0;  // 主 Reactor 投递新连接，线程安全
+
+    virtual void Drain(TimeStamp deadline) = 0;
+    // 优雅退出，线程安全：关闭本线程的监听套接字，空闲连接立即关闭，进行中的响应发完后关闭，
+    // 全部关闭或到 deadline 时事件循环退出
+    virtual bool Drained() const = 0;
+
+    virtual int ListenFd() const = 0;  // SO_REUSEPORT 模式下本线程的监听套接字，没有时为 -1
+};
+
+#endif //REACTOR_H
@@ -0,0 +1,293 @@
+#include "subreactor.h"
+
+using namespace std;
+
+SubReactor::SubReactor(int listenFd, const Listener* listener, uint32_t listenEvent, uint32_t connEvent,
+                       int timeoutMS, int maxFd, int maxEvents, bool timingWheel, ThreadPool* sqlpool):
+            listenFd_(listenFd), listener_(listener), timeoutMS_(timeoutMS), maxFd_(maxFd), isClose_(false),
+            drainRequested_(false), drained_(false), draining_(false),
+            listenEvent_(listenEvent), connEvent_(connEvent & ~EPOLLONESHOT),
+            epoller_(new Epoller(maxEvents)), sqlpool_(sqlpool), users_(maxFd)
+    {
+    assert(sqlpool_ && listener_);
+    if(timingWheel) { timer_.reset(new TimingWheel()); }
+    else { timer_.reset(new HeapTimer()); }
+    wakeupFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(wakeupFd_ >= 0);
+    epoller_->AddFd(wakeupFd_, EPOLLIN);  // 水平触发，读空计数器即可
+    if(listenFd_ >= 0) {
+        epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN);
+    }
+}
+
+SubReactor::~SubReactor() {
+    Stop();
+    users_.ForEach([](HttpConn& user) { user.Close(); });
+    if(listenFd_ >= 0) { close(listenFd_); }
+    close(wakeupFd_);
+    lock_guard<mutex> locker(mtx_);
+    for(auto& conn: pending_) {
+        close(conn.first);  // 尚未接管的连接直接关闭
+    }
+    pending_.clear();
+}
+
+void SubReactor::Start() {
+    assert(!thread_.joinable());
+    thread_ = thread(&SubReactor::Loop_, this);
+}
+
+void SubReactor::Stop() {
+    isClose_ = true;
+    uint64_t one = 1;
+    ssize_t ret = ::write(wakeupFd_, &one, sizeof(one));  // 唤醒阻塞在 epoll_wait 上的线程
+    (void)ret;
+    if(thread_.joinable()) { thread_.join(); }
+}
+
+void SubReactor::AddConn(int fd, const sockaddr_in& addr) {
+    {
+        lock_guard<mutex> locker(mtx_);
+        pending_.emplace_back(fd, addr);
+    }
+    uint64_t one = 1;
+    ssize_t ret = ::write(wakeupFd_, &one, sizeof(one));
+    (void)ret;
+}
+
+void SubReactor::Drain(TimeStamp deadline) {
+    {
+        lock_guard<mutex> locker(mtx_);
+        drainDeadline_ = deadline;
+    }
+    drainRequested_ = true;
+    uint64_t one = 1;
+    ssize_t ret = ::write(wakeupFd_, &one, sizeof(one));
+    (void)ret;
+}
+
+void SubReactor::Loop_() {
+    int timeMS = -1;
+    while(!isClose_) {
+        if(timeoutMS_ > 0) {
+            timeMS = timer_->GetNextTick();
+        }
+        if(draining_ && (timeMS < 0 || timeMS > DRAIN_TICK_MS)) {
+            timeMS = DRAIN_TICK_MS;  // 定期检查进行中的连接是否已结束
+        }
+        int eventCnt = epoller_->Wait(timeMS);
+        int64_t batchStart = Metrics::Now();
+        for(int i = 0; i < eventCnt; i++) {
+            int fd = epoller_->GetEventFd(i);
+            uint32_t events = epoller_->GetEvents(i);
+            if(fd == listenFd_) {
+                DealListen_();
+            }
+            else if(fd == wakeupFd_) {
+                DealWakeup_();
+            }
+            else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                assert(users_.Find(fd));
+                CloseConn_(users_.Find(fd));
+            }
+            else if(events & EPOLLIN) {
+                HttpConn* client = users_.Find(fd);
+                assert(client);
+                ExtentTime_(client);
+                OnRead_(client);
+            }
+            else if(events & EPOLLOUT) {
+                HttpConn* client = users_.Find(fd);
+                assert(client);
+                ExtentTime_(client);
+                OnWrite_(client);
+            } else {
+                LOG_ERROR("Unexpected event");
+            }
+        }
+        if(eventCnt > 0) {
+            Metrics::Instance()->Observe(Metrics::LOOP, Metrics::Now() - batchStart);
+            Metrics::Instance()->Add(Metrics::EPOLL_WAITS);
+            Metrics::Instance()->Add(Metrics::EPOLL_EVENTS, eventCnt);
+        }
+        if(!draining_ && drainRequested_) {
+            BeginDrain_();
+        }
+        if(draining_) {
+            CheckDrained_();
+        }
+    }
+}
+
+void SubReactor::BeginDrain_() {
+    draining_ = true;
+    if(listenFd_ >= 0) {
+        epoller_->DelFd(listenFd_);
+        close(listenFd_);  // 平滑升级时新进程持有同一个套接字，排队的连接由它接收
+        listenFd_ = -1;
+    }
+}
+
+void SubReactor::CheckDrained_() {
+    bool forced, pending;
+    {
+        lock_guard<mutex> locker(mtx_);
+        forced = Clock::now() >= drainDeadline_;
+        pending = !pending_.empty();
+    }
+    int open = 0;
+    users_.ForEach([&](HttpConn& user) {
+        if(user.IsClosed()) { return; }
+        if(forced || user.IsIdle()) {
+            CloseConn_(&user);  // 到期时进行中的连接也一并关闭
+        } else {
+            open++;
+        }
+    });
+    if(forced || (open == 0 && !pending)) {
+        drained_ = true;
+        isClose_ = true;
+    }
+}
+
+void SubReactor::DealListen_() {
+    int n = listener_->AcceptSome(listenFd_, [this](int fd, const sockaddr_in& addr) {
+        if(fd >= maxFd_ || HttpConn::userCount >= maxFd_) {
+            send(fd, "Server busy!", 12, 0);
+            close(fd);
+            LOG_WARN("Clients is full!");
+            return;
+        }
+        AddClient_(fd, addr);
+    });
+    if(n == listener_->AcceptBatch() && (listenEvent_ & EPOLLET)) {
+        epoller_->ModFd(listenFd_, listenEvent_ | EPOLLIN);  // 取满一批：ET 下重新检查，下一轮再取
+    }
+}
+
+void SubReactor::DealWakeup_() {
+    uint64_t cnt = 0;
+    ssize_t ret = ::read(wakeupFd_, &cnt, sizeof(cnt));  // 读空计数器
+    (void)ret;
+    vector<pair<int, sockaddr_in>> conns;
+    vector<unique_ptr<VerifyTask>> tasks;
+    {
+        lock_guard<mutex> locker(mtx_);
+        conns.swap(pending_);
+        tasks.swap(verified_);
+    }
+    for(auto& conn: conns) {
+        AddClient_(conn.first, conn.second);
+    }
+    for(auto& task: tasks) {
+        HttpConn* client = users_.Find(task->fd, task->gen);
+        if(!client) {
+            continue;  // 等待期间连接已关闭，fd 可能已被复用
+        }
+        client->FinishVerify(task->ok);
+        ExtentTime_(client);
+        OnWrite_(client);
+    }
+}
+
+void SubReactor::AddClient_(int fd, const sockaddr_in& addr) {
+    assert(fd > 0);
+    HttpConn* client = users_.Get(fd);
+    client->init(fd, addr);
+    if(timeoutMS_ > 0) {
+        uint32_t gen = client->GetGen();
+        timer_->add(fd, timeoutMS_, [this, fd, gen] {
+            HttpConn* conn = users_.Find(fd, gen);
+            if(conn) { CloseConn_(conn); }
+        });
+    }
+    epoller_->AddFd(fd, EPOLLIN | connEvent_);
+    client->SetInterest(EPOLLIN);
+}
+
+void SubReactor::CloseConn_(HttpConn* client) {
+    assert(client);
+    LOG_INFO("Client[%d] quit!", client->GetFd());
+    epoller_->DelFd(client->GetFd());
+    client->Close();
+}
+
+void SubReactor::ExtentTime_(HttpConn* client) {
+    assert(client);
+    if(timeoutMS_ > 0) { timer_->adjust(client->GetFd(), timeoutMS_); }
+}
+
+void SubReactor::OnRead_(HttpConn* client) {
+    assert(client);
+    int readErrno = 0;
+    ssize_t ret = client->read(&readErrno);
+    if(ret <= 0 && readErrno != EAGAIN) {
+        CloseConn_(client);
+        return;
+    }
+    OnProcess_(client);
+}
+
+void SubReactor::OnProcess_(HttpConn* client) {
+    if(client->process()) {
+        OnWrite_(client);  // 响应已就绪，直接在本线程尝试发送，省去一次 epoll 往返
+    } else if(client->IsVerifying()) {
+        Verify_(client);
+    } else {
+        Arm_(client, EPOLLIN);  // 长连接上一般已经是 EPOLLIN，不再调用 epoll_ctl
+    }
+}
+
+void SubReactor::Arm_(HttpConn* client, uint32_t events) {
+    if(client->Interest() == events
+       && (events != EPOLLIN || !(connEvent_ & EPOLLET) || client->InputDrained())) {
+        return;  // ET 下套接字里还有没读的数据时不会再有边沿，要 MOD 一次让 epoll 重新检查
+    }
+    epoller_->ModFd(client->GetFd(), events ? connEvent_ | events : 0);
+    client->SetInterest(events);
+}
+
+void SubReactor::Verify_(HttpConn* client) {
+    unique_ptr<VerifyTask> task = client->MakeVerifyTask();
+    int cached = HttpRequest::CachedVerify(task->name, task->pwd, task->isLogin);
+    if(cached >= 0) {
+        client->FinishVerify(cached);  // 用户缓存命中，不经过数据库线程
+        OnWrite_(client);
+        return;
+    }
+    bool queued = sqlpool_->TryAddTask([this, task = std::move(task)]() mutable {
+        task->ok = HttpRequest::UserVerify(task->name, task->pwd, task->isLogin);
+        {
+            lock_guard<mutex> locker(mtx_);
+            verified_.push_back(std::move(task));
+        }
+        uint64_t one = 1;
+        ssize_t ret = ::write(wakeupFd_, &one, sizeof(one));
+        (void)ret;
+    });
+    if(!queued) {
+        client->RejectVerify();  // 数据库跟不上时直接回 503，事件循环不等待
+        OnWrite_(client);
+        return;
+    }
+    Arm_(client, 0);  // 查库期间连接保持静默，本线程继续处理其他连接
+}
+
+void SubReactor::OnWrite_(HttpConn* client) {
+    assert(client);
+    int writeErrno = 0;
+    ssize_t ret = client->write(&writeErrno);
+    if(client->ToWriteBytes() == 0) {
+        /* 传输完成 */
+        if(client->IsKeepAlive()) {
+            OnProcess_(client);
+            return;
+        }
+    }
+    else if(ret > 0 || writeErrno == EAGAIN) {
+        /* 继续传输 */
+        Arm_(client, EPOLLOUT);
+        return;
+    }
+    CloseConn_(client);
+}
@@ -0,0 +1,95 @@
+#ifndef SUBREACTOR_H
+#define SUBREACTOR_H
+
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <sys/eventfd.h>  // eventfd()
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "epoller.h"
+#include "reactor.h"
+#include "listener.h"
+#include "../log/log.h"
+#include "../timer/heaptimer.h"
+#include "../timer/timingwheel.h"
+#include "../pool/threadpool.h"
+#include "../http/httpconn.h"
+#include "../metrics/metrics.h"
+#include "conntable.h"
+
+/* one loop per thread:
+   每个子 Reactor 独占一个 Epoller、一个定时器和一部分连接，
+   连接的读、解析、写都在所属线程内完成，不再转交线程池 */
+class SubReactor : public Reactor {
+public:
+    SubReactor(int listenFd, const Listener* listener, uint32_t listenEvent, uint32_t connEvent,
+               int timeoutMS, int maxFd, int maxEvents, bool timingWheel, ThreadPool* sqlpool);
+    // listenFd: SO_REUSEPORT 模式下本线程独占的监听套接字，-1 表示由主 Reactor 分发连接
+    // listener: accept 的方式和每批数量，由 WebServer 持有
+    // sqlpool: 共享的数据库线程，登录/注册在那里查库，结果经 wakeupFd_ 交回本线程
+
+    ~SubReactor();
+
+    void Start() override;
+    void Stop() override;
+
+    void AddConn(int fd, const sockaddr_in& addr) override;
+
+    void Drain(TimeStamp deadline) override;
+    bool Drained() const override { return drained_; }
+
+    int ListenFd() const override { return listenFd_; }
+
+private:
+    void Loop_();  // 事件循环
+
+    void DealListen_();  // 本线程监听套接字上的新连接
+    void DealWakeup_();  // 处理 eventfd 唤醒：接收投递的连接和数据库验证结果
+    void AddClient_(int fd, const sockaddr_in& addr);  // fd 已是非阻塞
+
+    void CloseConn_(HttpConn* client);
+    void ExtentTime_(HttpConn* client);
+
+    void OnRead_(HttpConn* client);
+    void OnWrite_(HttpConn* client);
+    void OnProcess_(HttpConn* client);
+    void Verify_(HttpConn* client);
+    void Arm_(HttpConn* client, uint32_t events);  // 注册 EPOLLIN/EPOLLOUT，与当前兴趣集相同时不调用 epoll_ctl
+
+    void BeginDrain_();
+    void CheckDrained_();  // 关闭空闲连接，判断是否可以退出
+
+    int listenFd_;  // 本线程的监听套接字
+    const Listener* listener_;
+    int wakeupFd_;  // eventfd，用于投递连接和退出通知
+    int timeoutMS_;
+    int maxFd_;
+    std::atomic<bool> isClose_;
+    std::atomic<bool> drainRequested_;  // Drain 已被调用
+    std::atomic<bool> drained_;  // 事件循环已因优雅退出而结束
+    bool draining_;  // 本线程已开始优雅退出
+    TimeStamp drainDeadline_;  // 由 mtx_ 保护
+
+    uint32_t listenEvent_;
+    uint32_t connEvent_;  // 不含 EPOLLONESHOT：连接只被本线程访问，事件不必每次重新注册
+
+    std::unique_ptr<Timer> timer_;
+    std::unique_ptr<Epoller> epoller_;
+    ThreadPool* sqlpool_;
+    ConnTable users_;  // 只被本线程访问
+
+    static const int DRAIN_TICK_MS = 100;
+
+    std::mutex mtx_;  // 保护 pending_、verified_ 和 drainDeadline_
+    std::vector<std::pair<int, sockaddr_in>> pending_;  // 主 Reactor 投递、尚未接管的连接
+    std::vector<std::unique_ptr<VerifyTask>> verified_;  // 数据库线程完成的验证
+
+    std::thread thread_;
+};
+
+#endif //SUBREACTOR_H
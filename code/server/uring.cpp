@@ -0,0 +1,319 @@
+#include "uring.h"
+
+#ifdef HAVE_URING
+
+#include "../buffer/bufferpool.h"
+
+using namespace std;
+
+static int SysSetup(unsigned entries, struct io_uring_params* p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int SysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+static int SysRegister(int fd, unsigned op, const void* arg, unsigned nr) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, op, arg, nr));
+}
+
+Uring::Uring(): ringFd_(-1), sqpoll_(false), sqPtr_(MAP_FAILED), sqSize_(0), cqPtr_(MAP_FAILED), cqSize_(0),
+                sqes_(nullptr), sqesSize_(0), sqHead_(nullptr), sqTail_(nullptr), sqFlags_(nullptr),
+                sqMask_(0), sqEntries_(0), cqHead_(nullptr), cqTail_(nullptr), cqMask_(0), cqes_(nullptr),
+                sqeTail_(0), sqeHead_(0) {
+    memset(&params_, 0, sizeof(params_));
+}
+
+Uring::~Uring() {
+    /* 关闭环时内核取消所有未完成的请求 */
+    if(sqes_) { munmap(sqes_, sqesSize_); }
+    if(cqPtr_ != MAP_FAILED && cqPtr_ != sqPtr_) { munmap(cqPtr_, cqSize_); }
+    if(sqPtr_ != MAP_FAILED) { munmap(sqPtr_, sqSize_); }
+    if(ringFd_ >= 0) { close(ringFd_); }
+}
+
+bool Uring::Init(unsigned entries, bool sqpoll, string* err) {
+    assert(ringFd_ < 0 && entries > 0);
+    memset(&params_, 0, sizeof(params_));
+    if(sqpoll) {
+        params_.flags = IORING_SETUP_SQPOLL;
+        params_.sq_thread_idle = 1000;  // 内核轮询线程空闲 1 秒后休眠
+    } else {
+        params_.flags = IORING_SETUP_COOP_TASKRUN;  // 完成在本线程下次进入内核时处理，不打断正在运行的用户态
+    }
+    ringFd_ = SysSetup(entries, &params_);
+    if(ringFd_ < 0 && errno == EINVAL && !sqpoll) {
+        memset(&params_, 0, sizeof(params_));  // 老内核没有 COOP_TASKRUN
+        ringFd_ = SysSetup(entries, &params_);
+    }
+    if(ringFd_ < 0) {
+        *err = string("io_uring_setup: ") + strerror(errno);
+        return false;
+    }
+    sqpoll_ = sqpoll;
+    if(!(params_.features & IORING_FEAT_EXT_ARG)) {
+        *err = "kernel lacks IORING_FEAT_EXT_ARG";  // 等待时带超时需要 5.11+
+        return false;
+    }
+
+    sqSize_ = params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+    cqSize_ = params_.cq_off.cqes + params_.cq_entries * sizeof(struct io_uring_cqe);
+    if(params_.features & IORING_FEAT_SINGLE_MMAP) {
+        sqSize_ = cqSize_ = max(sqSize_, cqSize_);  // SQ 和 CQ 共用一次映射
+    }
+    sqPtr_ = mmap(nullptr, sqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if(sqPtr_ == MAP_FAILED) {
+        *err = string("mmap sq ring: ") + strerror(errno);
+        return false;
+    }
+    if(params_.features & IORING_FEAT_SINGLE_MMAP) {
+        cqPtr_ = sqPtr_;
+    } else {
+        cqPtr_ = mmap(nullptr, cqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if(cqPtr_ == MAP_FAILED) {
+            *err = string("mmap cq ring: ") + strerror(errno);
+            return false;
+        }
+    }
+    sqesSize_ = params_.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) {
+        *err = string("mmap sqes: ") + strerror(errno);
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqPtr_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.tail);
+    sqFlags_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.flags);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params_.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned*>(sq + params_.sq_off.ring_entries);
+    unsigned* array = reinterpret_cast<unsigned*>(sq + params_.sq_off.array);
+    for(unsigned i = 0; i < sqEntries_; i++) { array[i] = i; }  // SQE 按顺序使用，索引数组固定为恒等映射
+    sqeTail_ = sqeHead_ = *sqTail_;
+
+    char* cq = static_cast<char*>(cqPtr_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params_.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params_.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params_.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params_.cq_off.cqes);
+
+    /* 探测支持的操作码 */
+    const unsigned PROBE_OPS = 256;
+    vector<char> probe(sizeof(struct io_uring_probe) + PROBE_OPS * sizeof(struct io_uring_probe_op), 0);
+    struct io_uring_probe* p = reinterpret_cast<struct io_uring_probe*>(probe.data());
+    ops_.assign(PROBE_OPS, false);
+    if(SysRegister(ringFd_, IORING_REGISTER_PROBE, p, PROBE_OPS) == 0) {
+        for(unsigned i = 0; i < p->ops_len && i < PROBE_OPS; i++) {
+            ops_[p->ops[i].op] = p->ops[i].flags & IO_URING_OP_SUPPORTED;
+        }
+    }
+    return true;
+}
+
+bool Uring::Supports(int op) const {
+    return op >= 0 && op < static_cast<int>(ops_.size()) && ops_[op];
+}
+
+unsigned Uring::Space() const {
+    unsigned head = sqpoll_ ? __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) : *sqHead_;
+    return sqEntries_ - (sqeTail_ - head);
+}
+
+struct io_uring_sqe* Uring::GetSqe() {
+    unsigned head = sqpoll_ ? __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) : *sqHead_;
+    if(sqeTail_ - head >= sqEntries_) {
+        Submit();  // 队列满：先把已有的交给内核
+        if(sqpoll_) {
+            Enter_(0, 0, IORING_ENTER_SQ_WAIT, -1);  // 内核线程异步取走，等它腾出空位
+        }
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if(sqeTail_ - head >= sqEntries_) { return nullptr; }
+    }
+    struct io_uring_sqe* sqe = &sqes_[sqeTail_ & sqMask_];
+    sqeTail_++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+unsigned Uring::Flush_() {
+    if(sqeTail_ != sqeHead_) {
+        __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+    }
+    unsigned pending = sqeTail_ - sqeHead_;
+    sqeHead_ = sqeTail_;
+    return pending;
+}
+
+int Uring::Enter_(unsigned toSubmit, unsigned minComplete, unsigned flags, int timeoutMS) {
+    if(sqpoll_) {
+        /* 内核线程负责提交：还有它没取走的 SQE 且它已休眠时才需要唤醒 */
+        if(toSubmit > 0 || __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) != sqeHead_) {
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);  // 尾指针的写入先于读标志，否则可能错过内核线程刚进入的休眠
+            if(__atomic_load_n(sqFlags_, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP) {
+                flags |= IORING_ENTER_SQ_WAKEUP;
+            }
+        }
+        toSubmit = 0;
+        if(!(flags & (IORING_ENTER_SQ_WAKEUP | IORING_ENTER_GETEVENTS | IORING_ENTER_SQ_WAIT))) { return 0; }
+    } else if(toSubmit == 0 && minComplete == 0) {
+        return 0;
+    }
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    if(minComplete > 0 && timeoutMS >= 0) {
+        ts.tv_sec = timeoutMS / 1000;
+        ts.tv_nsec = (timeoutMS % 1000) * 1000000LL;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+    int ret = SysEnter(ringFd_, toSubmit, minComplete, flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    return ret < 0 ? -errno : ret;
+}
+
+int Uring::Submit() {
+    return Enter_(Flush_(), 0, 0, -1);
+}
+
+int Uring::SubmitAndWait(int timeoutMS) {
+    unsigned pending = Flush_();
+    if(*cqHead_ != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+        return Enter_(pending, 0, 0, -1);  // 已有完成的 CQE，只提交不等待
+    }
+    return Enter_(pending, 1, IORING_ENTER_GETEVENTS, timeoutMS);
+}
+
+BufRing::BufRing(): uring_(nullptr), legacy_(false), tag_(0), ring_(nullptr), ringSize_(0), mask_(0),
+                    tail_(0), group_(0), size_(0), cap_(0) {}
+
+BufRing::~BufRing() {
+    /* 注销随环关闭一起完成，这里只释放内存：调用方保证环已先关闭 */
+    for(char* buf: bufs_) {
+        BufferPool::Instance()->Free(buf, cap_);
+    }
+    if(ring_) { munmap(ring_, ringSize_); }
+}
+
+bool BufRing::Init(Uring& ring, uint16_t group, unsigned count, size_t size, uint64_t tag, string* err) {
+    assert(!uring_ && count > 0 && size > 0);
+    uring_ = &ring;
+    group_ = group;
+    tag_ = tag;
+    size_ = size;
+    unsigned entries = 1;
+    while(entries < count && entries < 32768) { entries <<= 1; }  // 环的大小必须是 2 的幂，最多 32768
+    bufs_.resize(entries);
+    for(unsigned i = 0; i < entries; i++) {
+        bufs_[i] = BufferPool::Instance()->Alloc(size, &cap_);
+    }
+
+    ringSize_ = entries * sizeof(struct io_uring_buf);
+    void* mem = mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if(mem == MAP_FAILED) {
+        *err = string("mmap buffer ring: ") + strerror(errno);
+        return false;
+    }
+    ring_ = static_cast<struct io_uring_buf_ring*>(mem);
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring_);
+    reg.ring_entries = entries;
+    reg.bgid = group;
+    bool registered = SysRegister(ring.Fd(), IORING_REGISTER_PBUF_RING, &reg, 1) == 0;  // 5.19+
+    if(registered) {
+        mask_ = entries - 1;
+        for(unsigned i = 0; i < entries; i++) {
+            Recycle(static_cast<uint16_t>(i));
+        }
+        Commit();
+        if(SelfTest_()) { return true; }
+        SysRegister(ring.Fd(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    }
+    munmap(ring_, ringSize_);
+    ring_ = nullptr;
+
+    /* 退回 PROVIDE_BUFFERS：交还成功时不产生 CQE（5.17+） */
+    if(!ring.Supports(IORING_OP_PROVIDE_BUFFERS) || !(ring.Features() & IORING_FEAT_CQE_SKIP)) {
+        *err = registered ? "provided buffer ring not functional" : string("register buffer ring: ") + strerror(errno);
+        return false;
+    }
+    legacy_ = true;
+    returned_.clear();
+    for(unsigned i = 0; i < entries; i++) {
+        Recycle(static_cast<uint16_t>(i));
+    }
+    Commit();
+    return true;
+}
+
+bool BufRing::SelfTest_() {
+    int fds[2];
+    if(pipe2(fds, O_CLOEXEC) < 0) { return false; }
+    bool ok = false;
+    uint16_t bid = 0;
+    if(::write(fds[1], "x", 1) == 1) {
+        struct io_uring_sqe* sqe = uring_->GetSqe();
+        assert(sqe);  // 环刚建好，提交队列是空的
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fds[0];
+        sqe->off = uint64_t(-1);
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = group_;
+        sqe->user_data = tag_;
+        uring_->SubmitAndWait(1000);
+        uring_->ForEachCqe([&](const struct io_uring_cqe& cqe) {
+            if(cqe.user_data != tag_) { return; }
+            bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            ok = cqe.res == 1 && (cqe.flags & IORING_CQE_F_BUFFER) && bid < bufs_.size() && bufs_[bid][0] == 'x';
+        });
+    }
+    close(fds[0]);
+    close(fds[1]);
+    if(ok) {
+        Recycle(bid);  // 测试用掉的那块放回去
+        Commit();
+    }
+    return ok;
+}
+
+void BufRing::Recycle(uint16_t bid) {
+    assert(bid < bufs_.size());
+    if(legacy_) {
+        returned_.push_back(bid);
+        return;
+    }
+    /* 不用 ring_->bufs：头文件用空结构体声明柔性数组，C++ 里空结构体占 1 字节，bufs 会偏移 8 字节，
+       与内核按 16 字节一格读取的位置错开，最后一格还会越过映射区 */
+    struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(ring_) + (tail_ & mask_);
+    buf->addr = reinterpret_cast<uint64_t>(bufs_[bid]);
+    buf->len = static_cast<uint32_t>(size_);
+    buf->bid = bid;
+    tail_++;
+}
+
+void BufRing::Commit() {
+    if(!legacy_) {
+        __atomic_store_n(&ring_->tail, tail_, __ATOMIC_RELEASE);
+        return;
+    }
+    size_t done = 0;
+    for(; done < returned_.size(); done++) {
+        struct io_uring_sqe* sqe = uring_->GetSqe();
+        if(!sqe) { break; }  // 提交队列满，剩下的下一轮再交还
+        uint16_t bid = returned_[done];
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = 1;  // 缓冲区块数
+        sqe->addr = reinterpret_cast<uint64_t>(bufs_[bid]);
+        sqe->len = static_cast<uint32_t>(size_);
+        sqe->off = bid;
+        sqe->buf_group = group_;
+        sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+        sqe->user_data = tag_;
+    }
+    returned_.erase(returned_.begin(), returned_.begin() + done);
+}
+
+#endif //HAVE_URING
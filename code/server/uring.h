@@ -0,0 +1,140 @@
+#ifndef URING_H
+#define URING_H
+
+/* 编译时 -DNO_URING 或没有 <linux/io_uring.h> 时不编译 io_uring 后端，运行时只能用 epoll */
+#if !defined(NO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_URING 1
+#endif
+#endif
+
+#ifdef HAVE_URING
+
+#include <linux/io_uring.h>
+#undef BLOCK_SIZE  // 经 <linux/fs.h> 引入的宏，与 ChainBuffer::BLOCK_SIZE 冲突
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fcntl.h>    // pipe2
+#include <string.h>
+#include <errno.h>
+#include <signal.h>   // _NSIG
+#include <stdint.h>
+#include <assert.h>
+#include <string>
+#include <vector>
+
+/* io_uring 的最小封装：直接用系统调用建环、映射提交/完成队列，不依赖 liburing。
+   只由一个线程使用：取 SQE、提交、收割 CQE 都在所属 Reactor 的线程里 */
+class Uring {
+public:
+    Uring();
+    ~Uring();
+
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    bool Init(unsigned entries, bool sqpoll, std::string* err);
+    // sqpoll: 由内核线程轮询提交队列，提交不再需要系统调用（空闲一段时间后内核线程休眠，需要唤醒）
+
+    bool Supports(int op) const;  // 内核是否支持该操作码，Init 时探测
+
+    struct io_uring_sqe* GetSqe();  // 提交队列满时先提交已有的再取；返回的 SQE 已清零
+
+    unsigned Space() const;  // 还能取出的 SQE 数，为 0 时 GetSqe 会先提交
+
+    int Submit();  // 提交尚未提交的 SQE，不等待，返回提交数或 -errno
+    int SubmitAndWait(int timeoutMS);
+    // 提交并等待至少一个 CQE，timeoutMS < 0 时一直等；超时返回 -ETIME，被信号打断返回 -EINTR
+
+    template<class F>
+    unsigned ForEachCqe(F&& func) {  // 依次处理已完成的 CQE，处理完一起归还给内核
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        unsigned cnt = 0;
+        for(; head != tail; head++, cnt++) {
+            func(cqes_[head & cqMask_]);
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        return cnt;
+    }
+
+    int Fd() const { return ringFd_; }
+    unsigned Features() const { return params_.features; }  // IORING_FEAT_*
+
+private:
+    int Enter_(unsigned toSubmit, unsigned minComplete, unsigned flags, int timeoutMS);
+    unsigned Flush_();  // 把本地的 SQ 尾指针写给内核，返回待提交数
+
+    int ringFd_;
+    bool sqpoll_;
+    struct io_uring_params params_;
+
+    void* sqPtr_;
+    size_t sqSize_;
+    void* cqPtr_;
+    size_t cqSize_;
+    struct io_uring_sqe* sqes_;
+    size_t sqesSize_;
+
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqFlags_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned cqMask_;
+    struct io_uring_cqe* cqes_;
+
+    unsigned sqeTail_;  // 本地已取出的 SQE，Flush_ 时写给内核
+    unsigned sqeHead_;  // 已提交给内核的 SQE
+
+    std::vector<bool> ops_;  // 支持的操作码
+};
+
+/* 提供缓冲区环（provided buffer ring）：内核在数据到达时才从环里挑一块缓冲区写入，
+   recv 排队期间不占内存，空闲的长连接不再各自持有读缓冲区。
+   缓冲区从 BufferPool 分配，用完后 Recycle 放回环中。
+   注册后先自检一次：个别内核注册成功却选不出缓冲区（总是 ENOBUFS），这时退回
+   IORING_OP_PROVIDE_BUFFERS，用完的缓冲区随下一次提交逐块交还，语义不变 */
+class BufRing {
+public:
+    BufRing();
+    ~BufRing();
+
+    BufRing(const BufRing&) = delete;
+    BufRing& operator=(const BufRing&) = delete;
+
+    bool Init(Uring& ring, uint16_t group, unsigned count, size_t size, uint64_t tag, std::string* err);
+    // count 向上取整为 2 的幂，每块 size 字节；group 为 recv 时 buf_group 的取值；
+    // tag 为退回模式下交还缓冲区的 user_data，成功时没有 CQE，失败时以它报告
+
+    const char* Data(uint16_t bid) const { return bufs_[bid]; }
+
+    void Recycle(uint16_t bid);  // 把用完的缓冲区放回环尾，Commit 后内核可以再用
+    void Commit();
+
+    uint16_t Group() const { return group_; }
+    bool Legacy() const { return legacy_; }
+
+private:
+    bool SelfTest_();  // 从管道读一个字节，确认内核能从环里选出缓冲区
+
+    Uring* uring_;
+    bool legacy_;  // 使用 IORING_OP_PROVIDE_BUFFERS
+    uint64_t tag_;
+    struct io_uring_buf_ring* ring_;
+    size_t ringSize_;
+    unsigned mask_;
+    uint16_t tail_;
+    uint16_t group_;
+    size_t size_;
+    size_t cap_;  // 每块在 BufferPool 中的实际容量
+    std::vector<char*> bufs_;
+    std::vector<uint16_t> returned_;  // 退回模式下等待交还的缓冲区
+};
+
+#endif //HAVE_URING
+
+#endif //URING_H
@@ -0,0 +1,604 @@
+#include "uringreactor.h"
+
+using namespace std;
+
+#ifndef HAVE_URING
+
+UringReactor* UringReactor::Create(int, const Listener*, int, int, bool, ThreadPool*, const Options&, string* err) {
+    *err = "built without io_uring";
+    return nullptr;
+}
+
+#else
+
+struct UringReactor::Slot_ {
+    int inflight;  // 本连接已提交、尚未完成的请求（含链接的超时）
+    bool recving;
+    bool writing;  // sendmsg 或 POLLOUT 已提交
+    bool closing;  // 已 shutdown，inflight 归零后关闭
+    struct __kernel_timespec timeout;  // 链接超时的参数，提交前必须有效
+    struct msghdr msg;
+    struct iovec iov[16];
+};
+
+UringReactor* UringReactor::Create(int listenFd, const Listener* listener, int timeoutMS, int maxFd, bool timingWheel,
+                                   ThreadPool* sqlpool, const Options& options, string* err) {
+    unique_ptr<UringReactor> reactor(new UringReactor(listenFd, listener, timeoutMS, maxFd, timingWheel, sqlpool));
+    if(!reactor->Init_(options, err)) {
+        reactor->listenFd_ = -1;  // 失败时监听套接字还给调用方
+        return nullptr;
+    }
+    return reactor.release();
+}
+
+UringReactor::UringReactor(int listenFd, const Listener* listener, int timeoutMS, int maxFd, bool timingWheel,
+                           ThreadPool* sqlpool):
+            listenFd_(listenFd), listener_(listener), wakeupFd_(-1), timeoutMS_(timeoutMS), maxFd_(maxFd), isClose_(false),
+            drainRequested_(false), drained_(false), draining_(false), accepting_(false), wakeupValue_(0),
+            inflight_(0), sqlpool_(sqlpool), users_(maxFd), slots_((maxFd + (1 << SLOT_BITS) - 1) >> SLOT_BITS)
+    {
+    assert(sqlpool_ && listener_);
+    if(timingWheel) { timer_.reset(new TimingWheel()); }
+    else { timer_.reset(new HeapTimer()); }
+}
+
+bool UringReactor::Init_(const Options& options, string* err) {
+    ring_.reset(new Uring());
+    if(!ring_->Init(options.entries, options.sqpoll, err)) {
+        return false;
+    }
+    static const struct { int op; const char* name; } REQUIRED[] = {
+        { IORING_OP_ACCEPT, "accept" }, { IORING_OP_RECV, "recv" }, { IORING_OP_SENDMSG, "sendmsg" },
+        { IORING_OP_POLL_ADD, "poll_add" }, { IORING_OP_LINK_TIMEOUT, "link_timeout" },
+        { IORING_OP_READ, "read" }, { IORING_OP_ASYNC_CANCEL, "async_cancel" },
+        { IORING_OP_SOCKET, "socket" },  // 不使用，只用来确认内核在 5.19+：多发 accept 没有探测办法，是同一版本加入的
+    };
+    for(const auto& req: REQUIRED) {
+        if(!ring_->Supports(req.op)) {
+            *err = string("kernel lacks IORING_OP_") + req.name;
+            return false;
+        }
+    }
+    bufRing_.reset(new BufRing());
+    if(!bufRing_->Init(*ring_, BUF_GROUP, options.buffers, options.bufferSize, uint64_t(OP_PROVIDE) << 32, err)) {
+        return false;
+    }
+    /* 阻塞的 eventfd：io_uring 的 read 在计数为 0 时挂起等待，非阻塞时会直接返回 EAGAIN */
+    wakeupFd_ = eventfd(0, EFD_CLOEXEC);
+    if(wakeupFd_ < 0) {
+        *err = string("eventfd: ") + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+UringReactor::~UringReactor() {
+    Stop();
+    ring_.reset();  // 先关环，内核不再写提供缓冲区，之后才能释放它们
+    bufRing_.reset();
+    users_.ForEach([](HttpConn& user) { user.Close(); });
+    if(listenFd_ >= 0) { close(listenFd_); }
+    if(wakeupFd_ >= 0) { close(wakeupFd_); }
+    lock_guard<mutex> locker(mtx_);
+    for(auto& conn: pending_) {
+        close(conn.first);
+    }
+    pending_.clear();
+}
+
+void UringReactor::Start() {
+    assert(!thread_.joinable());
+    thread_ = thread(&UringReactor::Loop_, this);
+}
+
+void UringReactor::Stop() {
+    isClose_ = true;
+    if(wakeupFd_ >= 0) {
+        uint64_t one = 1;
+        ssize_t ret = ::write(wakeupFd_, &one, sizeof(one));
+        (void)ret;
+    }
+    if(thread_.joinable()) { thread_.join(); }
+}
+
+void UringReactor::AddConn(int fd, const sockaddr_in& addr) {
+    {
+        lock_guard<mutex> locker(mtx_);
+        pending_.emplace_back(fd, addr);
+    }
+    uint64_t one = 1;
+    ssize_t ret = ::write(wakeupFd_, &one, sizeof(one));
+    (void)ret;
+}
+
+void UringReactor::Drain(TimeStamp deadline) {
+    {
+        lock_guard<mutex> locker(mtx_);
+        drainDeadline_ = deadline;
+    }
+    drainRequested_ = true;
+    uint64_t one = 1;
+    ssize_t ret = ::write(wakeupFd_, &one, sizeof(one));
+    (void)ret;
+}
+
+UringReactor::Slot_& UringReactor::GetSlot_(int fd) {
+    assert(fd >= 0 && fd < maxFd_);
+    unique_ptr<Slot_[]>& chunk = slots_[fd >> SLOT_BITS];
+    if(!chunk) {
+        chunk.reset(new Slot_[1 << SLOT_BITS]());
+    }
+    return chunk[fd & ((1 << SLOT_BITS) - 1)];
+}
+
+struct io_uring_sqe* UringReactor::GetSqe_() {
+    struct io_uring_sqe* sqe = ring_->GetSqe();
+    if(sqe) { inflight_++; }
+    else { LOG_ERROR("io_uring submission queue full"); }
+    return sqe;
+}
+
+void UringReactor::Loop_() {
+    LOG_INFO("io_uring SubReactor started, recv buffers: %s", bufRing_->Legacy() ? "PROVIDE_BUFFERS" : "buffer ring");
+    if(listenFd_ >= 0) { ArmAccept_(); }
+    ArmWakeup_();
+    int timeMS = -1;
+    while(!isClose_) {
+        if(timeoutMS_ > 0) {
+            timeMS = timer_->GetNextTick();
+        }
+        if(draining_ && (timeMS < 0 || timeMS > DRAIN_TICK_MS)) {
+            timeMS = DRAIN_TICK_MS;
+        }
+        int ret = ring_->SubmitAndWait(timeMS);  // 上一轮产生的请求和等待合在一次系统调用里
+        if(ret < 0 && ret != -ETIME && ret != -EINTR && ret != -EBUSY) {
+            LOG_ERROR("io_uring_enter error: %s", strerror(-ret));
+        }
+        int64_t batchStart = Metrics::Now();
+        unsigned cnt = ring_->ForEachCqe([this](const struct io_uring_cqe& cqe) {
+            Dispatch_(cqe.user_data, cqe.res, cqe.flags);
+        });
+        bufRing_->Commit();  // 本轮用完的缓冲区一起还给内核
+        if(cnt > 0) {
+            Metrics::Instance()->Observe(Metrics::LOOP, Metrics::Now() - batchStart);
+            Metrics::Instance()->Add(Metrics::EPOLL_WAITS);
+            Metrics::Instance()->Add(Metrics::EPOLL_EVENTS, cnt);
+        }
+        if(!draining_ && drainRequested_) {
+            BeginDrain_();
+        }
+        if(draining_) {
+            CheckDrained_();
+        }
+    }
+    Quiesce_();
+}
+
+void UringReactor::Quiesce_() {
+    if(accepting_) { Cancel_(uint64_t(OP_ACCEPT) << 32); }
+    Cancel_(uint64_t(OP_WAKEUP) << 32);
+    users_.ForEach([this](HttpConn& user) {
+        if(!user.IsClosed() && GetSlot_(user.GetFd()).inflight > 0) {
+            shutdown(user.GetFd(), SHUT_RDWR);  // 挂起的 recv/sendmsg/poll 立即完成
+        }
+    });
+    TimeStamp deadline = Clock::now() + MS(QUIESCE_MS);
+    while(inflight_ > 0 && Clock::now() < deadline) {
+        ring_->SubmitAndWait(DRAIN_TICK_MS);
+        ring_->ForEachCqe([this](const struct io_uring_cqe& cqe) {
+            if(!(cqe.flags & IORING_CQE_F_MORE) && (cqe.user_data >> 32) != OP_PROVIDE) { inflight_--; }
+            if(cqe.flags & IORING_CQE_F_BUFFER) {
+                bufRing_->Recycle(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+            }
+        });
+        bufRing_->Commit();
+    }
+    if(inflight_ > 0) {
+        LOG_WARN("io_uring: %d request(s) still in flight at exit", inflight_);
+    }
+}
+
+void UringReactor::Dispatch_(uint64_t data, int res, uint32_t flags) {
+    OP op = static_cast<OP>(data >> 32);
+    int fd = static_cast<int>(static_cast<uint32_t>(data));
+    if(op == OP_PROVIDE) {
+        LOG_ERROR("io_uring provide buffers error: %s", strerror(-res));
+        return;
+    }
+    if(!(flags & IORING_CQE_F_MORE)) {
+        inflight_--;  // 多发请求只有最后一个 CQE 不带 F_MORE
+    }
+    switch(op) {
+        case OP_ACCEPT:
+            OnAccept_(res, flags);
+            break;
+        case OP_WAKEUP:
+            if(res < 0 && res != -EINTR && res != -EAGAIN) {
+                LOG_ERROR("io_uring eventfd read error: %s", strerror(-res));
+            }
+            DealWakeup_();
+            ArmWakeup_();
+            break;
+        case OP_RECV:
+            OnRecv_(fd, res, flags);
+            break;
+        case OP_WRITE:
+            OnWritten_(fd, res);
+            break;
+        case OP_POLL:
+            OnWritable_(fd, res);
+            break;
+        case OP_TIMEOUT:
+            Finish_(fd);  // 写先完成时超时以 -ECANCELED 结束，超时先到时写以 -ECANCELED 结束
+            break;
+        case OP_CANCEL:
+            break;
+        default:
+            LOG_ERROR("Unexpected io_uring completion %lu", (unsigned long)data);
+    }
+}
+
+void UringReactor::ArmAccept_() {
+    struct io_uring_sqe* sqe = GetSqe_();
+    if(!sqe) { return; }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenFd_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;  // 一次提交，每个新连接一个 CQE
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = uint64_t(OP_ACCEPT) << 32;
+    accepting_ = true;
+}
+
+void UringReactor::ArmWakeup_() {
+    if(isClose_) { return; }
+    struct io_uring_sqe* sqe = GetSqe_();
+    if(!sqe) { return; }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wakeupFd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&wakeupValue_);
+    sqe->len = sizeof(wakeupValue_);
+    sqe->off = uint64_t(-1);  // 不是可定位文件，使用当前位置
+    sqe->user_data = uint64_t(OP_WAKEUP) << 32;
+}
+
+void UringReactor::ArmRecv_(HttpConn* client) {
+    Slot_& slot = GetSlot_(client->GetFd());
+    if(client->IsClosed() || slot.closing || slot.recving || client->ToReadBytes() >= MAX_READ_BUFF) {
+        return;  // 积压过多时等解析取走后再收，写完响应后会重新调用
+    }
+    struct io_uring_sqe* sqe = GetSqe_();
+    if(!sqe) { return; }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = client->GetFd();
+    sqe->ioprio = IORING_RECVSEND_POLL_FIRST;  // 长连接上数据通常还没到，先挂 poll，不白做一次 recv
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bufRing_->Group();
+    sqe->user_data = uint64_t(OP_RECV) << 32 | uint32_t(client->GetFd());
+    slot.recving = true;
+    slot.inflight++;
+}
+
+void UringReactor::Cancel_(uint64_t target) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    if(!sqe) { return; }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = uint64_t(OP_CANCEL) << 32;
+}
+
+void UringReactor::OnAccept_(int res, uint32_t flags) {
+    if(!(flags & IORING_CQE_F_MORE)) {
+        accepting_ = false;
+        if(listenFd_ >= 0 && !draining_ && res != -ECANCELED) {
+            ArmAccept_();  // 内核结束了多发（如暂时没有 fd 可用），重新提交
+        }
+    }
+    if(res < 0) {
+        if(res != -ECANCELED && res != -EAGAIN) {
+            LOG_WARN("io_uring accept error: %s", strerror(-res));
+        }
+        return;
+    }
+    int fd = res;  // accept_flags 已带 SOCK_NONBLOCK | SOCK_CLOEXEC
+    listener_->SetupConn(fd);
+    if(fd >= maxFd_ || HttpConn::userCount >= maxFd_) {
+        send(fd, "Server busy!", 12, MSG_NOSIGNAL);
+        close(fd);
+        LOG_WARN("Clients is full!");
+        return;
+    }
+    struct sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    getpeername(fd, (struct sockaddr*)&addr, &len);  // 多发 accept 的地址缓冲区被共用，改为事后查询
+    AddClient_(fd, addr);
+}
+
+void UringReactor::DealWakeup_() {
+    vector<pair<int, sockaddr_in>> conns;
+    vector<unique_ptr<VerifyTask>> tasks;
+    {
+        lock_guard<mutex> locker(mtx_);
+        conns.swap(pending_);
+        tasks.swap(verified_);
+    }
+    for(auto& conn: conns) {
+        AddClient_(conn.first, conn.second);
+    }
+    for(auto& task: tasks) {
+        HttpConn* client = users_.Find(task->fd, task->gen);
+        if(!client || GetSlot_(task->fd).closing) {
+            continue;  // 等待期间连接已关闭，fd 可能已被复用
+        }
+        client->FinishVerify(task->ok);
+        ExtentTime_(client);
+        StartWrite_(client);
+    }
+}
+
+void UringReactor::AddClient_(int fd, const sockaddr_in& addr) {
+    assert(fd > 0);
+    HttpConn* client = users_.Get(fd);
+    client->init(fd, addr);
+    Slot_& slot = GetSlot_(fd);
+    slot.inflight = 0;
+    slot.recving = slot.writing = slot.closing = false;
+    if(timeoutMS_ > 0) {
+        uint32_t gen = client->GetGen();
+        timer_->add(fd, timeoutMS_, [this, fd, gen] {
+            HttpConn* conn = users_.Find(fd, gen);
+            if(conn) { Close_(conn); }
+        });
+    }
+    ArmRecv_(client);
+}
+
+void UringReactor::ExtentTime_(HttpConn* client) {
+    assert(client);
+    if(timeoutMS_ > 0) { timer_->adjust(client->GetFd(), timeoutMS_); }
+}
+
+void UringReactor::OnRecv_(int fd, int res, uint32_t flags) {
+    Slot_& slot = GetSlot_(fd);
+    slot.recving = false;
+    HttpConn* client = users_.Find(fd);
+    assert(client);
+    if(res > 0) {
+        assert(flags & IORING_CQE_F_BUFFER);
+        uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if(!slot.closing) {
+            client->Feed(bufRing_->Data(bid), res);  // 拷进连接自己的缓冲区，提供缓冲区马上可以复用
+        }
+        bufRing_->Recycle(bid);
+    }
+    if(slot.closing) {
+        Finish_(fd);
+        return;
+    }
+    slot.inflight--;
+    if(res > 0) {
+        ExtentTime_(client);
+        if(!slot.writing && !client->IsVerifying()) {
+            OnProcess_(client);  // 写的时候收到的数据（流水线）等本批响应发完再解析
+        }
+        ArmRecv_(client);
+    } else if(res == -ENOBUFS || res == -EAGAIN || res == -EINTR) {
+        ArmRecv_(client);  // 缓冲区暂时用完：本轮结束时会还回环中
+    } else {
+        Close_(client);  // 对端关闭或出错
+    }
+}
+
+void UringReactor::OnProcess_(HttpConn* client) {
+    if(client->process()) {
+        StartWrite_(client);
+    } else if(client->IsVerifying()) {
+        Verify_(client);
+    }
+    // 否则等待更多数据，recv 一直挂着
+}
+
+void UringReactor::StartWrite_(HttpConn* client) {
+    int fd = client->GetFd();
+    Slot_& slot = GetSlot_(fd);
+    assert(!slot.writing);
+    if(client->ToWriteBytes() == 0) {
+        WriteDone_(client);
+        return;
+    }
+    int cnt = client->PeekWriteIov(slot.iov, sizeof(slot.iov) / sizeof(slot.iov[0]));
+    uint8_t op;
+    if(cnt > 0) {
+        memset(&slot.msg, 0, sizeof(slot.msg));
+        slot.msg.msg_iov = slot.iov;
+        slot.msg.msg_iovlen = cnt;
+        op = OP_WRITE;
+    } else {
+        /* 队首是文件区间：sendfile 不经过环，直接发到写不下为止 */
+        int writeErrno = 0;
+        ssize_t ret = client->write(&writeErrno);
+        if(client->ToWriteBytes() == 0) {
+            WriteDone_(client);
+            return;
+        }
+        if(ret >= 0 || writeErrno != EAGAIN) {
+            Close_(client);
+            return;
+        }
+        op = OP_POLL;
+    }
+    if(timeoutMS_ > 0 && ring_->Space() < 2) {
+        ring_->Submit();  // 写和它的超时必须在同一次提交里，不能被队列满时的提交拆开
+    }
+    struct io_uring_sqe* sqe = GetSqe_();
+    if(!sqe) {
+        Close_(client);
+        return;
+    }
+    if(op == OP_WRITE) {
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&slot.msg);
+        sqe->msg_flags = MSG_NOSIGNAL;
+    } else {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = POLLOUT;
+    }
+    sqe->user_data = uint64_t(op) << 32 | uint32_t(fd);
+    slot.writing = true;
+    slot.inflight++;
+    if(timeoutMS_ <= 0 || ring_->Space() == 0) {
+        return;  // 没有空位时不带超时，由连接的定时器兜底
+    }
+    /* 链接的超时：对端在 timeoutMS_ 内没有读走数据时取消这次写 */
+    struct io_uring_sqe* timeout = GetSqe_();
+    assert(timeout);
+    sqe->flags |= IOSQE_IO_LINK;
+    slot.timeout.tv_sec = timeoutMS_ / 1000;
+    slot.timeout.tv_nsec = (timeoutMS_ % 1000) * 1000000LL;
+    timeout->opcode = IORING_OP_LINK_TIMEOUT;
+    timeout->fd = -1;
+    timeout->addr = reinterpret_cast<uint64_t>(&slot.timeout);
+    timeout->len = 1;
+    timeout->user_data = uint64_t(OP_TIMEOUT) << 32 | uint32_t(fd);
+    slot.inflight++;
+}
+
+void UringReactor::OnWritten_(int fd, int res) {
+    Slot_& slot = GetSlot_(fd);
+    slot.writing = false;
+    if(slot.closing) {
+        Finish_(fd);
+        return;
+    }
+    slot.inflight--;
+    HttpConn* client = users_.Find(fd);
+    assert(client);
+    if(res < 0) {
+        if(res == -ECANCELED) {
+            LOG_WARN("Client[%d] write timeout", fd);  // 链接的超时先到
+        }
+        Close_(client);
+        return;
+    }
+    client->Written(res);
+    if(client->ToWriteBytes() > 0) {
+        StartWrite_(client);
+    } else {
+        WriteDone_(client);
+    }
+}
+
+void UringReactor::OnWritable_(int fd, int res) {
+    Slot_& slot = GetSlot_(fd);
+    slot.writing = false;
+    if(slot.closing) {
+        Finish_(fd);
+        return;
+    }
+    slot.inflight--;
+    HttpConn* client = users_.Find(fd);
+    assert(client);
+    if(res < 0 || (res & (POLLERR | POLLHUP))) {
+        Close_(client);
+        return;
+    }
+    StartWrite_(client);
+}
+
+void UringReactor::WriteDone_(HttpConn* client) {
+    if(!client->IsKeepAlive()) {
+        Close_(client);
+        return;
+    }
+    OnProcess_(client);  // 解析写的时候收到的请求
+    ArmRecv_(client);
+}
+
+void UringReactor::Verify_(HttpConn* client) {
+    unique_ptr<VerifyTask> task = client->MakeVerifyTask();
+    int cached = HttpRequest::CachedVerify(task->name, task->pwd, task->isLogin);
+    if(cached >= 0) {
+        client->FinishVerify(cached);  // 用户缓存命中，不经过数据库线程
+        StartWrite_(client);
+        return;
+    }
+    bool queued = sqlpool_->TryAddTask([this, task = std::move(task)]() mutable {
+        task->ok = HttpRequest::UserVerify(task->name, task->pwd, task->isLogin);
+        {
+            lock_guard<mutex> locker(mtx_);
+            verified_.push_back(std::move(task));
+        }
+        uint64_t one = 1;
+        ssize_t ret = ::write(wakeupFd_, &one, sizeof(one));
+        (void)ret;
+    });
+    if(!queued) {
+        client->RejectVerify();  // 数据库跟不上时直接回 503，事件循环不等待
+        StartWrite_(client);
+    }
+}
+
+void UringReactor::Close_(HttpConn* client) {
+    assert(client);
+    int fd = client->GetFd();
+    Slot_& slot = GetSlot_(fd);
+    if(client->IsClosed() || slot.closing) { return; }
+    if(slot.inflight == 0) {
+        LOG_INFO("Client[%d] quit!", fd);
+        client->Close();
+        return;
+    }
+    /* 内核还在使用 fd 和连接的缓冲区：先 shutdown 让挂起的请求尽快结束，fd 在它们都完成后才关闭，
+       期间不会被新连接复用 */
+    slot.closing = true;
+    shutdown(fd, SHUT_RDWR);
+}
+
+void UringReactor::Finish_(int fd) {
+    Slot_& slot = GetSlot_(fd);
+    if(--slot.inflight > 0 || !slot.closing) { return; }
+    slot.closing = false;
+    HttpConn* client = users_.Find(fd);
+    assert(client);
+    LOG_INFO("Client[%d] quit!", fd);
+    client->Close();
+}
+
+void UringReactor::BeginDrain_() {
+    draining_ = true;
+    if(listenFd_ >= 0) {
+        if(accepting_) {
+            Cancel_(uint64_t(OP_ACCEPT) << 32);  // 环里的 accept 持有套接字，必须取消
+            ring_->Submit();  // 立即取消，不再接收交给新进程的连接
+        }
+        close(listenFd_);  // 平滑升级时新进程持有同一个套接字，排队的连接由它接收
+        listenFd_ = -1;
+    }
+}
+
+void UringReactor::CheckDrained_() {
+    bool forced, pending;
+    {
+        lock_guard<mutex> locker(mtx_);
+        forced = Clock::now() >= drainDeadline_;
+        pending = !pending_.empty();
+    }
+    int open = 0;
+    users_.ForEach([&](HttpConn& user) {
+        if(user.IsClosed()) { return; }
+        if(forced || user.IsIdle()) {
+            Close_(&user);
+        }
+        if(!user.IsClosed()) {
+            open++;  // 包括等待请求完成、尚未真正关闭的连接
+        }
+    });
+    if(forced || (open == 0 && !pending)) {
+        drained_ = true;
+        isClose_ = true;
+    }
+}
+
+#endif //HAVE_URING
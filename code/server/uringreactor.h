@@ -0,0 +1,147 @@
+#ifndef URING_REACTOR_H
+#define URING_REACTOR_H
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <sys/eventfd.h>  // eventfd()
+#include <fcntl.h>  // fcntl()
+#include <poll.h>   // POLLOUT
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "reactor.h"
+#include "listener.h"
+#include "uring.h"
+#include "conntable.h"
+#include "../log/log.h"
+#include "../timer/heaptimer.h"
+#include "../timer/timingwheel.h"
+#include "../pool/threadpool.h"
+#include "../http/httpconn.h"
+#include "../metrics/metrics.h"
+
+/* io_uring 后端的子 Reactor，与 SubReactor 的分工相同（one loop per thread），
+   但读写由内核完成后通知，而不是就绪后再由本线程调用 read/write：
+   - 监听套接字上一个多发（multishot）accept，新连接不再逐个调用 accept
+   - recv 从提供缓冲区环中取缓冲区，等待数据期间连接不占读缓冲区
+   - 响应用 sendmsg 发送，链接一个超时（LINK_TIMEOUT），对端长时间不读时取消
+   - 一轮事件产生的所有请求在下一次 io_uring_enter 中一起提交，可选 SQPOLL 连这次系统调用也省去
+   文件区间（大于 mmap 上限的文件）仍用 sendfile 同步发送，写不下时等 POLLOUT 再继续 */
+class UringReactor : public Reactor {
+public:
+    struct Options {
+        unsigned entries;   // 提交队列长度
+        unsigned buffers;   // 提供缓冲区的块数
+        size_t bufferSize;  // 每块大小，也是一次 recv 的上限
+        bool sqpoll;        // 内核线程轮询提交队列
+    };
+
+    static UringReactor* Create(int listenFd, const Listener* listener, int timeoutMS, int maxFd, bool timingWheel,
+                                ThreadPool* sqlpool, const Options& options, std::string* err);
+    // 内核不支持所需特性（或编译时未启用）时返回 nullptr 并写入原因，listenFd 仍归调用方
+
+    ~UringReactor();
+
+    void Start() override;
+    void Stop() override;
+
+    void AddConn(int fd, const sockaddr_in& addr) override;
+
+    void Drain(TimeStamp deadline) override;
+    bool Drained() const override { return drained_; }
+
+    int ListenFd() const override { return listenFd_; }
+
+private:
+    UringReactor(int listenFd, const Listener* listener, int timeoutMS, int maxFd, bool timingWheel, ThreadPool* sqlpool);
+
+    bool Init_(const Options& options, std::string* err);
+
+    /* user_data 的高 32 位是操作，低 32 位是 fd */
+    enum OP {
+        OP_ACCEPT = 1,
+        OP_WAKEUP,   // eventfd 上的 read
+        OP_RECV,
+        OP_WRITE,    // sendmsg
+        OP_POLL,     // sendfile 写不下时等待可写
+        OP_TIMEOUT,  // 链接在写操作后的超时
+        OP_CANCEL,
+        OP_PROVIDE,  // 退回模式下交还缓冲区，只有失败时才有 CQE，不计入 inflight_
+    };
+
+    struct Slot_;  // 连接在环上的状态，按 fd 分块存放
+
+    void Loop_();
+    void Dispatch_(uint64_t data, int res, uint32_t flags);
+    void Quiesce_();  // 退出前取消所有未完成的请求并等它们完成，之后内核不再访问本对象的内存
+
+    void ArmAccept_();
+    void ArmWakeup_();
+    void ArmRecv_(HttpConn* client);
+    void Cancel_(uint64_t target);
+
+    void OnAccept_(int res, uint32_t flags);
+    void OnRecv_(int fd, int res, uint32_t flags);
+    void OnWritten_(int fd, int res);
+    void OnWritable_(int fd, int res);
+
+    void DealWakeup_();
+    void AddClient_(int fd, const sockaddr_in& addr);  // fd 已是非阻塞（sendfile 路径需要）
+    void ExtentTime_(HttpConn* client);
+
+    void OnProcess_(HttpConn* client);
+    void StartWrite_(HttpConn* client);
+    void WriteDone_(HttpConn* client);
+    void Verify_(HttpConn* client);
+
+    void Close_(HttpConn* client);  // 有未完成的请求时先 shutdown，等它们都完成后再关闭
+    void Finish_(int fd);  // 一个连接请求完成
+
+    void BeginDrain_();
+    void CheckDrained_();
+
+    Slot_& GetSlot_(int fd);
+    struct io_uring_sqe* GetSqe_();
+
+    int listenFd_;
+    const Listener* listener_;  // 多发 accept 本身按完成事件成批收割，只用它设置连接选项
+    int wakeupFd_;  // eventfd，用于投递连接和退出通知
+    int timeoutMS_;
+    int maxFd_;
+    std::atomic<bool> isClose_;
+    std::atomic<bool> drainRequested_;
+    std::atomic<bool> drained_;
+    bool draining_;
+    TimeStamp drainDeadline_;  // 由 mtx_ 保护
+
+    bool accepting_;  // 多发 accept 仍然有效
+    uint64_t wakeupValue_;  // eventfd 的 read 结果
+    int inflight_;  // 已提交、还没有最终完成的请求数
+
+    std::unique_ptr<Timer> timer_;
+#ifdef HAVE_URING
+    std::unique_ptr<Uring> ring_;
+    std::unique_ptr<BufRing> bufRing_;
+#endif
+    ThreadPool* sqlpool_;
+    ConnTable users_;  // 只被本线程访问
+    std::vector<std::unique_ptr<Slot_[]>> slots_;
+
+    static const int SLOT_BITS = 8;
+    static const int DRAIN_TICK_MS = 100;
+    static const int QUIESCE_MS = 1000;
+    static const size_t MAX_READ_BUFF = 64 << 10;  // 读缓冲区积压到这么多时暂停 recv
+    static const uint16_t BUF_GROUP = 0;
+
+    std::mutex mtx_;  // 保护 pending_、verified_ 和 drainDeadline_
+    std::vector<std::pair<int, sockaddr_in>> pending_;
+    std::vector<std::unique_ptr<VerifyTask>> verified_;
+
+    std::thread thread_;
+};
+
+#endif //URING_REACTOR_H
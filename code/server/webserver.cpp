@@ -2,45 +2,132 @@
 
 using namespace std;
 
-WebServer::WebServer(
-            int port, int trigMode, int timeoutMS, bool OptLinger,
-            int sqlPort, const char* sqlUser, const  char* sqlPwd,
-            const char* dbName, int connPoolNum, int threadNum,
-            bool openLog, int logLevel, int logQueSize):
-            port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS), isClose_(false),
-            timer_(new HeapTimer()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller())
+WebServer::WebServer(const Config& config):
+            port_(config.port), timeoutMS_(config.timeoutMS), maxFd_(config.maxFd), maxEvents_(config.maxEvents), isClose_(false),
+            listenFd_(-1), signalFd_(-1), shutdownTimeoutMS_(config.shutdownTimeoutMS), draining_(false),
+            subReactorNum_(config.subReactors), reusePort_(config.reusePort),
+            timingWheel_(config.timingWheel), nextReactor_(0), uring_(config.uring),
+            uringOptions_{ static_cast<unsigned>(config.uringEntries), static_cast<unsigned>(config.uringBuffers),
+                           config.uringBufferSize, config.uringSqpoll },
+            listener_({ config.port, config.backlog, config.optLinger, config.tcpDeferAccept,
+                        config.tcpFastOpen, config.tcpNoDelay, config.acceptBatch }),
+            epoller_(new Epoller(config.maxEvents)),
+            users_(config.maxFd), inherited_(0)
     {
-    srcDir_ = getcwd(nullptr, 256);
+    assert(subReactorNum_ >= 0);
+    /* 在创建任何线程之前屏蔽退出信号，之后的线程都继承，信号只经 signalfd 交给主循环 */
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    signalFd_ = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    assert(signalFd_ >= 0);
+    epoller_->AddFd(signalFd_, EPOLLIN);
+    HttpConn::draining = false;
+    if(!config.upgradeSocket.empty()) {
+        handover_.reset(new Handover(config.upgradeSocket));
+    }
+    if(timingWheel_) { timer_.reset(new TimingWheel()); }
+    else { timer_.reset(new HeapTimer()); }
+    if(subReactorNum_ == 0) {
+        threadpool_.reset(new ThreadPool(config.threads, config.queueSize));  // 子 Reactor 模式下连接在所属线程处理，不需要线程池
+    }
+    sqlpool_.reset(new ThreadPool(config.connPoolNum, config.queueSize));  // 线程数等于连接数，查库时不会等待空闲连接
+    wakeupFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(wakeupFd_ >= 0);
+    epoller_->AddFd(wakeupFd_, EPOLLIN);
+    if(config.resourceDir.empty()) {
+        char* cwd = getcwd(nullptr, 0);
+        assert(cwd);
+        srcDir_ = strdup((string(cwd) + "/resources/").c_str());
+        free(cwd);
+    } else {
+        srcDir_ = strdup(config.resourceDir.c_str());
+    }
     assert(srcDir_);
-    strncat(srcDir_, "/resources/", 16);
+    signal(SIGPIPE, SIG_IGN);  // 对端已关闭时 writev/sendfile 返回 EPIPE，而不是让进程被信号杀死
     HttpConn::userCount = 0;   // 初始化用户数量为0
     HttpConn::srcDir = srcDir_;  // 设置资源目录
-    SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
-    // 设置数据库地址为 localhost
+    HttpConn::initBuffSize = config.initBuffSize;
+    HttpConn::cork = config.tcpCork;
+    Metrics::Instance()->Init(config.metrics, config.metricsPath);  // 在任何线程开始记录之前
+    SqlConnPool::Instance()->Init(config.sqlHost.c_str(), config.sqlPort, config.sqlUser.c_str(),
+                                  config.sqlPwd.c_str(), config.dbName.c_str(), config.connPoolNum);
 
-    InitEventMode_(trigMode);  // 初始化事件模式
+    InitEventMode_(config.trigMode);  // 初始化事件模式
     if(!InitSocket_()) { isClose_ = true;}   // 调用 InitSocket_() 创建并初始化监听套接字。
 
-    if(openLog) {
-        Log::Instance()->init(logLevel, "./log", ".log", logQueSize);
+    if(config.openLog) {
+        Log::Instance()->init(config.logLevel, config.logDir.c_str(), ".log", config.logQueSize);
         if(isClose_) { LOG_ERROR("========== Server init error!=========="); }
         else {
             LOG_INFO("========== Server init ==========");
-            LOG_INFO("Port:%d, OpenLinger: %s", port_, OptLinger? "true":"false");
+            LOG_INFO("Port:%d, OpenLinger: %s, Backlog: %d, AcceptBatch: %d", port_,
+                            config.optLinger ? "true":"false", config.backlog, config.acceptBatch);
+            LOG_INFO("TCP DeferAccept: %ds, FastOpen: %d, NoDelay: %s, Cork: %s", config.tcpDeferAccept,
+                            config.tcpFastOpen, config.tcpNoDelay ? "true":"false", config.tcpCork ? "true":"false");
             LOG_INFO("Listen Mode: %s, OpenConn Mode: %s",
                             (listenEvent_ & EPOLLET ? "ET": "LT"),
                             (connEvent_ & EPOLLET ? "ET": "LT"));
-            LOG_INFO("LogSys level: %d", logLevel);
+            LOG_INFO("LogSys level: %d, Timer: %s", config.logLevel, timingWheel_ ? "TimingWheel" : "HeapTimer");
             LOG_INFO("srcDir: %s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            if(inherited_ > 0) {
+                LOG_INFO("Listener(s) inherited from the previous process: %zu", inherited_);
+            }
+            LOG_INFO("MaxFd: %d, MaxEvents: %d, InitBuffSize: %zu", maxFd_, maxEvents_, config.initBuffSize);
+            if(subReactorNum_ > 0) {
+                LOG_INFO("SqlConnPool num: %d, SubReactor num: %d, Dispatch: %s, Backend: %s", config.connPoolNum,
+                            subReactorNum_, reusePort_ ? "SO_REUSEPORT" : "round-robin",
+                            uring_ && uringError_.empty() ? (uringOptions_.sqpoll ? "io_uring+SQPOLL" : "io_uring") : "epoll");
+                if(uring_ && !uringError_.empty()) {
+                    LOG_WARN("io_uring unavailable, falling back to epoll: %s", uringError_.c_str());
+                }
+            } else {
+                LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d, queue: %d", config.connPoolNum,
+                            config.threads, config.queueSize);
+            }
+        }
+        Log::Instance()->flush();  // 启动信息马上落盘，之后长时间没有日志时也能看到
+    }
+    FileCache::Instance()->Init(config.fileCacheEntries, config.fileCacheBytes,
+                                config.fileCacheTtlMS, config.mmapLimit);  // 静态文件缓存，inotify 监听资源目录变化
+    for(const auto& item: config.cacheMaxAge) {
+        FileCache::Instance()->SetMaxAge(item.first, item.second);  // 配置覆盖内置的缓存策略
+    }
+    CompressCache::Instance()->Init(config.compressCacheBytes, config.compressMinLen);
+    // 现场 gzip/br 压缩结果的缓存，每个文件只压缩一次
+    UserCache::Instance()->Init(config.userCacheEntries, config.userCacheTtlMS,
+                                config.userCacheNegativeTtlMS);  // 登录验证的用户缓存，重复登录不再查库
+    if(!warmPaths_.empty()) {
+        size_t loaded = 0;
+        for(const string& path: warmPaths_) {
+            loaded += FileCache::Instance()->Get(path) != nullptr;  // 旧进程的热点文件先载入，接管后不从冷缓存开始
         }
+        LOG_INFO("FileCache warmed %zu/%zu file(s) from the previous process", loaded, warmPaths_.size());
+        warmPaths_.clear();
     }
 }
 
 WebServer::~WebServer() {
-    close(listenFd_);  // 关闭监听套接字
+    /* 先停下所有会投递任务的线程，再按依赖倒序回收：
+       子 Reactor 的事件循环 -> 工作线程 -> 数据库线程（结果会投递给子 Reactor）-> 子 Reactor 对象 */
+    for(auto& reactor: subReactors_) {
+        reactor->Stop();
+    }
+    threadpool_.reset();  // 等正在生成或发送的响应完成
+    sqlpool_.reset();
+    subReactors_.clear();
+    users_.ForEach([](HttpConn& user) { user.Close(); });  // 优雅退出超时仍未结束的连接
+    if(listenFd_ >= 0) { close(listenFd_); }  // 关闭监听套接字
+    handover_.reset();
+    close(wakeupFd_);
+    close(signalFd_);
     isClose_ = true;  // 设置服务器关闭标志
     free(srcDir_);  // 释放资源目录指针
+    UserCache::Stats stats = UserCache::Instance()->GetStats();
+    LOG_INFO("UserCache hits: %zu, negative hits: %zu, misses: %zu, evictions: %zu, entries: %zu",
+             stats.hits, stats.negativeHits, stats.misses, stats.evictions, stats.entries);
     SqlConnPool::Instance()->ClosePool();  // 关闭数据库连接池
 }
 
@@ -75,11 +162,24 @@ void WebServer::InitEventMode_(int trigMode) {
 void WebServer::Start() {
     int timeMS = -1;  /* epoll wait timeout == -1 无事件将阻塞 */
     if(!isClose_) { LOG_INFO("========== Server start =========="); }
+    for(auto& reactor: subReactors_) {
+        reactor->Start();  // 子 Reactor 各自运行事件循环，主循环只负责分发（或空转等待）
+    }
+    if(handover_ && !isClose_) {
+        handover_->Confirm();  // 从旧进程接过了监听套接字：初始化已完成，旧进程可以停止 accept
+        if(handover_->Listen()) {
+            epoller_->AddFd(handover_->ListenFd(), EPOLLIN);  // 等待下一次升级
+        }
+    }
     while(!isClose_) {
         if(timeoutMS_ > 0) {
             timeMS = timer_->GetNextTick();  // 获取下一个超时事件的时间间隔
         }
+        if(draining_ && (timeMS < 0 || timeMS > DRAIN_TICK_MS)) {
+            timeMS = DRAIN_TICK_MS;
+        }
         int eventCnt = epoller_->Wait(timeMS);  //eventCnt 表示本次触发的事件数量。
+        int64_t batchStart = Metrics::Now();
         for(int i = 0; i < eventCnt; i++) {
             /* 处理事件 */
             int fd = epoller_->GetEventFd(i);  // 获取就绪事件的文件描述符
@@ -87,21 +187,127 @@ void WebServer::Start() {
             if(fd == listenFd_) {  
                 DealListen_();    //如果 fd == listenFd_，表示有新客户端连接。
             }
+            else if(fd == wakeupFd_) {
+                DealVerified_();  // 数据库线程返回了验证结果
+            }
+            else if(fd == signalFd_) {
+                DealSignal_();
+            }
+            else if(handover_ && (fd == handover_->ListenFd() || fd == handover_->ConnFd())) {
+                DealHandover_(fd);
+            }
             else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-                assert(users_.count(fd) > 0);
-                CloseConn_(&users_[fd]);    //调用 CloseConn_() 关闭连接。
+                assert(users_.Find(fd));
+                CloseConn_(users_.Find(fd));    //调用 CloseConn_() 关闭连接。
             }
             else if(events & EPOLLIN) {   // 读事件（客户端发送数据）
-                assert(users_.count(fd) > 0);
-                DealRead_(&users_[fd]);
+                assert(users_.Find(fd));
+                DealRead_(users_.Find(fd));
             }
             else if(events & EPOLLOUT) {  // 写事件（服务器发送数据）
-                assert(users_.count(fd) > 0);
-                DealWrite_(&users_[fd]);
+                assert(users_.Find(fd));
+                DealWrite_(users_.Find(fd));
             } else {
                 LOG_ERROR("Unexpected event");
             }
         }
+        if(eventCnt > 0) {
+            Metrics::Instance()->Observe(Metrics::LOOP, Metrics::Now() - batchStart);
+            Metrics::Instance()->Add(Metrics::EPOLL_WAITS);
+            Metrics::Instance()->Add(Metrics::EPOLL_EVENTS, eventCnt);
+        }
+        if(draining_) {
+            CheckDrained_();
+        }
+    }
+}
+
+void WebServer::DealSignal_() {
+    struct signalfd_siginfo info;
+    while(read(signalFd_, &info, sizeof(info)) == sizeof(info)) {
+        if(draining_) {
+            LOG_WARN("Signal %u during shutdown, exit now", info.ssi_signo);
+            isClose_ = true;  // 再次收到信号：不再等待
+            return;
+        }
+        LOG_INFO("Signal %u, graceful shutdown within %d ms", info.ssi_signo, shutdownTimeoutMS_);
+        BeginShutdown_();
+    }
+}
+
+void WebServer::DealHandover_(int fd) {
+    if(fd == handover_->ListenFd()) {
+        int conn = handover_->Accept();
+        if(conn >= 0) {
+            epoller_->AddFd(conn, EPOLLIN | EPOLLRDHUP);
+        }
+        return;
+    }
+    vector<int> listenFds;
+    if(listenFd_ >= 0) { listenFds.push_back(listenFd_); }
+    for(auto& reactor: subReactors_) {
+        if(reactor->ListenFd() >= 0) { listenFds.push_back(reactor->ListenFd()); }
+    }
+    Handover::STATE state = handover_->OnReadable(listenFds, FileCache::Instance()->HotPaths(HOT_PATHS));
+    if(state == Handover::WAITING) {
+        return;
+    }
+    epoller_->DelFd(fd);
+    handover_->CloseConn();
+    if(state == Handover::DONE) {
+        LOG_INFO("Listener(s) taken over by the new process, graceful shutdown within %d ms", shutdownTimeoutMS_);
+        BeginShutdown_();
+    } else {
+        LOG_WARN("Handover aborted by the new process, keep serving");
+    }
+}
+
+void WebServer::BeginShutdown_() {
+    if(draining_) { return; }
+    draining_ = true;
+    HttpConn::draining = true;  // 之后生成的响应都带 Connection: close
+    drainDeadline_ = Clock::now() + MS(shutdownTimeoutMS_);
+    if(listenFd_ >= 0) {
+        epoller_->DelFd(listenFd_);
+        close(listenFd_);  // 已完成握手、尚未 accept 的连接：被接管时由新进程接收，否则被内核重置
+        listenFd_ = -1;
+    }
+    for(auto& reactor: subReactors_) {
+        reactor->Drain(drainDeadline_);
+    }
+    if(handover_) {
+        if(handover_->ConnFd() >= 0) {
+            epoller_->DelFd(handover_->ConnFd());
+            handover_->CloseConn();
+        }
+        if(handover_->ListenFd() >= 0) {
+            epoller_->DelFd(handover_->ListenFd());
+            handover_->Close();
+        }
+    }
+    CheckDrained_();
+}
+
+void WebServer::CheckDrained_() {
+    int open = 0;
+    users_.ForEach([&](HttpConn& user) {
+        if(user.IsClosed()) { return; }
+        if(user.IsIdle()) {
+            CloseConn_(&user);  // 空闲的长连接直接关闭，进行中的等响应发完
+        } else {
+            open++;
+        }
+    });
+    for(auto& reactor: subReactors_) {
+        if(!reactor->Drained()) { open++; }
+    }
+    if(open == 0) {
+        LOG_INFO("All connections finished");
+        isClose_ = true;
+    } else if(Clock::now() >= drainDeadline_) {
+        /* 工作线程可能还持有连接，剩下的在析构时等线程池退出后再关闭 */
+        LOG_WARN("Shutdown timeout, %d connection(s)/reactor(s) still busy", open);
+        isClose_ = true;
     }
 }
 
@@ -123,48 +329,68 @@ void WebServer::CloseConn_(HttpConn* client) {
 
 void WebServer::AddClient_(int fd, sockaddr_in addr) {
     assert(fd > 0);
-    users_[fd].init(fd, addr);  // 初始化 HttpConn 对象
+    HttpConn* client = users_.Get(fd);
+    client->init(fd, addr);  // 初始化 HttpConn 对象
     if(timeoutMS_ > 0) {
-        timer_->add(fd, timeoutMS_, std::bind(&WebServer::CloseConn_, this, &users_[fd]));  
-        // this->CloseConn_(&users_[fd]);
-        // 调用当前这个实例对象的CloseConn_函数
+        uint32_t gen = client->GetGen();
+        timer_->add(fd, timeoutMS_, [this, fd, gen] {
+            HttpConn* conn = users_.Find(fd, gen);
+            if(conn) { CloseConn_(conn); }  // 连接已关闭或 fd 已换了主人时不动它
+        });
     }
     epoller_->AddFd(fd, EPOLLIN | connEvent_);
     //  EPOLLIN：表示可读事件（客户端发送数据）。
     //  connEvent_：包含 EPOLLONESHOT | EPOLLRDHUP，用于防止并发处理和检测客户端断开。
+    //  fd 由 accept4 创建时已是非阻塞，read() 和 write() 不会阻塞等待。
 
-    SetFdNonblock(fd); 
-    //  调用 SetFdNonblock 方法将文件描述符设置为 非阻塞模式。
-    //  非阻塞模式下，read() 和 write() 不会阻塞等待，提升并发性能。
-
-    LOG_INFO("Client[%d] in!", users_[fd].GetFd());
+    LOG_INFO("Client[%d] in!", client->GetFd());
 }
 
 void WebServer::DealListen_() {
-    struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
-    do {
-        int fd = accept(listenFd_, (struct sockaddr *)&addr, &len);  // 接受新连接
-        if(fd <= 0) { return;}  // 如果 accept 失败，直接返回
-        else if(HttpConn::userCount >= MAX_FD) {
+    int n = listener_.AcceptSome(listenFd_, [this](int fd, const sockaddr_in& addr) {  // 新连接已是非阻塞
+        if(fd >= maxFd_ || HttpConn::userCount >= maxFd_) {
             SendError_(fd, "Server busy!");
             LOG_WARN("Clients is full!");
             return;
-        }   // 如果当前连接数超过最大限制，发送错误信息并返回
+        }   // 如果当前连接数超过最大限制，发送错误信息后继续取下一个
+        if(!subReactors_.empty()) {
+            // 轮询交给子 Reactor，之后该连接的所有事件都由它处理
+            subReactors_[nextReactor_++ % subReactors_.size()]->AddConn(fd, addr);
+            return;
+        }
         AddClient_(fd, addr);  // 添加新客户端连接
-    } while(listenEvent_ & EPOLLET);  // 
+    });
+    /* 取满一批时队列里可能还有连接：LT 下次 epoll_wait 仍会报告，ET 不会再有新的边沿，
+       重新 MOD 一次让 epoll 检查就绪状态，先处理完本轮其他事件再回来 */
+    if(n == listener_.AcceptBatch() && (listenEvent_ & EPOLLET)) {
+        epoller_->ModFd(listenFd_, listenEvent_ | EPOLLIN);
+    }
 }
 
 void WebServer::DealRead_(HttpConn* client) {
     assert(client);  
     ExtentTime_(client);  
-    threadpool_->AddTask(std::bind(&WebServer::OnRead_, this, client));  // 将读事件的处理任务添加到线程池中
+    uint32_t gen = client->GetGen();
+    int64_t queued = Metrics::Now();
+    client->Pin();  // 优雅退出时主线程不会关闭工作线程正在处理的连接
+    threadpool_->AddTask([this, client, gen, queued] {
+        Metrics::Instance()->Observe(Metrics::QUEUE_WAIT, Metrics::Now() - queued);
+        if(client->GetGen() == gen) { OnRead_(client); }  // 排队期间连接被关闭则丢弃
+        client->Unpin();
+    });  // 将读事件的处理任务添加到线程池中
 }
 
 void WebServer::DealWrite_(HttpConn* client) {
     assert(client);
     ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnWrite_, this, client));  // 将写事件的处理任务添加到线程池中
+    uint32_t gen = client->GetGen();
+    int64_t queued = Metrics::Now();
+    client->Pin();  // 优雅退出时主线程不会关闭工作线程正在处理的连接
+    threadpool_->AddTask([this, client, gen, queued] {
+        Metrics::Instance()->Observe(Metrics::QUEUE_WAIT, Metrics::Now() - queued);
+        if(client->GetGen() == gen) { OnWrite_(client); }
+        client->Unpin();
+    });  // 将写事件的处理任务添加到线程池中
 }
 
 void WebServer::ExtentTime_(HttpConn* client) {
@@ -186,12 +412,59 @@ void WebServer::OnRead_(HttpConn* client) {
 
 void WebServer::OnProcess(HttpConn* client) {
     if(client->process()) {   //解析 HTTP 请求并生成响应。
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);  // 将监听事件改为 EPOLLOUT（可写事件）。
+        OnWrite_(client);  // 响应已就绪，在本工作线程直接发送，写不完（EAGAIN）才注册 EPOLLOUT
+    } else if(client->IsVerifying()) {
+        Verify_(client);  // 不重新注册事件（ONESHOT），连接在结果返回前保持静默
     } else {
         epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);  /// 如果解析失败，则将监听事件改为 EPOLLIN（可读事件）。
     }
 }
 
+void WebServer::Verify_(HttpConn* client) {
+    /* 工作线程不等数据库：查询在数据库线程中完成，结果经 eventfd 交回主循环 */
+    unique_ptr<VerifyTask> task = client->MakeVerifyTask();
+    int cached = HttpRequest::CachedVerify(task->name, task->pwd, task->isLogin);
+    if(cached >= 0) {
+        client->FinishVerify(cached);  // 用户缓存命中，不经过数据库线程
+        OnWrite_(client);
+        return;
+    }
+    bool queued = sqlpool_->TryAddTask([this, task = std::move(task)]() mutable {
+        task->ok = HttpRequest::UserVerify(task->name, task->pwd, task->isLogin);
+        {
+            lock_guard<mutex> locker(verifyMtx_);
+            verified_.push_back(std::move(task));
+        }
+        uint64_t one = 1;
+        ssize_t ret = write(wakeupFd_, &one, sizeof(one));
+        (void)ret;
+    });
+    if(!queued) {
+        client->RejectVerify();  // 数据库跟不上时直接回 503，不排队等待
+        OnWrite_(client);
+    }
+}
+
+void WebServer::DealVerified_() {
+    uint64_t cnt = 0;
+    ssize_t ret = read(wakeupFd_, &cnt, sizeof(cnt));  // 读空计数器
+    (void)ret;
+    vector<unique_ptr<VerifyTask>> tasks;
+    {
+        lock_guard<mutex> locker(verifyMtx_);
+        tasks.swap(verified_);
+    }
+    for(auto& task: tasks) {
+        HttpConn* client = users_.Find(task->fd, task->gen);
+        if(!client) {
+            continue;  // 等待期间连接已超时关闭，fd 可能已被新连接复用
+        }
+        client->FinishVerify(task->ok);
+        ExtentTime_(client);
+        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+    }
+}
+
 void WebServer::OnWrite_(HttpConn* client) {  // 处理可写事件。
     assert(client);
     int ret = -1;
@@ -217,78 +490,75 @@ void WebServer::OnWrite_(HttpConn* client) {  // 处理可写事件。
 
 /* Create listenFd */
 bool WebServer::InitSocket_() {
-    int ret;
-    struct sockaddr_in addr;
     if(port_ > 65535 || port_ < 1024) {
         LOG_ERROR("Port:%d error!",  port_);
         return false;
     }  //   端口号大于 65535 或小于 1024 时，返回错误。
 
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    addr.sin_port = htons(port_);
-
-    struct linger optLinger = { 0 };
-    if(openLinger_) {
-        /* 优雅关闭: 直到所剩数据发送完毕或超时 */
-        optLinger.l_onoff = 1;  // 开启 SO_LINGER 选项
-        optLinger.l_linger = 1;  // 关闭 socket 时最多等待 1 秒发送未发送的数据
+    /* 平滑升级：优先使用旧进程交过来的监听套接字，不够的再新建 */
+    vector<int> inherited;
+    if(handover_) {
+        handover_->Fetch(port_, &inherited, &warmPaths_);
     }
-
-    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);  // 创建监听套接字
-    if(listenFd_ < 0) {
-        LOG_ERROR("Create socket error!", port_);
-        return false;
-    }  // 创建监听套接字失败
-
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));  // 设置 SO_LINGER 选项
-
-    if(ret < 0) {
-        close(listenFd_);
-        LOG_ERROR("Init linger error!", port_);
-        return false;
-    } // 设置 SO_LINGER 选项失败
-
-    int optval = 1;
-    /* 端口复用 */
-    /* 只有最后一个套接字会正常接收数据。 */
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval, sizeof(int));  // 设置端口复用选项
-    //  SO_REUSEADDR 允许服务器在 TIME_WAIT 状态下重新绑定端口
-    if(ret == -1) {
-        LOG_ERROR("set socket setsockopt error !");
-        close(listenFd_);
-        return false;
-    }
-
-    ret = bind(listenFd_, (struct sockaddr *)&addr, sizeof(addr));
-    if(ret < 0) {
-        LOG_ERROR("Bind Port:%d error!", port_);
-        close(listenFd_);
-        return false;
+    inherited_ = inherited.size();
+    size_t used = 0;
+    auto nextListenFd = [&](bool reusePort) {
+        while(used < inherited.size()) {
+            int fd = inherited[used++];
+            if(listener_.Tune(fd)) { return fd; }  // backlog 等以本进程的配置为准
+            close(fd);
+        }
+        return listener_.Open(reusePort);
+    };
+    auto closeUnused = [&] {
+        for(; used < inherited.size(); used++) {
+            close(inherited[used]);  // 监听方式变了（子 Reactor 数量不同），多出来的不再使用
+        }
+    };
+
+    if(subReactorNum_ > 0 && reusePort_) {
+        /* 每个子 Reactor 一个 SO_REUSEPORT 监听套接字，由内核在它们之间分摊新连接 */
+        for(int i = 0; i < subReactorNum_; i++) {
+            int fd = nextListenFd(true);
+            if(fd < 0) {
+                closeUnused();
+                subReactors_.clear();
+                return false;
+            }
+            subReactors_.emplace_back(NewSubReactor_(fd));
+        }
+        closeUnused();
+        LOG_INFO("Server port:%d", port_);
+        return true;
     }
 
-    ret = listen(listenFd_, 6);  // 监听套接字，允许最多 6 个未处理的连接排队
-    if(ret < 0) {
-        LOG_ERROR("Listen port:%d error!", port_);
-        close(listenFd_);
+    listenFd_ = nextListenFd(false);
+    closeUnused();
+    if(listenFd_ < 0) {
         return false;
     }
 
-    ret = epoller_->AddFd(listenFd_,  listenEvent_ | EPOLLIN);  // 将监听套接字添加到 epoll 实例中，监听读事件
+    int ret = epoller_->AddFd(listenFd_,  listenEvent_ | EPOLLIN);  // 将监听套接字添加到 epoll 实例中，监听读事件
     if(ret == 0) {
         LOG_ERROR("Add listen error!");
         close(listenFd_);
+        listenFd_ = -1;
         return false;
     }  // 如果失败，关闭 socket 并返回 false
 
-    SetFdNonblock(listenFd_);  // 设置监听套接字为非阻塞模式
+    for(int i = 0; i < subReactorNum_; i++) {
+        subReactors_.emplace_back(NewSubReactor_(-1));
+    }  // 由主 Reactor accept 后轮询分发
     LOG_INFO("Server port:%d", port_);  // 输出监听端口信息
     return true;
 }
 
-int WebServer::SetFdNonblock(int fd) {
-    assert(fd > 0);
-    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, 0) | O_NONBLOCK);  // 设置非阻塞
+Reactor* WebServer::NewSubReactor_(int listenFd) {
+    if(uring_ && uringError_.empty()) {
+        Reactor* reactor = UringReactor::Create(listenFd, &listener_, timeoutMS_, maxFd_, timingWheel_, sqlpool_.get(),
+                                                uringOptions_, &uringError_);
+        if(reactor) { return reactor; }
+        // 内核不支持时这个和之后的子 Reactor 都退回 epoll，已创建的 io_uring 子 Reactor 照常工作
+    }
+    return new SubReactor(listenFd, &listener_, listenEvent_, connEvent_, timeoutMS_, maxFd_, maxEvents_, timingWheel_, sqlpool_.get());
 }
-
-
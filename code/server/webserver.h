@@ -9,36 +9,38 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/eventfd.h>  // eventfd()
+#include <signal.h>      // signal()
+#include <sys/signalfd.h>  // signalfd()
 
 #include "epoller.h"
+#include "subreactor.h"
+#include "uringreactor.h"
+#include "conntable.h"
+#include "handover.h"
+#include "listener.h"
 #include "../log/log.h"
 #include "../timer/heaptimer.h"
+#include "../timer/timingwheel.h"
 #include "../pool/sqlconnpool.h"
 #include "../pool/threadpool.h"
 #include "../pool/sqlconnRAII.h"
 #include "../http/httpconn.h"
+#include "../metrics/metrics.h"
+#include "../config/config.h"
 
 class WebServer {
 public:
-    WebServer(
-        int port, int trigMode, int timeoutMS, bool OptLinger, 
-        int sqlPort, const char* sqlUser, const  char* sqlPwd, 
-        const char* dbName, int connPoolNum, int threadNum,
-        bool openLog, int logLevel, int logQueSize);
-    
-    // 端口号 port
-    // 事件触发模式 trigMode（如 EPOLLLT、EPOLLET）
-    // 连接超时时间 timeoutMS
-    // 是否开启 SO_LINGER 选项 OptLinger
-    // 数据库连接信息（端口、用户名、密码、数据库名）
-    // 连接池、线程池大小
-    // 日志相关参数（是否启用、日志级别、队列大小）
+    explicit WebServer(const Config& config);
+    // 端口、触发模式、超时、数据库、线程池、日志、缓存等全部参数见 Config，
+    // 其中子 Reactor 数量为 0 时是单 Reactor + 线程池
 
     ~WebServer();
-    void Start();  // 启动服务器
+    void Start();  // 启动服务器，收到 SIGTERM/SIGINT 或被新进程接管后优雅退出时返回
 
 private:
     bool InitSocket_();   // 初始化监听套接字
+    Reactor* NewSubReactor_(int listenFd);  // 按配置创建 io_uring 或 epoll 子 Reactor
     void InitEventMode_(int trigMode);  // 初始化事件触发模式
     void AddClient_(int fd, sockaddr_in addr);  // 添加新客户端连接
   
@@ -53,24 +55,52 @@ private:
     void OnRead_(HttpConn* client);  // 处理读事件
     void OnWrite_(HttpConn* client);  // 处理写事件
     void OnProcess(HttpConn* client);  // 处理业务
+    void Verify_(HttpConn* client);  // 把登录/注册的数据库查询交给数据库线程
+    void DealVerified_();  // 处理数据库线程返回的验证结果
 
-    static const int MAX_FD = 65536;  // 最大文件描述符数量
-
-    static int SetFdNonblock(int fd);   // 设置文件描述符为非阻塞模式
+    void DealSignal_();  // 读取 signalfd
+    void DealHandover_(int fd);  // 平滑升级的控制套接字可读
+    void BeginShutdown_();  // 停止 accept，通知子 Reactor 退出
+    void CheckDrained_();  // 关闭空闲连接，全部结束或超时后让主循环退出
 
     int port_;   // 监听端口
-    bool openLinger_;   // 是否启用 SO_LINGER。
     int timeoutMS_;  /* 毫秒MS */
+    int maxFd_;  // 最大文件描述符数量，连接表的大小
+    int maxEvents_;  // 每次 epoll_wait 取回的事件数
     bool isClose_;  // 是否关闭服务器
     int listenFd_;  // 监听套接字文件描述符
+    int wakeupFd_;  // eventfd，数据库线程完成验证后唤醒主循环
+    int signalFd_;  // signalfd，SIGTERM/SIGINT 在主循环中处理
+    int shutdownTimeoutMS_;  // 优雅退出时等待进行中响应的时间
+    bool draining_;  // 已开始优雅退出
+    TimeStamp drainDeadline_;
+    int subReactorNum_;  // 子 Reactor 数量
+    bool reusePort_;  // 子 Reactor 是否各自监听
+    bool timingWheel_;  // 是否使用时间轮定时器
+    size_t nextReactor_;  // 轮询分发连接的下一个子 Reactor
+    bool uring_;  // 子 Reactor 优先使用 io_uring
+    UringReactor::Options uringOptions_;
+    std::string uringError_;  // io_uring 不可用的原因，非空时子 Reactor 已退回 epoll
+    Listener listener_;  // 监听套接字的参数，与子 Reactor 共用
     char* srcDir_;   // 服务器资源目录
     
     uint32_t listenEvent_;   // 监听事件类型
     uint32_t connEvent_;   // 连接事件类型
    
-    std::unique_ptr<HeapTimer> timer_;  // 定时器，用于管理连接超时
+    std::unique_ptr<Timer> timer_;  // 定时器，用于管理连接超时
     std::unique_ptr<ThreadPool> threadpool_;  // 线程池，用于处理请求
+    std::unique_ptr<ThreadPool> sqlpool_;  // 数据库线程，每个线程占用连接池中的一个连接
     std::unique_ptr<Epoller> epoller_;  // epoll 实例，用于事件通知
-    std::unordered_map<int, HttpConn> users_;   // 存储所有连接的用户
+    ConnTable users_;   // 以 fd 为下标的连接表
+    std::vector<std::unique_ptr<Reactor>> subReactors_;  // one loop per thread 模式下的子 Reactor
+    std::unique_ptr<Handover> handover_;  // 平滑升级，未配置时为空
+    size_t inherited_;  // 从旧进程接过来的监听套接字数
+    std::vector<std::string> warmPaths_;  // 从旧进程取回的热点路径，文件缓存初始化后预热
+
+    static const int DRAIN_TICK_MS = 100;  // 优雅退出期间检查连接的间隔
+    static const size_t HOT_PATHS = 512;  // 平滑升级时交给新进程预热的路径数
+
+    std::mutex verifyMtx_;  // 保护 verified_
+    std::vector<std::unique_ptr<VerifyTask>> verified_;  // 已完成、等待主循环处理的验证
 }; 
 #endif 
\ No newline at end of file
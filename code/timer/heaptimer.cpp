@@ -7,12 +7,11 @@
 
 void HeapTimer::siftup_(size_t i) {
     assert(i >= 0 && i < heap_.size());
-    size_t j = (i - 1) / 2;
-    while(j >= 0) {
+    while(i > 0) {
+        size_t j = (i - 1) / 2;  // size_t 的 (0 - 1) / 2 不是 -1，必须在根结点处停下
         if(heap_[j] < heap_[i]) { break; }
         SwapNode_(i, j);
         i = j;
-        j = (i - 1) / 2;
     }
 }
 
@@ -14,13 +14,9 @@
 #include <functional> 
 #include <assert.h> 
 #include <chrono>
+#include "timer.h"
 #include "../log/log.h"
 
-typedef std::function<void()> TimeoutCallBack;
-typedef std::chrono::high_resolution_clock Clock;
-typedef std::chrono::milliseconds MS;
-typedef Clock::time_point TimeStamp;
-
 struct TimerNode {
     int id;
     TimeStamp expires;
@@ -29,25 +25,25 @@ struct TimerNode {
         return expires < t.expires;
     }
 };
-class HeapTimer {
+class HeapTimer : public Timer {
 public:
     HeapTimer() { heap_.reserve(64); }
 
     ~HeapTimer() { clear(); }
     
-    void adjust(int id, int newExpires);
+    void adjust(int id, int newExpires) override;
 
-    void add(int id, int timeOut, const TimeoutCallBack& cb);
+    void add(int id, int timeOut, const TimeoutCallBack& cb) override;
 
-    void doWork(int id);
+    void doWork(int id) override;
 
-    void clear();
+    void clear() override;
 
-    void tick();
+    void tick() override;
 
     void pop();
 
-    int GetNextTick();
+    int GetNextTick() override;
 
 private:
     void del_(size_t i);
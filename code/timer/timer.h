@@ -0,0 +1,30 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <functional>
+#include <chrono>
+
+typedef std::function<void()> TimeoutCallBack;
+typedef std::chrono::high_resolution_clock Clock;
+typedef std::chrono::milliseconds MS;
+typedef Clock::time_point TimeStamp;
+
+/* 连接超时定时器接口：id 为连接的 fd，每个 id 至多一个定时器 */
+class Timer {
+public:
+    virtual ~Timer() {}
+
+    virtual void add(int id, int timeOut, const TimeoutCallBack& cb) = 0;  // 新增或重置定时器
+
+    virtual void adjust(int id, int newExpires) = 0;  // 把已有定时器的超时时间延后为 newExpires 毫秒之后
+
+    virtual void doWork(int id) = 0;  // 立即触发并删除 id 的定时器
+
+    virtual void clear() = 0;
+
+    virtual void tick() = 0;  // 触发所有已到期的定时器
+
+    virtual int GetNextTick() = 0;  // 处理到期定时器，返回距下一次到期的毫秒数，没有定时器时返回 -1
+};
+
+#endif //TIMER_H
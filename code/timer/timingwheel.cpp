@@ -0,0 +1,152 @@
+#include "timingwheel.h"
+
+TimingWheel::TimingWheel(): base_(std::chrono::steady_clock::now()), current_(0), size_(0),
+    slots_(SLOTS, -1) {
+    nodes_.reserve(1024);
+}
+
+int64_t TimingWheel::Now_() const {
+    return std::chrono::duration_cast<MS>(std::chrono::steady_clock::now() - base_).count();
+}
+
+int TimingWheel::SlotOf_(int64_t expires) const {
+    /* 按距离当前 tick 的远近选择层，槽号取到期 tick 在该层对应的位 */
+    int64_t delta = expires - current_;
+    if(delta < LEVEL0_SIZE) {
+        return expires & (LEVEL0_SIZE - 1);
+    }
+    int shift = LEVEL0_BITS;
+    for(int level = 1; level < LEVELS; level++) {
+        if(delta < (int64_t(1) << (shift + LEVELN_BITS)) || level == LEVELS - 1) {
+            return LEVEL0_SIZE + (level - 1) * LEVELN_SIZE + ((expires >> shift) & (LEVELN_SIZE - 1));
+        }
+        shift += LEVELN_BITS;
+    }
+    assert(false);
+    return -1;
+}
+
+void TimingWheel::Link_(int id) {
+    Node_& node = nodes_[id];
+    if(node.expires <= current_) {
+        node.expires = current_ + 1;  // 已经过期的放到下一个 tick 触发
+    }
+    else if(node.expires - current_ > MAX_SPAN) {
+        node.expires = current_ + MAX_SPAN;
+    }
+    int slot = SlotOf_(node.expires);
+    node.slot = slot;
+    node.prev = -1;
+    node.next = slots_[slot];
+    if(node.next >= 0) { nodes_[node.next].prev = id; }
+    slots_[slot] = id;
+}
+
+void TimingWheel::Unlink_(int id) {
+    Node_& node = nodes_[id];
+    assert(node.slot >= 0);
+    if(node.prev >= 0) { nodes_[node.prev].next = node.next; }
+    else { slots_[node.slot] = node.next; }
+    if(node.next >= 0) { nodes_[node.next].prev = node.prev; }
+    node.slot = -1;
+}
+
+void TimingWheel::add(int id, int timeout, const TimeoutCallBack& cb) {
+    assert(id >= 0);
+    if(static_cast<size_t>(id) >= nodes_.size()) {
+        nodes_.resize(id + 1, {0, -1, -1, -1, nullptr});
+    }
+    Node_& node = nodes_[id];
+    if(node.slot >= 0) {
+        Unlink_(id);
+    } else {
+        size_++;
+    }
+    node.cb = cb;
+    node.expires = Now_() + timeout;
+    Link_(id);
+}
+
+void TimingWheel::adjust(int id, int timeout) {
+    /* 只改到期时间并挪到新槽位，不碰回调 */
+    assert(static_cast<size_t>(id) < nodes_.size() && nodes_[id].slot >= 0);
+    Node_& node = nodes_[id];
+    int64_t expires = Now_() + timeout;
+    if(expires == node.expires) { return; }
+    Unlink_(id);
+    node.expires = expires;
+    Link_(id);
+}
+
+void TimingWheel::Fire_(int id) {
+    Unlink_(id);
+    size_--;
+    TimeoutCallBack cb;
+    cb.swap(nodes_[id].cb);  // 回调里可能对同一个 id 重新 add
+    cb();
+}
+
+void TimingWheel::doWork(int id) {
+    /* 删除指定id结点，并触发回调函数 */
+    if(id < 0 || static_cast<size_t>(id) >= nodes_.size() || nodes_[id].slot < 0) {
+        return;
+    }
+    Fire_(id);
+}
+
+void TimingWheel::Cascade_(int level, int index) {
+    int slot = LEVEL0_SIZE + (level - 1) * LEVELN_SIZE + index;
+    int id = slots_[slot];
+    slots_[slot] = -1;
+    while(id >= 0) {
+        int next = nodes_[id].next;
+        Link_(id);
+        id = next;
+    }
+}
+
+void TimingWheel::tick() {
+    int64_t now = Now_();
+    if(size_ == 0) {
+        current_ = now;  // 空闲时直接跳过，不逐格空转
+        return;
+    }
+    while(current_ < now) {
+        int64_t t = ++current_;
+        /* 第 0 层转完一圈：把上一层对应的槽下沉，必要时逐层向上 */
+        int shift = LEVEL0_BITS;
+        for(int level = 1; level < LEVELS && (t & ((int64_t(1) << shift) - 1)) == 0; level++) {
+            Cascade_(level, (t >> shift) & (LEVELN_SIZE - 1));
+            shift += LEVELN_BITS;
+        }
+        int slot = t & (LEVEL0_SIZE - 1);
+        int id;
+        while((id = slots_[slot]) >= 0) {
+            Fire_(id);  // 每次从链表头取，回调中增删其他结点也安全
+        }
+        if(size_ == 0) {
+            current_ = now;
+        }
+    }
+}
+
+void TimingWheel::clear() {
+    slots_.assign(SLOTS, -1);
+    nodes_.clear();
+    size_ = 0;
+}
+
+int TimingWheel::GetNextTick() {
+    tick();
+    if(size_ == 0) {
+        return -1;
+    }
+    /* 在第 0 层找最近的非空槽；遇到一圈的边界就在那时醒来处理下沉 */
+    for(int i = 1; i <= LEVEL0_SIZE; i++) {
+        int64_t t = current_ + i;
+        if(slots_[t & (LEVEL0_SIZE - 1)] >= 0 || (t & (LEVEL0_SIZE - 1)) == 0) {
+            return i;
+        }
+    }
+    return LEVEL0_SIZE;
+}
@@ -0,0 +1,62 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+#include <assert.h>
+#include "timer.h"
+
+/* 分层时间轮：精度 1ms，第 0 层 256 个槽，其余 3 层各 64 个槽，最长约 18.6 小时。
+   定时器结点按 id(fd) 存放在平坦数组里，槽位是结点间的侵入式双向链表，
+   add/adjust/doWork 都是 O(1)，到期时整槽批量触发，高层槽在低层转完一圈时下沉 */
+class TimingWheel : public Timer {
+public:
+    TimingWheel();
+
+    ~TimingWheel() { clear(); }
+
+    void adjust(int id, int newExpires) override;
+
+    void add(int id, int timeOut, const TimeoutCallBack& cb) override;
+
+    void doWork(int id) override;
+
+    void clear() override;
+
+    void tick() override;
+
+    int GetNextTick() override;
+
+private:
+    static constexpr int LEVEL0_BITS = 8;
+    static constexpr int LEVELN_BITS = 6;
+    static constexpr int LEVELS = 4;
+    static constexpr int LEVEL0_SIZE = 1 << LEVEL0_BITS;
+    static constexpr int LEVELN_SIZE = 1 << LEVELN_BITS;
+    static constexpr int SLOTS = LEVEL0_SIZE + (LEVELS - 1) * LEVELN_SIZE;
+    static constexpr int64_t MAX_SPAN = (int64_t(1) << (LEVEL0_BITS + (LEVELS - 1) * LEVELN_BITS)) - 1;
+
+    struct Node_ {
+        int64_t expires;  // 到期的 tick
+        int slot;         // 所在槽位，-1 表示没有定时器
+        int prev;
+        int next;
+        TimeoutCallBack cb;
+    };
+
+    int64_t Now_() const;  // 距创建时的毫秒数
+    int SlotOf_(int64_t expires) const;
+    void Link_(int id);
+    void Unlink_(int id);
+    void Cascade_(int level, int index);  // 把高层一个槽的结点重新放回低层
+    void Fire_(int id);
+
+    std::chrono::steady_clock::time_point base_;
+    int64_t current_;  // 已经处理到的 tick
+    size_t size_;  // 活跃定时器数
+    std::vector<int> slots_;  // 每个槽的链表头
+    std::vector<Node_> nodes_;  // 以 id 为下标
+};
+
+#endif //TIMING_WHEEL_H
@@ -0,0 +1,73 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+/* HDR 风格的延迟直方图：按 2 的幂分段，每段再线性分成 64 格，
+   相对误差不超过 1/64，记录是 O(1) 的数组自增，线程各自记录后合并 */
+class Histogram {
+public:
+    Histogram(): counts_(BUCKETS * HALF + HALF, 0), total_(0), max_(0), sum_(0) {}
+
+    void Record(uint64_t value) {
+        counts_[IndexOf_(value)]++;
+        total_++;
+        sum_ += value;
+        max_ = std::max(max_, value);
+    }
+
+    void Merge(const Histogram& other) {
+        for(size_t i = 0; i < counts_.size(); i++) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t Percentile(double p) const {
+        /* 返回满足 p% 记录不大于它的最小桶上界 */
+        if(total_ == 0) { return 0; }
+        uint64_t rank = static_cast<uint64_t>(p / 100.0 * total_ + 0.5);
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for(size_t i = 0; i < counts_.size(); i++) {
+            seen += counts_[i];
+            if(seen >= rank) {
+                return std::min(HighestOf_(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    uint64_t Count() const { return total_; }
+    uint64_t Max() const { return max_; }
+    double Mean() const { return total_ ? static_cast<double>(sum_) / total_ : 0; }
+
+private:
+    static const int SUB_BITS = 7;  // 每段 128 个值，后一半与前一段不重叠
+    static const int HALF = 1 << (SUB_BITS - 1);
+    static const int BUCKETS = 64 - SUB_BITS + 1;
+
+    static size_t IndexOf_(uint64_t value) {
+        int msb = value ? 63 - __builtin_clzll(value) : 0;
+        int bucket = std::max(0, msb - (SUB_BITS - 1));
+        return static_cast<size_t>(bucket) * HALF + (value >> bucket);
+    }
+
+    static uint64_t HighestOf_(size_t index) {
+        int bucket = std::max<int>(0, static_cast<int>(index / HALF) - 1);
+        uint64_t sub = index - static_cast<size_t>(bucket) * HALF;
+        return ((sub + 1) << bucket) - 1;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t total_;
+    uint64_t max_;
+    uint64_t sum_;
+};
+
+#endif //HISTOGRAM_H
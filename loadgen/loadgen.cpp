@@ -0,0 +1,583 @@
+/*
+ * 压测客户端：每个线程一个 epoll，非阻塞连接，支持开环定速（按计划发送时间计算延迟，
+ * 不受服务器变慢时客户端跟着变慢的影响）和闭环两种方式，输出 p50/p99/p999 延迟。
+ *
+ * 用法: loadgen [选项] http://host:port/path
+ *   -s 场景      static(每个请求一条新连接) | keepalive | login(POST /login.html) | slow
+ *   -t 线程数    默认 4
+ *   -c 连接数    默认 64（所有线程合计）
+ *   -d 秒数      默认 10
+ *   -r 请求/秒   总速率，0 表示闭环（每条连接收到响应立刻发下一个），默认 0
+ *   -P 深度      keepalive/login 场景下每条连接同时在途的请求数（流水线），默认 1
+ *   -S 连接数    slow 场景下慢速客户端的数量，默认 16
+ *   -i 毫秒      慢速客户端每隔多久发送一个字节，默认 100
+ *   -u 用户:密码  login 场景的表单，默认 admin:admin
+ *   -T 毫秒      请求超时，默认 5000
+ */
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "histogram.h"
+
+enum SCENARIO { STATIC, KEEPALIVE, LOGIN, SLOW };
+
+struct Options {
+    SCENARIO scenario = KEEPALIVE;
+    std::string host = "127.0.0.1";
+    std::string port = "1316";
+    std::string path = "/";
+    std::string user = "admin";
+    std::string pwd = "admin";
+    int threads = 4;
+    int conns = 64;
+    int duration = 10;
+    double rate = 0;
+    int pipeline = 1;
+    int slowConns = 16;
+    int slowIntervalMS = 100;
+    int timeoutMS = 5000;
+};
+
+struct Stats {
+    Histogram latency;  // 微秒
+    uint64_t requests = 0;
+    uint64_t bytes = 0;
+    uint64_t connectErrors = 0;
+    uint64_t ioErrors = 0;  // 响应未收完连接就断开
+    uint64_t badStatus = 0;  // 非 2xx/3xx
+    uint64_t timeouts = 0;
+    uint64_t slowDone = 0;  // 慢速客户端完成的请求
+    uint64_t backlog = 0;  // 开环模式下结束时仍未发出的计划请求
+
+    void Merge(const Stats& other) {
+        latency.Merge(other.latency);
+        requests += other.requests;
+        bytes += other.bytes;
+        connectErrors += other.connectErrors;
+        ioErrors += other.ioErrors;
+        badStatus += other.badStatus;
+        timeouts += other.timeouts;
+        slowDone += other.slowDone;
+        backlog += other.backlog;
+    }
+};
+
+static int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Worker {
+public:
+    Worker(const Options& opt, const sockaddr_storage& addr, socklen_t addrLen,
+           int conns, int slowConns, double rate);
+    ~Worker();
+
+    void Run(int64_t endNs);
+    const Stats& GetStats() const { return stats_; }
+
+private:
+    struct Conn_ {
+        int fd = -1;
+        bool connecting = false;
+        bool slow = false;
+        bool ready = false;  // 是否在 ready_ 队列中
+        uint32_t events = 0;  // 当前在 epoll 中注册的事件
+        std::string out;  // 待发送
+        size_t outOff = 0;
+        size_t slowSent = 0;  // 慢速客户端已发出的请求字节
+        int64_t nextByteNs = 0;
+        std::string in;  // 未解析的响应字节
+        std::deque<int64_t> inflight;  // 每个在途请求的计划发送时间
+        bool inBody = false;
+        bool untilClose = false;  // 没有 Content-Length，读到连接关闭为止
+        size_t bodyLeft = 0;
+        int status = 0;
+        int64_t lastActive = 0;
+    };
+
+    void Open_(Conn_& conn);
+    void Close_(Conn_& conn);
+    void Fail_(Conn_& conn, uint64_t& counter);  // 在途请求计入 counter，关闭连接
+    void Update_(Conn_& conn);  // 按是否有待发送数据调整 epoll 事件
+    void MarkReady_(size_t index);
+    bool CanSend_(const Conn_& conn) const;
+    void Dispatch_(int64_t now);
+    void Send_(Conn_& conn, int64_t start);
+    void Flush_(Conn_& conn);
+    void OnReadable_(Conn_& conn);
+    bool Parse_(Conn_& conn, bool eof);  // 解析完整的响应，返回连接是否还能继续用
+    void Complete_(Conn_& conn);
+    void TickSlow_(int64_t now);
+    void CheckTimeout_(int64_t now);
+
+    const Options& opt_;
+    sockaddr_storage addr_;
+    socklen_t addrLen_;
+    std::string request_;
+    int64_t intervalNs_;  // 开环模式下相邻两个计划请求的间隔，0 表示闭环
+    int64_t nextStart_;
+    int epfd_;
+    bool stopping_;
+    std::vector<Conn_> conns_;
+    std::deque<size_t> ready_;  // 可以发送下一个请求的连接
+    std::deque<int64_t> pending_;  // 已到计划时间但还没有空闲连接的请求
+    Stats stats_;
+};
+
+Worker::Worker(const Options& opt, const sockaddr_storage& addr, socklen_t addrLen,
+               int conns, int slowConns, double rate):
+        opt_(opt), addr_(addr), addrLen_(addrLen), nextStart_(0), stopping_(false) {
+    std::string host = "Host: " + opt.host + ":" + opt.port + "\r\n";
+    if(opt.scenario == LOGIN) {
+        std::string body = "username=" + opt.user + "&password=" + opt.pwd;
+        request_ = "POST /login.html HTTP/1.1\r\n" + host + "Connection: keep-alive\r\n"
+                   "Content-Type: application/x-www-form-urlencoded\r\n"
+                   "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    } else {
+        request_ = "GET " + opt.path + " HTTP/1.1\r\n" + host +
+                   (opt.scenario == STATIC ? "Connection: close\r\n\r\n" : "Connection: keep-alive\r\n\r\n");
+    }
+    intervalNs_ = rate > 0 ? static_cast<int64_t>(1e9 / rate) : 0;
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    conns_.resize(conns + slowConns);
+    for(int i = 0; i < conns + slowConns; i++) {
+        conns_[i].slow = i >= conns;
+        if(!conns_[i].slow) { MarkReady_(i); }  // 首次发送时再建立连接
+    }
+}
+
+Worker::~Worker() {
+    for(auto& conn: conns_) { Close_(conn); }
+    close(epfd_);
+}
+
+void Worker::Open_(Conn_& conn) {
+    conn.fd = socket(addr_.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(conn.fd < 0) {
+        stats_.connectErrors++;
+        return;
+    }
+    int one = 1;
+    setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int ret = connect(conn.fd, reinterpret_cast<sockaddr*>(&addr_), addrLen_);
+    if(ret < 0 && errno != EINPROGRESS) {
+        stats_.connectErrors++;
+        close(conn.fd);
+        conn.fd = -1;
+        return;
+    }
+    conn.connecting = ret < 0;
+    conn.out.clear();
+    conn.outOff = conn.slowSent = 0;
+    conn.in.clear();
+    conn.inBody = conn.untilClose = false;
+    conn.lastActive = NowNs();
+    conn.events = EPOLLIN | EPOLLOUT;
+    epoll_event ev = {};
+    ev.events = conn.events;
+    ev.data.u64 = &conn - conns_.data();
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, conn.fd, &ev);
+}
+
+void Worker::Close_(Conn_& conn) {
+    if(conn.fd >= 0) {
+        close(conn.fd);  // close 会自动从 epoll 中移除
+        conn.fd = -1;
+    }
+    conn.connecting = false;
+    conn.inflight.clear();
+}
+
+void Worker::Fail_(Conn_& conn, uint64_t& counter) {
+    counter += conn.inflight.size();
+    Close_(conn);
+    if(!conn.slow) { MarkReady_(&conn - conns_.data()); }
+}
+
+void Worker::Update_(Conn_& conn) {
+    uint32_t events = EPOLLIN;
+    if(conn.connecting || conn.outOff < conn.out.size()) { events |= EPOLLOUT; }
+    if(events != conn.events) {
+        conn.events = events;
+        epoll_event ev = {};
+        ev.events = events;
+        ev.data.u64 = &conn - conns_.data();
+        epoll_ctl(epfd_, EPOLL_CTL_MOD, conn.fd, &ev);
+    }
+}
+
+void Worker::MarkReady_(size_t index) {
+    Conn_& conn = conns_[index];
+    if(!conn.ready && !stopping_) {
+        conn.ready = true;
+        ready_.push_back(index);
+    }
+}
+
+bool Worker::CanSend_(const Conn_& conn) const {
+    if(conn.fd < 0) { return true; }
+    return opt_.scenario != STATIC && conn.inflight.size() < static_cast<size_t>(opt_.pipeline);
+}
+
+void Worker::Dispatch_(int64_t now) {
+    if(intervalNs_ > 0) {
+        while(nextStart_ <= now) {
+            pending_.push_back(nextStart_);  // 开环：到了计划时间就记下，不管有没有空闲连接
+            nextStart_ += intervalNs_;
+        }
+    }
+    while(!ready_.empty() && (intervalNs_ == 0 || !pending_.empty())) {
+        size_t index = ready_.front();
+        ready_.pop_front();
+        Conn_& conn = conns_[index];
+        conn.ready = false;
+        if(!CanSend_(conn)) { continue; }
+        int64_t start = now;
+        if(intervalNs_ > 0) {
+            start = pending_.front();
+            pending_.pop_front();
+        }
+        Send_(conn, start);
+        if(conn.fd >= 0 && CanSend_(conn)) { MarkReady_(index); }  // 流水线还有空位
+    }
+}
+
+void Worker::Send_(Conn_& conn, int64_t start) {
+    if(conn.fd < 0) {
+        Open_(conn);
+        if(conn.fd < 0) {
+            return;  // 连接失败，CheckTimeout_ 稍后重新放回 ready_
+        }
+    }
+    if(conn.outOff == conn.out.size()) {
+        conn.out.clear();
+        conn.outOff = 0;
+    }
+    conn.out += request_;
+    conn.inflight.push_back(start);
+    if(!conn.connecting) { Flush_(conn); }
+}
+
+void Worker::Flush_(Conn_& conn) {
+    while(conn.outOff < conn.out.size()) {
+        ssize_t len = send(conn.fd, conn.out.data() + conn.outOff, conn.out.size() - conn.outOff, MSG_NOSIGNAL);
+        if(len < 0) {
+            if(errno == EAGAIN) { break; }
+            Fail_(conn, stats_.ioErrors);
+            return;
+        }
+        conn.outOff += len;
+    }
+    Update_(conn);
+}
+
+void Worker::OnReadable_(Conn_& conn) {
+    char buff[65536];
+    while(conn.fd >= 0) {
+        ssize_t len = recv(conn.fd, buff, sizeof(buff), 0);
+        if(len > 0) {
+            stats_.bytes += len;
+            conn.lastActive = NowNs();
+            conn.in.append(buff, len);
+            if(!Parse_(conn, false)) { return; }
+            continue;
+        }
+        if(len < 0 && errno == EAGAIN) { return; }
+        /* 对端关闭或出错 */
+        if(len == 0) { Parse_(conn, true); }
+        if(conn.fd >= 0) { Fail_(conn, stats_.ioErrors); }
+        return;
+    }
+}
+
+static bool HeaderValue(const std::string& head, const char* key, std::string& value) {
+    /* 在响应头里按不区分大小写查找 key */
+    size_t keyLen = strlen(key);
+    size_t pos = head.find("\r\n");
+    while(pos != std::string::npos && pos + 2 < head.size()) {
+        size_t line = pos + 2;
+        size_t end = head.find("\r\n", line);
+        if(end == std::string::npos) { end = head.size(); }
+        if(end - line > keyLen && head[line + keyLen] == ':' && strncasecmp(head.data() + line, key, keyLen) == 0) {
+            size_t val = line + keyLen + 1;
+            while(val < end && head[val] == ' ') { val++; }
+            value.assign(head, val, end - val);
+            return true;
+        }
+        pos = end;
+    }
+    return false;
+}
+
+bool Worker::Parse_(Conn_& conn, bool eof) {
+    while(true) {
+        if(!conn.inBody) {
+            size_t pos = conn.in.find("\r\n\r\n");
+            if(pos == std::string::npos) { return true; }
+            std::string head = conn.in.substr(0, pos);
+            conn.in.erase(0, pos + 4);
+            conn.status = head.size() > 12 ? atoi(head.c_str() + 9) : 0;
+            std::string value;
+            conn.untilClose = !HeaderValue(head, "Content-Length", value);
+            conn.bodyLeft = conn.untilClose ? 0 : strtoull(value.c_str(), nullptr, 10);
+            conn.inBody = true;
+        }
+        if(conn.untilClose) {
+            conn.in.clear();
+            if(!eof) { return true; }
+            Complete_(conn);
+            Close_(conn);
+            if(!conn.slow) { MarkReady_(&conn - conns_.data()); }
+            return false;
+        }
+        if(conn.in.size() < conn.bodyLeft) {
+            conn.bodyLeft -= conn.in.size();
+            conn.in.clear();
+            return true;
+        }
+        conn.in.erase(0, conn.bodyLeft);
+        conn.inBody = false;
+        Complete_(conn);
+        if(opt_.scenario == STATIC) {
+            Close_(conn);  // 短连接：每个请求一条新连接
+            MarkReady_(&conn - conns_.data());
+            return false;
+        }
+        if(conn.slow) {
+            conn.slowSent = 0;  // 慢速客户端：重新开始一个字节一个字节地发
+            conn.out.clear();
+            conn.outOff = 0;
+        } else {
+            MarkReady_(&conn - conns_.data());
+        }
+        if(conn.in.empty()) { return true; }
+    }
+}
+
+void Worker::Complete_(Conn_& conn) {
+    if(conn.inflight.empty()) { return; }  // 服务器主动发来的多余响应
+    int64_t start = conn.inflight.front();
+    conn.inflight.pop_front();
+    if(conn.slow) {
+        stats_.slowDone++;
+        return;
+    }
+    stats_.requests++;
+    if(conn.status < 200 || conn.status >= 400) { stats_.badStatus++; }
+    stats_.latency.Record(static_cast<uint64_t>(std::max<int64_t>(NowNs() - start, 0) / 1000));
+}
+
+void Worker::TickSlow_(int64_t now) {
+    for(auto& conn: conns_) {
+        if(!conn.slow || stopping_) { continue; }
+        if(conn.fd < 0) {
+            Open_(conn);
+            conn.nextByteNs = now;
+            continue;
+        }
+        if(conn.connecting || conn.slowSent >= request_.size() || now < conn.nextByteNs) { continue; }
+        if(conn.slowSent == 0) { conn.inflight.push_back(now); }
+        conn.out.assign(1, request_[conn.slowSent++]);  // 每次只发一个字节
+        conn.outOff = 0;
+        conn.nextByteNs = now + static_cast<int64_t>(opt_.slowIntervalMS) * 1000000;
+        conn.lastActive = now;
+        Flush_(conn);
+    }
+}
+
+void Worker::CheckTimeout_(int64_t now) {
+    int64_t limit = static_cast<int64_t>(opt_.timeoutMS) * 1000000;
+    for(auto& conn: conns_) {
+        if(conn.fd >= 0 && !conn.inflight.empty() && now - conn.lastActive > limit) {
+            Fail_(conn, stats_.timeouts);
+        }
+        else if(conn.fd < 0 && !conn.slow) {
+            MarkReady_(&conn - conns_.data());  // 之前建立连接失败的，重试
+        }
+    }
+}
+
+void Worker::Run(int64_t endNs) {
+    epoll_event events[256];
+    if(opt_.scenario != STATIC) {
+        for(auto& conn: conns_) {
+            if(!conn.slow) { Open_(conn); }  // 长连接场景先建好连接，不把握手算进第一批请求
+        }
+    }
+    nextStart_ = NowNs();
+    int64_t lastCheck = nextStart_;
+    while(true) {
+        int64_t now = NowNs();
+        if(now >= endNs) { break; }
+        Dispatch_(now);
+        if(opt_.scenario == SLOW) { TickSlow_(now); }
+        if(now - lastCheck > 100000000) {
+            CheckTimeout_(now);
+            lastCheck = now;
+        }
+
+        int64_t waitNs = std::min<int64_t>(endNs - now, 100000000);
+        if(intervalNs_ > 0) { waitNs = std::min(waitNs, nextStart_ - now); }
+        if(opt_.scenario == SLOW) { waitNs = std::min<int64_t>(waitNs, opt_.slowIntervalMS * 1000000LL); }
+        int timeout = static_cast<int>((std::max<int64_t>(waitNs, 0) + 999999) / 1000000);  // 向上取整，避免空转
+        int n = epoll_wait(epfd_, events, 256, timeout);
+        for(int i = 0; i < n; i++) {
+            Conn_& conn = conns_[events[i].data.u64];
+            if(conn.fd < 0) { continue; }
+            if(conn.connecting && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if(err) {
+                    stats_.connectErrors++;
+                    conn.inflight.clear();
+                    Fail_(conn, stats_.ioErrors);
+                    continue;
+                }
+                conn.connecting = false;
+            }
+            if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                OnReadable_(conn);
+            }
+            if(conn.fd >= 0 && (events[i].events & EPOLLOUT)) {
+                Flush_(conn);
+            }
+        }
+    }
+    stopping_ = true;
+    stats_.backlog = pending_.size();
+}
+
+static void Usage(const char* name) {
+    fprintf(stderr, "usage: %s [-s static|keepalive|login|slow] [-t threads] [-c conns] [-d seconds]\n"
+                    "       [-r req/s] [-P pipeline] [-S slow conns] [-i slow interval ms]\n"
+                    "       [-u user:pwd] [-T timeout ms] http://host:port/path\n", name);
+    exit(2);
+}
+
+static bool ParseUrl(const char* url, Options& opt) {
+    std::string s(url);
+    if(s.compare(0, 7, "http://") == 0) { s = s.substr(7); }
+    size_t slash = s.find('/');
+    if(slash != std::string::npos) {
+        opt.path = s.substr(slash);
+        s.resize(slash);
+    }
+    size_t colon = s.rfind(':');
+    if(colon != std::string::npos) {
+        opt.port = s.substr(colon + 1);
+        s.resize(colon);
+    }
+    opt.host = s;
+    return !opt.host.empty() && !opt.port.empty();
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    int ch;
+    while((ch = getopt(argc, argv, "s:t:c:d:r:P:S:i:u:T:h")) != -1) {
+        switch(ch) {
+        case 's':
+            if(strcmp(optarg, "static") == 0) { opt.scenario = STATIC; }
+            else if(strcmp(optarg, "keepalive") == 0) { opt.scenario = KEEPALIVE; }
+            else if(strcmp(optarg, "login") == 0) { opt.scenario = LOGIN; }
+            else if(strcmp(optarg, "slow") == 0) { opt.scenario = SLOW; }
+            else { Usage(argv[0]); }
+            break;
+        case 't': opt.threads = atoi(optarg); break;
+        case 'c': opt.conns = atoi(optarg); break;
+        case 'd': opt.duration = atoi(optarg); break;
+        case 'r': opt.rate = atof(optarg); break;
+        case 'P': opt.pipeline = atoi(optarg); break;
+        case 'S': opt.slowConns = atoi(optarg); break;
+        case 'i': opt.slowIntervalMS = atoi(optarg); break;
+        case 'u': {
+            const char* colon = strchr(optarg, ':');
+            if(!colon) { Usage(argv[0]); }
+            opt.user.assign(optarg, colon - optarg);
+            opt.pwd = colon + 1;
+            break;
+        }
+        case 'T': opt.timeoutMS = atoi(optarg); break;
+        default: Usage(argv[0]);
+        }
+    }
+    if(optind != argc - 1 || !ParseUrl(argv[optind], opt) || opt.threads <= 0
+            || opt.conns < opt.threads || opt.duration <= 0 || opt.pipeline <= 0 || opt.rate < 0) {
+        Usage(argv[0]);
+    }
+    if(opt.scenario != SLOW) { opt.slowConns = 0; }
+    signal(SIGPIPE, SIG_IGN);
+
+    addrinfo hints = {}, *res = nullptr;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(opt.host.c_str(), opt.port.c_str(), &hints, &res) != 0 || !res) {
+        fprintf(stderr, "cannot resolve %s:%s\n", opt.host.c_str(), opt.port.c_str());
+        return 1;
+    }
+    sockaddr_storage addr = {};
+    memcpy(&addr, res->ai_addr, res->ai_addrlen);
+    socklen_t addrLen = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    static const char* NAMES[] = { "static", "keepalive", "login", "slow" };
+    printf("%s http://%s:%s%s: %d threads, %d connections, %ds, %s",
+           NAMES[opt.scenario], opt.host.c_str(), opt.port.c_str(),
+           opt.scenario == LOGIN ? "/login.html" : opt.path.c_str(),
+           opt.threads, opt.conns, opt.duration, opt.rate > 0 ? "open loop " : "closed loop");
+    if(opt.rate > 0) { printf("%.0f req/s", opt.rate); }
+    if(opt.pipeline > 1) { printf(", pipeline %d", opt.pipeline); }
+    if(opt.slowConns > 0) { printf(", %d slow clients (1 byte / %dms)", opt.slowConns, opt.slowIntervalMS); }
+    printf("\n");
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for(int i = 0; i < opt.threads; i++) {
+        /* 连接数和速率平均分给各线程 */
+        int conns = opt.conns / opt.threads + (i < opt.conns % opt.threads);
+        int slow = opt.slowConns / opt.threads + (i < opt.slowConns % opt.threads);
+        workers.emplace_back(new Worker(opt, addr, addrLen, conns, slow, opt.rate / opt.threads));
+    }
+    int64_t start = NowNs();
+    int64_t end = start + static_cast<int64_t>(opt.duration) * 1000000000;
+    std::vector<std::thread> threads;
+    for(auto& worker: workers) {
+        threads.emplace_back(&Worker::Run, worker.get(), end);
+    }
+    for(auto& t: threads) { t.join(); }
+    double seconds = (NowNs() - start) / 1e9;
+
+    Stats total;
+    for(auto& worker: workers) { total.Merge(worker->GetStats()); }
+    printf("requests: %lu (%.1f req/s), transfer: %.2f MB/s\n", total.requests,
+           total.requests / seconds, total.bytes / seconds / (1 << 20));
+    printf("errors: connect %lu, read/write %lu, timeout %lu, status %lu",
+           total.connectErrors, total.ioErrors, total.timeouts, total.badStatus);
+    if(opt.rate > 0) { printf(", unsent backlog %lu", total.backlog); }
+    printf("\n");
+    if(opt.slowConns > 0) { printf("slow client requests: %lu\n", total.slowDone); }
+    const Histogram& h = total.latency;
+    printf("latency(us): mean %.0f, p50 %lu, p90 %lu, p99 %lu, p999 %lu, max %lu\n",
+           h.Mean(), h.Percentile(50), h.Percentile(90), h.Percentile(99), h.Percentile(99.9), h.Max());
+    return 0;
+}
@@ -0,0 +1,763 @@
+/*
+ * 微基准测试：./bench [parser|buffer|threadpool|log|timer|response|metrics|eventloop|accept]，不带参数时全部运行。
+ * 行为检查在 test.cpp；这里只核对新旧实现的结果一致，不一致时以非零状态退出
+ */
+#include "../code/log/log.h"
+#include "../code/buffer/buffer.h"
+#include "../code/buffer/chainbuffer.h"
+#include "../code/http/httprequest.h"
+#include "../code/http/httpresponse.h"
+#include "../code/pool/threadpool.h"
+#include "../code/timer/heaptimer.h"
+#include "../code/timer/timingwheel.h"
+#include "../code/metrics/metrics.h"
+#include "../code/server/webserver.h"
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <chrono>
+#include <queue>
+#include <functional>
+#include <regex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+typedef std::chrono::steady_clock BenchClock;
+
+static bool failed = false;  // 对照结果不一致，main 返回非零
+
+static double ElapsedNs(BenchClock::time_point start) {
+    return std::chrono::duration<double, std::nano>(BenchClock::now() - start).count();
+}
+
+/* 旧版基于 std::regex 的解析流程，只用于对照结果和耗时 */
+struct LegacyRequest {
+    std::string method, path, version;
+    std::unordered_map<std::string, std::string> header;
+    bool keepAlive;
+};
+
+static bool LegacyParse(Buffer& buff, LegacyRequest& req) {
+    const char CRLF[] = "\r\n";
+    int state = 0;
+    req = LegacyRequest();
+    while(buff.ReadableBytes() && state != 3) {
+        const char* lineEnd = std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
+        std::string line(buff.Peek(), lineEnd);
+        if(state == 0) {
+            std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
+            std::smatch subMatch;
+            if(!std::regex_match(line, subMatch, patten)) { return false; }
+            req.method = subMatch[1];
+            req.path = subMatch[2];
+            req.version = subMatch[3];
+            state = 1;
+        } else if(state == 1) {
+            std::regex patten("^([^:]*): ?(.*)$");
+            std::smatch subMatch;
+            if(std::regex_match(line, subMatch, patten)) {
+                req.header[subMatch[1]] = subMatch[2];
+            } else {
+                state = 2;
+            }
+            if(buff.ReadableBytes() <= 2) { state = 3; }
+        }
+        if(lineEnd == buff.BeginWrite()) { break; }
+        buff.RetrieveUntil(lineEnd + 2);
+    }
+    req.keepAlive = req.header.count("Connection") == 1
+                    && req.header["Connection"] == "keep-alive" && req.version == "1.1";
+    return true;
+}
+
+void BenchParser() {
+    const std::vector<std::string> corpus = {
+        "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1:1316\r\nConnection: keep-alive\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64)\r\nAccept: text/html,application/xhtml+xml\r\n"
+        "Accept-Encoding: gzip, deflate\r\nAccept-Language: zh-CN,zh;q=0.9\r\n\r\n",
+        "GET /css/bootstrap.min.css HTTP/1.1\r\nHost: 127.0.0.1:1316\r\nConnection: keep-alive\r\n"
+        "Accept: text/css,*/*;q=0.1\r\nReferer: http://127.0.0.1:1316/\r\n\r\n",
+        "GET /video.html HTTP/1.0\r\nHost: 127.0.0.1\r\nUser-Agent: WebBench 1.5\r\n\r\n",
+        "GET /images/profile-image.jpg HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n",
+    };
+    const int rounds = 20000;
+    Buffer buff;
+    HttpRequest request;
+    LegacyRequest legacy;
+
+    /* 先逐条核对新旧解析结果 */
+    for(const auto& req: corpus) {
+        buff.RetrieveAll();
+        buff.Append(req);
+        LegacyParse(buff, legacy);
+        buff.RetrieveAll();
+        buff.Append(req);
+        HttpRequest::HTTP_CODE ret = request.parse(buff);
+        std::string expectPath = legacy.path == "/" ? "/index.html" : legacy.path;
+        if(ret != HttpRequest::GET_REQUEST || request.method() != legacy.method
+                || request.path() != expectPath || request.version() != legacy.version
+                || request.IsKeepAlive() != legacy.keepAlive) {
+            printf("[parser] MISMATCH: %s\n", req.substr(0, req.find('\r')).c_str());
+            failed = true;
+            return;
+        }
+    }
+
+    BenchClock::time_point start = BenchClock::now();
+    for(int i = 0; i < rounds; i++) {
+        const std::string& req = corpus[i % corpus.size()];
+        buff.RetrieveAll();
+        buff.Append(req);
+        LegacyParse(buff, legacy);
+    }
+    double legacyNs = ElapsedNs(start) / rounds;
+
+    start = BenchClock::now();
+    for(int i = 0; i < rounds; i++) {
+        const std::string& req = corpus[i % corpus.size()];
+        buff.RetrieveAll();
+        buff.Append(req);
+        request.parse(buff);
+    }
+    double parserNs = ElapsedNs(start) / rounds;
+
+    /* 逐字节到达：验证断点续扫没有退化成重复扫描 */
+    const std::string& req = corpus[0];
+    start = BenchClock::now();
+    for(int i = 0; i < rounds / 10; i++) {
+        buff.RetrieveAll();
+        for(size_t j = 0; j < req.size(); j++) {
+            buff.Append(&req[j], 1);
+            request.parse(buff);
+        }
+    }
+    double byteNs = ElapsedNs(start) / (rounds / 10);
+
+    printf("[parser] regex: %.0f ns/req, state machine: %.0f ns/req (x%.1f), "
+           "byte-by-byte: %.0f ns/req\n", legacyNs, parserNs, legacyNs / parserNs, byteNs);
+}
+
+/* 旧版缓冲区：vector 存储、atomic 下标、RetrieveAll 清零、按需 resize */
+class LegacyBuffer {
+public:
+    LegacyBuffer(): buffer_(1024), readPos_(0), writePos_(0) {}
+    size_t ReadableBytes() const { return writePos_ - readPos_; }
+    size_t WritableBytes() const { return buffer_.size() - writePos_; }
+    const char* Peek() const { return &buffer_[0] + readPos_; }
+    void Retrieve(size_t len) { readPos_ += len; }
+    void RetrieveAll() {
+        bzero(&buffer_[0], buffer_.size());
+        readPos_ = 0;
+        writePos_ = 0;
+    }
+    void Append(const char* str, size_t len) {
+        if(WritableBytes() < len) { MakeSpace_(len); }
+        std::copy(str, str + len, &buffer_[0] + writePos_);
+        writePos_ += len;
+    }
+    ssize_t ReadFd(int fd, int* saveErrno) {
+        char buff[65535];
+        struct iovec iov[2];
+        const size_t writable = WritableBytes();
+        iov[0].iov_base = &buffer_[0] + writePos_;
+        iov[0].iov_len = writable;
+        iov[1].iov_base = buff;
+        iov[1].iov_len = sizeof(buff);
+        const ssize_t len = readv(fd, iov, 2);
+        if(len < 0) { *saveErrno = errno; return len; }
+        if(static_cast<size_t>(len) <= writable) {
+            writePos_ += len;
+        } else {
+            writePos_ = buffer_.size();
+            Append(buff, len - writable);
+        }
+        return len;
+    }
+
+private:
+    void MakeSpace_(size_t len) {
+        if(WritableBytes() + readPos_ < len) {
+            buffer_.resize(writePos_ + len + 1);
+        } else {
+            size_t readable = ReadableBytes();
+            std::copy(&buffer_[0] + readPos_, &buffer_[0] + writePos_, &buffer_[0]);
+            readPos_ = 0;
+            writePos_ = readable;
+        }
+    }
+
+    std::vector<char> buffer_;
+    std::atomic<size_t> readPos_;
+    std::atomic<size_t> writePos_;
+};
+
+/* 一个请求周期：ReadFd 读入请求 → 分几次 Retrieve → Append 响应头 → 整体重置；
+   每 conns 个请求换一批连接，模拟短连接的缓冲区创建和销毁 */
+template<class BUFFER, class IDLE>
+static double RunBuffer(int fds[2], const std::string& req, const std::string& head,
+                        int requests, int reqPerConn, IDLE idle) {
+    BenchClock::time_point start = BenchClock::now();
+    for(int i = 0; i < requests; i += reqPerConn) {
+        BUFFER readBuff, writeBuff;
+        for(int j = 0; j < reqPerConn; j++) {
+            if(write(fds[0], req.data(), req.size()) != (ssize_t)req.size()) { return 0; }
+            int err = 0;
+            readBuff.ReadFd(fds[1], &err);
+            while(readBuff.ReadableBytes() > 0) {
+                readBuff.Retrieve(std::min<size_t>(readBuff.ReadableBytes(), 256));
+            }
+            writeBuff.Append(head.data(), head.size());
+            writeBuff.Retrieve(writeBuff.ReadableBytes());
+            writeBuff.RetrieveAll();
+            readBuff.RetrieveAll();
+            idle(readBuff, writeBuff);
+        }
+    }
+    return ElapsedNs(start) / requests;
+}
+
+void BenchBuffer() {
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) { return; }
+    const std::string head = "HTTP/1.1 200 OK\r\nConnection: keep-alive\r\nkeep-alive: max=6, timeout=120\r\n"
+                             "Content-type: text/html\r\nContent-length: 3059\r\n\r\n";
+    const int requests = 200000;
+    for(size_t reqLen: {512, 4096, 32768}) {
+        std::string req(reqLen, 'x');
+        for(int reqPerConn: {1, 100}) {
+            double legacy = RunBuffer<LegacyBuffer>(fds, req, head, requests, reqPerConn,
+                                                    [](LegacyBuffer&, LegacyBuffer&) {});
+            double pooled = RunBuffer<Buffer>(fds, req, head, requests, reqPerConn,
+                                              [](Buffer& r, Buffer& w) { r.Release(); w.Release(); });
+            printf("[buffer] %5zu-byte request, %3d req/conn: vector %.0f ns/req, pooled %.0f ns/req (x%.2f)\n",
+                   reqLen, reqPerConn, legacy, pooled, legacy / pooled);
+        }
+    }
+    BufferPool::Stats stats = BufferPool::Instance()->GetStats();
+    printf("[buffer] pool: %zu allocs, %zu from malloc\n", stats.allocs, stats.mallocs);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* 原版线程池：无界队列，工作线程分离不等待 */
+class LegacyThreadPool {
+public:
+    explicit LegacyThreadPool(size_t threadCount): pool_(std::make_shared<Pool>()) {
+        for(size_t i = 0; i < threadCount; i++) {
+            std::thread([pool = pool_] {
+                std::unique_lock<std::mutex> locker(pool->mtx);
+                while(true) {
+                    if(!pool->tasks.empty()) {
+                        auto task = std::move(pool->tasks.front());
+                        pool->tasks.pop();
+                        locker.unlock();
+                        task();
+                        locker.lock();
+                    }
+                    else if(pool->isClosed) break;
+                    else pool->cond.wait(locker);
+                }
+            }).detach();
+        }
+    }
+
+    ~LegacyThreadPool() {
+        {
+            std::lock_guard<std::mutex> locker(pool_->mtx);
+            pool_->isClosed = true;
+        }
+        pool_->cond.notify_all();
+    }
+
+    template<class F>
+    void AddTask(F&& task) {
+        {
+            std::lock_guard<std::mutex> locker(pool_->mtx);
+            pool_->tasks.emplace(std::forward<F>(task));
+        }
+        pool_->cond.notify_one();
+    }
+
+private:
+    struct Pool {
+        std::mutex mtx;
+        std::condition_variable cond;
+        bool isClosed = false;
+        std::queue<std::function<void()>> tasks;
+    };
+    std::shared_ptr<Pool> pool_;
+};
+
+template<class POOL>
+static double RunPool(POOL& pool, int producers, int tasksPerProducer) {
+    std::atomic<long> done(0);
+    const long total = static_cast<long>(producers) * tasksPerProducer;
+    BenchClock::time_point start = BenchClock::now();
+    std::vector<std::thread> threads;
+    for(int p = 0; p < producers; p++) {
+        threads.emplace_back([&pool, &done, tasksPerProducer] {
+            for(int i = 0; i < tasksPerProducer; i++) {
+                pool.AddTask([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+            }
+        });
+    }
+    for(auto& t: threads) { t.join(); }
+    while(done.load() < total) { std::this_thread::yield(); }
+    return total / (ElapsedNs(start) / 1e9);
+}
+
+/* 主 Reactor 模式下的负载：conns 个连接各自一问一答，反应堆线程 epoll_wait（ONESHOT）后把读事件投递给线程池，
+   工作线程读一个字节、回写、重新注册。每个事件一次 AddTask，和 WebServer::DealRead_ 一样 */
+template<class POOL>
+static double RunPoolConns(POOL& pool, int conns, int rounds) {
+    std::vector<int> server(conns), client(conns), done(conns, 0);
+    int srvEp = epoll_create1(0), cliEp = epoll_create1(0);
+    for(int i = 0; i < conns; i++) {
+        int fds[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) { return 0; }
+        server[i] = fds[0];
+        client[i] = fds[1];
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.fd = server[i];
+        epoll_ctl(srvEp, EPOLL_CTL_ADD, server[i], &ev);
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        epoll_ctl(cliEp, EPOLL_CTL_ADD, client[i], &ev);
+    }
+    std::atomic<bool> stop(false);
+    std::atomic<long> finished(0);
+    long dispatched = 0;
+    BenchClock::time_point start = BenchClock::now();
+    std::thread reactor([&] {
+        epoll_event events[256];
+        while(!stop) {
+            int n = epoll_wait(srvEp, events, 256, 10);
+            for(int k = 0; k < n; k++) {
+                int fd = events[k].data.fd;
+                dispatched++;
+                pool.AddTask([fd, srvEp, &finished] {
+                    char c;
+                    if(read(fd, &c, 1) == 1) { ssize_t ret = write(fd, &c, 1); (void)ret; }
+                    epoll_event ev = {};
+                    ev.events = EPOLLIN | EPOLLONESHOT;
+                    ev.data.fd = fd;
+                    epoll_ctl(srvEp, EPOLL_CTL_MOD, fd, &ev);
+                    finished.fetch_add(1, std::memory_order_release);
+                });
+            }
+        }
+    });
+    const long total = static_cast<long>(conns) * rounds;
+    long received = 0;
+    for(int i = 0; i < conns; i++) { ssize_t ret = write(client[i], "x", 1); (void)ret; }
+    epoll_event events[256];
+    while(received < total) {
+        int n = epoll_wait(cliEp, events, 256, 1000);
+        if(n <= 0) { break; }
+        for(int k = 0; k < n; k++) {
+            int i = events[k].data.u32;
+            char c;
+            if(read(client[i], &c, 1) != 1) { continue; }
+            received++;
+            if(++done[i] < rounds) { ssize_t ret = write(client[i], "x", 1); (void)ret; }
+        }
+    }
+    double elapsed = ElapsedNs(start);
+    stop = true;
+    reactor.join();
+    while(finished.load(std::memory_order_acquire) < dispatched) { std::this_thread::yield(); }  // 任务还在用这些 fd
+    for(int i = 0; i < conns; i++) {
+        close(server[i]);
+        close(client[i]);
+    }
+    close(srvEp);
+    close(cliEp);
+    if(received < total) { return 0; }
+    return total / (elapsed / 1e9);
+}
+
+void BenchThreadPool() {
+    const int workers = 6, tasks = 200000;
+    for(int producers: {1, 4, 8}) {
+        double legacy, current;
+        {
+            LegacyThreadPool pool(workers);
+            legacy = RunPool(pool, producers, tasks / producers);
+        }
+        {
+            ThreadPool pool(workers);
+            current = RunPool(pool, producers, tasks / producers);
+        }
+        printf("[threadpool] %d worker(s), %d producer(s): original %.2f M tasks/s, "
+               "sharded %.2f M tasks/s (x%.2f)\n", workers, producers, legacy / 1e6, current / 1e6,
+               current / legacy);
+    }
+    const int roundTrips = 200000;
+    for(int conns: {100, 1000, 5000}) {
+        double legacy, current;
+        {
+            LegacyThreadPool pool(workers);
+            legacy = RunPoolConns(pool, conns, roundTrips / conns);
+        }
+        {
+            ThreadPool pool(workers);
+            current = RunPoolConns(pool, conns, roundTrips / conns);
+        }
+        if(legacy == 0 || current == 0) {
+            printf("[threadpool] MISMATCH\n");
+            failed = true;
+            return;
+        }
+        printf("[threadpool] %d worker(s), %5d conns: original %.0f K events/s, "
+               "sharded %.0f K events/s (x%.2f)\n", workers, conns, legacy / 1e3, current / 1e3,
+               current / legacy);
+    }
+}
+
+void BenchLog() {
+    const int lines = 400000;
+    for(int producers: {1, 2, 4, 8, 16, 32}) {
+        Log::Instance()->init(0, "/tmp/bench_log", ".log", 1024);
+        BenchClock::time_point start = BenchClock::now();
+        std::vector<std::thread> threads;
+        for(int p = 0; p < producers; p++) {
+            threads.emplace_back([p, producers] {
+                for(int i = 0; i < lines / producers; i++) {
+                    LOG_INFO("producer %d line %d %s", p, i, "GET /index.html HTTP/1.1");
+                }
+            });
+        }
+        for(auto& t: threads) { t.join(); }
+        double ns = ElapsedNs(start);
+        Log::Instance()->init(0, "/tmp/bench_log", ".log", 0);  // 等后台线程写完，计入总耗时
+        double total = ElapsedNs(start);
+        printf("[log] %2d producer(s): %.2f M lines/s appended, %.2f M lines/s on disk\n",
+               producers, lines / (ns / 1e9) / 1e6, lines / (total / 1e9) / 1e6);
+    }
+}
+
+static double RunTimer(Timer& timer, int conns, int refreshes) {
+    for(int i = 0; i < conns; i++) {
+        timer.add(i, 60000, [] {});
+    }
+    unsigned seed = 1;
+    BenchClock::time_point start = BenchClock::now();
+    for(int i = 0; i < refreshes; i++) {
+        seed = seed * 1103515245 + 12345;
+        timer.adjust((seed >> 8) % conns, 60000);
+        if(i % 64 == 0) { timer.GetNextTick(); }  // 模拟事件循环每轮取一次超时
+    }
+    double ns = ElapsedNs(start) / refreshes;
+    timer.clear();
+    return ns;
+}
+
+void BenchTimer() {
+    HeapTimer heap;
+    TimingWheel wheel;
+    for(int conns: {1000, 10000, 60000}) {
+        double heapNs = RunTimer(heap, conns, 2000000);
+        double wheelNs = RunTimer(wheel, conns, 2000000);
+        printf("[timer] %5d connections: heap %.1f ns/refresh, wheel %.1f ns/refresh (x%.1f)\n",
+               conns, heapNs, wheelNs, heapNs / wheelNs);
+    }
+}
+
+/* 旧版响应头：每个响应用 to_string 和临时 string 拼出状态行、Connection、类型和长度 */
+static void LegacyHeader(ChainBuffer& buff, int code, const std::string& status, bool keepAlive,
+                         const std::string& path, size_t len) {
+    static const std::unordered_map<std::string, std::string> SUFFIX = {
+        { ".html", "text/html" }, { ".css", "text/css" }, { ".png", "image/png" },
+    };
+    buff.Append("HTTP/1.1 " + std::to_string(code) + " " + status + "\r\n");
+    buff.Append("Connection: ");
+    if(keepAlive) {
+        buff.Append("keep-alive\r\n");
+        buff.Append("keep-alive: max=6, timeout=120\r\n");
+    } else {
+        buff.Append("close\r\n");
+    }
+    std::string::size_type idx = path.find_last_of('.');
+    std::string suffix = idx == std::string::npos ? "" : path.substr(idx);
+    buff.Append("Content-type: " + (SUFFIX.count(suffix) ? SUFFIX.find(suffix)->second : "text/plain") + "\r\n");
+    buff.Append("Content-length: " + std::to_string(len) + "\r\n\r\n");
+}
+
+void BenchResponse() {
+    char dir[] = "/tmp/bench_resp_XXXXXX";
+    if(!mkdtemp(dir)) { return; }
+    const std::pair<const char*, size_t> files[] = {
+        { "/index.html", 3059 }, { "/style.css", 1234567 }, { "/404.html", 57 }, { "/400.html", 0 },
+    };
+    for(const auto& f: files) {
+        FILE* fp = fopen((std::string(dir) + f.first).c_str(), "w");
+        if(!fp) { return; }
+        if(f.second && ftruncate(fileno(fp), f.second) < 0) { fclose(fp); return; }
+        fclose(fp);
+    }
+    const int requests = 2000000;
+    ChainBuffer buff;
+    BenchClock::time_point start = BenchClock::now();
+    for(int i = 0; i < requests; i++) {
+        LegacyHeader(buff, 200, "OK", true, "/index.html", 3059);
+        buff.Retrieve(buff.ReadableBytes());
+    }
+    double legacy = ElapsedNs(start) / requests;
+    /* 新版只测头部：文件已在缓存中，Init 与 MakeResponse 之外没有别的开销 */
+    HttpResponse response;
+    std::string srcDir = dir, path = "/index.html";
+    start = BenchClock::now();
+    for(int i = 0; i < requests; i++) {
+        response.Init(srcDir, path, true);
+        response.MakeResponse(buff);
+        buff.Retrieve(buff.ReadableBytes());
+    }
+    double block = ElapsedNs(start) / requests;
+    printf("[response] 200 header: concat %.0f ns, template %.0f ns incl. cache lookup (x%.2f)\n",
+           legacy, block, legacy / block);
+    start = BenchClock::now();
+    for(int i = 0; i < requests; i++) {
+        response.Init(srcDir, path, true);
+        response.SetAcceptEncoding("gzip, deflate, br");
+        response.MakeResponse(buff);
+        buff.Retrieve(buff.ReadableBytes());
+    }
+    printf("[response] 200 br from compress cache: %.0f ns\n", ElapsedNs(start) / requests);
+    for(const auto& f: files) { unlink((std::string(dir) + f.first).c_str()); }
+    rmdir(dir);
+}
+
+void BenchMetrics() {
+    const int samples = 4000000;
+    for(int threadNum: {1, 4, 8}) {
+        /* 对照：所有线程共用一组原子计数器 */
+        static std::atomic<uint64_t> shared[Metrics::BUCKETS];
+        double ns[2];
+        for(int local = 0; local < 2; local++) {
+            BenchClock::time_point start = BenchClock::now();
+            std::vector<std::thread> threads;
+            for(int t = 0; t < threadNum; t++) {
+                threads.emplace_back([local, threadNum] {
+                    for(int i = 0; i < samples / threadNum; i++) {
+                        uint64_t v = 500 + (i & 4095) * 37;
+                        if(local) { Metrics::Instance()->Observe(Metrics::WRITE, v); }
+                        else { shared[Metrics::BucketOf(v)].fetch_add(1, std::memory_order_relaxed); }
+                    }
+                });
+            }
+            for(auto& t: threads) { t.join(); }
+            ns[local] = ElapsedNs(start) / samples * threadNum;
+        }
+        printf("[metrics] %d thread(s): shared atomics %.1f ns/sample, per-thread %.1f ns/sample (x%.1f)\n",
+               threadNum, ns[0], ns[1], ns[0] / ns[1]);
+    }
+    BenchClock::time_point start = BenchClock::now();
+    std::string text = Metrics::Instance()->Render();
+    printf("[metrics] render %zu bytes in %.0f us\n", text.size(), ElapsedNs(start) / 1e3);
+}
+
+/* 一个长连接上串行发请求，收完整个响应再发下一个 */
+static double RunKeepAlive(int port, int requests) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return 0;
+    }
+    const std::string req = "GET /index.html HTTP/1.1\r\nHost: bench\r\nConnection: keep-alive\r\n\r\n";
+    std::string resp;
+    char buf[16384];
+    BenchClock::time_point start = BenchClock::now();
+    for(int i = 0; i < requests; i++) {
+        if(send(fd, req.data(), req.size(), 0) != (ssize_t)req.size()) { break; }
+        resp.clear();
+        size_t need = 0;
+        while(need == 0 || resp.size() < need) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if(n <= 0) { break; }
+            resp.append(buf, n);
+            size_t head = resp.find("\r\n\r\n");
+            size_t len = resp.find("Content-length: ");
+            if(need == 0 && head != std::string::npos && len < head) {
+                need = head + 4 + atoi(resp.c_str() + len + 16);
+            }
+        }
+        if(need == 0 || resp.size() != need || resp.compare(0, 12, "HTTP/1.1 200") != 0) {
+            close(fd);
+            return 0;
+        }
+    }
+    double ns = ElapsedNs(start) / requests;
+    close(fd);
+    return ns;
+}
+
+/* 整个服务器跑在本进程里，用指标计数器统计服务器端每个长连接请求的系统调用：
+   epoll_wait、epoll_ctl、readv、writev/sendfile（线程池的唤醒不在其中） */
+void BenchEventLoop() {
+    char dir[] = "/tmp/bench_loop_XXXXXX";
+    if(!mkdtemp(dir)) { return; }
+    std::string index = std::string(dir) + "/index.html";
+    FILE* fp = fopen(index.c_str(), "w");
+    if(!fp) { return; }
+    fputs(std::string(3059, 'x').c_str(), fp);
+    fclose(fp);
+    const Metrics::COUNTER COUNTERS[] = {
+        Metrics::EPOLL_WAITS, Metrics::EPOLL_CTLS, Metrics::READ_CALLS, Metrics::WRITE_CALLS,
+    };
+    const int requests = 20000;
+    int port = 18316;
+    const struct { const char* name; int subReactors; int trigMode; bool uring; bool sqpoll; } MODES[] = {
+        { "thread pool, LT", 0, 0, false, false }, { "thread pool, ET", 0, 3, false, false },
+        { "sub reactor, LT", 1, 0, false, false }, { "sub reactor, ET", 1, 3, false, false },
+        { "io_uring", 1, 3, true, false }, { "io_uring + SQPOLL", 1, 3, true, true },
+        // io_uring 不可用时退回 epoll，结果与 sub reactor, ET 相同
+    };
+    for(const auto& mode: MODES) {
+        Config config;
+        config.port = port++;
+        config.trigMode = mode.trigMode;
+        config.subReactors = mode.subReactors;
+        config.uring = mode.uring;
+        config.uringSqpoll = mode.sqpoll;
+        config.threads = 2;
+        config.connPoolNum = 1;
+        config.openLog = false;
+        config.resourceDir = dir;
+        uint64_t before[4], after[4];
+        for(int i = 0; i < 4; i++) { before[i] = Metrics::Instance()->Total(COUNTERS[i]); }
+        double ns = 0;
+        {
+            WebServer server(config);  // 构造时屏蔽了 SIGTERM，之后创建的线程也屏蔽，由 signalfd 接收
+            std::thread client([&] {
+                ns = RunKeepAlive(config.port, requests);
+                kill(getpid(), SIGTERM);  // 优雅退出，Start 返回
+            });
+            server.Start();
+            client.join();
+        }
+        if(ns == 0) {
+            printf("[eventloop] MISMATCH\n");
+            failed = true;
+            break;
+        }
+        double per[4], total = 0;
+        for(int i = 0; i < 4; i++) {
+            after[i] = Metrics::Instance()->Total(COUNTERS[i]);
+            per[i] = double(after[i] - before[i]) / requests;
+            total += per[i];
+        }
+        printf("[eventloop] %s: %.0f ns/req, per request: epoll_wait %.2f, epoll_ctl %.2f, "
+               "read %.2f, write %.2f (total %.2f)\n", mode.name, ns, per[0], per[1], per[2], per[3], total);
+    }
+    unlink(index.c_str());
+    rmdir(dir);
+}
+
+/* 一次建立 burst 个连接（握手由内核完成，服务器此时可能还没 accept），再逐个发请求、收响应、关闭，
+   每轮都是一批新连接，跑满 seconds 秒后结束当前轮：衡量建连速度，accept 队列溢出时客户端要等 1 秒重传 SYN */
+static double RunBurst(int port, int burst, double seconds, double* worstMs) {
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const std::string req = "GET /index.html HTTP/1.1\r\nHost: bench\r\nConnection: close\r\n\r\n";
+    std::vector<int> fds(burst);
+    char buf[16384];
+    *worstMs = 0;
+    BenchClock::time_point start = BenchClock::now();
+    long conns = 0;
+    while(ElapsedNs(start) < seconds * 1e9) {
+        for(int i = 0; i < burst; i++) {
+            fds[i] = socket(AF_INET, SOCK_STREAM, 0);
+            BenchClock::time_point t = BenchClock::now();
+            if(connect(fds[i], (struct sockaddr*)&addr, sizeof(addr)) < 0) { return 0; }
+            *worstMs = std::max(*worstMs, ElapsedNs(t) / 1e6);
+        }
+        for(int i = 0; i < burst; i++) {
+            if(send(fds[i], req.data(), req.size(), 0) != (ssize_t)req.size()) { return 0; }
+        }
+        for(int i = 0; i < burst; i++) {
+            std::string resp;
+            ssize_t n;
+            while((n = recv(fds[i], buf, sizeof(buf), 0)) > 0) { resp.append(buf, n); }
+            close(fds[i]);
+            if(resp.compare(0, 12, "HTTP/1.1 200") != 0) { return 0; }
+        }
+        conns += burst;
+    }
+    return conns / (ElapsedNs(start) / 1e9);
+}
+
+/* 短连接建连速度：原来的监听参数（backlog 6、无 TCP_DEFER_ACCEPT、每次事件只 accept 一个）对比当前默认值 */
+void BenchAccept() {
+    char dir[] = "/tmp/bench_accept_XXXXXX";
+    if(!mkdtemp(dir)) { return; }
+    std::string index = std::string(dir) + "/index.html";
+    FILE* fp = fopen(index.c_str(), "w");
+    if(!fp) { return; }
+    fputs(std::string(3059, 'x').c_str(), fp);
+    fclose(fp);
+    const int burst = 64;
+    const double seconds = 2;
+    int port = 18416;
+    const struct { const char* name; int subReactors; bool legacy; } MODES[] = {
+        { "thread pool, legacy listen", 0, true }, { "thread pool", 0, false },
+        { "sub reactor, legacy listen", 1, true }, { "sub reactor", 1, false },
+    };
+    for(const auto& mode: MODES) {
+        Config config;
+        config.port = port++;
+        config.subReactors = mode.subReactors;
+        config.reusePort = false;  // 主 Reactor accept 后分发，两种模式走同一段 accept 代码
+        config.threads = 2;
+        config.connPoolNum = 1;
+        config.openLog = false;
+        config.resourceDir = dir;
+        if(mode.legacy) {
+            config.backlog = 6;
+            config.acceptBatch = 1;
+            config.tcpDeferAccept = 0;
+        }
+        double rate = 0, worstMs = 0;
+        {
+            WebServer server(config);
+            std::thread client([&] {
+                rate = RunBurst(config.port, burst, seconds, &worstMs);
+                kill(getpid(), SIGTERM);
+            });
+            server.Start();
+            client.join();
+        }
+        if(rate == 0) {
+            printf("[accept] MISMATCH\n");
+            failed = true;
+            break;
+        }
+        printf("[accept] %s: %.0f conn/s, slowest connect %.1f ms\n", mode.name, rate, worstMs);
+    }
+    unlink(index.c_str());
+    rmdir(dir);
+}
+
+int main(int argc, char* argv[]) {
+    std::string which = argc > 1 ? argv[1] : "";
+    if(which.empty() || which == "parser") { BenchParser(); }
+    if(which.empty() || which == "buffer") { BenchBuffer(); }
+    if(which.empty() || which == "threadpool") { BenchThreadPool(); }
+    if(which.empty() || which == "log") { BenchLog(); }
+    if(which.empty() || which == "timer") { BenchTimer(); }
+    if(which.empty() || which == "response") { BenchResponse(); }
+    if(which.empty() || which == "metrics") { BenchMetrics(); }
+    if(which.empty() || which == "eventloop") { BenchEventLoop(); }
+    if(which.empty() || which == "accept") { BenchAccept(); }
+    return failed ? 1 : 0;
+}
@@ -2,16 +2,56 @@
  * @Author       : mark
  * @Date         : 2020-06-20
  * @copyleft Apache 2.0
- */ 
+ */
+/*
+ * 单元测试：./test [log|threadpool|parser|body|buffer|timer|response|pipeline|metrics|config|usercache|conntable|listener|handover|verify]，不带参数时全部运行。
+ * 检查失败时 assert 中止，进程以非零状态退出
+ */
 #include "../code/log/log.h"
 #include "../code/pool/threadpool.h"
+#include "../code/buffer/buffer.h"
+#include "../code/buffer/chainbuffer.h"
+#include "../code/http/httprequest.h"
+#include "../code/http/httpresponse.h"
+#include "../code/timer/heaptimer.h"
+#include "../code/timer/timingwheel.h"
+#include "../code/metrics/metrics.h"
+#include "../code/pool/usercache.h"
+#include "../code/server/webserver.h"
 #include <features.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <poll.h>
+#include <dirent.h>
+#include <zlib.h>
+#include <string>
+#include <vector>
 
 #if __GLIBC__ == 2 && __GLIBC_MINOR__ < 30
 #include <sys/syscall.h>
 #define gettid() syscall(SYS_gettid)
 #endif
 
+/* 目录下日志文件的总字节数，remove 时顺便删掉目录 */
+static size_t LogDirBytes(const char* dir, bool remove) {
+    size_t total = 0;
+    DIR* dp = opendir(dir);
+    assert(dp);
+    while(struct dirent* entry = readdir(dp)) {
+        if(entry->d_name[0] == '.') { continue; }
+        std::string file = std::string(dir) + "/" + entry->d_name;
+        struct stat st;
+        if(stat(file.c_str(), &st) == 0) { total += st.st_size; }
+        if(remove) { unlink(file.c_str()); }
+    }
+    closedir(dp);
+    if(remove) { rmdir(dir); }
+    return total;
+}
+
 void TestLog() {
     int cnt = 0, level = 0;
     Log::Instance()->init(level, "./testlog1", ".log", 0);
@@ -33,6 +73,92 @@ void TestLog() {
             }
         }
     }
+
+    /* 异步模式下多个线程的日志一行不少地落盘，同一线程内保持先后顺序；
+       只写了几行就退出的线程，退出时交出的暂存缓冲区也要写出去 */
+    char dir[] = "/tmp/test_log_XXXXXX";
+    assert(mkdtemp(dir));
+    const int threads = 4, lines = 5000;
+    Log::Instance()->init(1, dir, ".log", 1024);
+    {
+        std::vector<std::thread> producers;
+        for(int t = 0; t < threads; t++) {
+            producers.emplace_back([t] {
+                int n = t == 0 ? 3 : lines;
+                for(int i = 0; i < n; i++) { LOG_INFO("thread %d line %d", t, i); }
+            });
+        }
+        for(auto& producer: producers) { producer.join(); }
+    }
+    Log::Instance()->init(1, dir, ".log", 0);  // 结束后台线程，缓冲的日志全部写完
+    int next[threads] = {0};
+    DIR* dp = opendir(dir);
+    assert(dp);
+    while(struct dirent* entry = readdir(dp)) {
+        if(entry->d_name[0] == '.') { continue; }
+        std::string file = std::string(dir) + "/" + entry->d_name;
+        FILE* fp = fopen(file.c_str(), "r");
+        assert(fp);
+        char buf[256];
+        while(fgets(buf, sizeof(buf), fp)) {
+            int t, i;
+            const char* p = strstr(buf, "thread ");
+            if(p && sscanf(p, "thread %d line %d", &t, &i) == 2) {
+                assert(t >= 0 && t < threads && i == next[t]);
+                next[t]++;
+            }
+        }
+        fclose(fp);
+        unlink(file.c_str());
+    }
+    closedir(dp);
+    rmdir(dir);
+    assert(next[0] == 3);
+    for(int t = 1; t < threads; t++) { assert(next[t] == lines); }
+
+    /* 同步模式：WARN 写完马上落盘，不等关闭文件 */
+    char syncDir[] = "/tmp/test_log_XXXXXX";
+    assert(mkdtemp(syncDir));
+    Log::Instance()->init(1, syncDir, ".log", 0);
+    LOG_WARN("flushed before exit");
+    assert(LogDirBytes(syncDir, false) > 0);
+    LogDirBytes(syncDir, true);
+
+    /* 积压上限只有 1 个缓冲区：写盘跟不上时整批丢弃，落盘的行数加上丢弃计数一行不差 */
+    char dropDir[] = "/tmp/test_log_XXXXXX";
+    assert(mkdtemp(dropDir));
+    size_t droppedBefore = Log::Instance()->Dropped();
+    Log::Instance()->init(1, dropDir, ".log", 1);
+    {
+        std::vector<std::thread> producers;
+        for(int t = 0; t < threads; t++) {
+            producers.emplace_back([] {
+                for(int i = 0; i < lines * 4; i++) { LOG_INFO("burst line %d %s", i, std::string(100, 'x').c_str()); }
+            });
+        }
+        for(auto& producer: producers) { producer.join(); }
+    }
+    Log::Instance()->init(1, dropDir, ".log", 0);
+    size_t dropped = Log::Instance()->Dropped() - droppedBefore;
+    size_t written = 0;
+    bool noted = false;
+    dp = opendir(dropDir);
+    assert(dp);
+    while(struct dirent* entry = readdir(dp)) {
+        if(entry->d_name[0] == '.') { continue; }
+        FILE* fp = fopen((std::string(dropDir) + "/" + entry->d_name).c_str(), "r");
+        assert(fp);
+        char buf[512];
+        while(fgets(buf, sizeof(buf), fp)) {
+            written += strstr(buf, "burst line ") != nullptr;
+            noted |= strstr(buf, "Log dropped ") != nullptr;
+        }
+        fclose(fp);
+    }
+    closedir(dp);
+    LogDirBytes(dropDir, true);
+    assert(written + dropped == size_t(threads) * lines * 4);
+    assert(noted == (dropped > 0));
 }
 
 void ThreadLogTask(int i, int cnt) {
@@ -43,14 +169,863 @@ void ThreadLogTask(int i, int cnt) {
 
 void TestThreadPool() {
     Log::Instance()->init(0, "./testThreadpool", ".log", 5000);
-    ThreadPool threadpool(6);
-    for(int i = 0; i < 18; i++) {
-        threadpool.AddTask(std::bind(ThreadLogTask, i % 4, i * 10000));
+    std::atomic<int> done(0);
+    {
+        ThreadPool threadpool(6);
+        for(int i = 0; i < 18; i++) {
+            threadpool.AddTask([i, &done] {
+                ThreadLogTask(i % 4, i * 10000);
+                done++;
+            });
+        }
+    }  // 析构时等已投递的任务执行完
+    assert(done == 18);
+
+    /* 各线程队列都满时 AddTask 不阻塞调用方，溢出的任务照样执行；任务可以只可移动 */
+    std::atomic<bool> release(false);
+    std::atomic<int> ran(0);
+    {
+        ThreadPool threadpool(2, 2);
+        for(int i = 0; i < 2; i++) {
+            threadpool.AddTask([&release] { while(!release) { std::this_thread::yield(); } });
+        }
+        for(int i = 0; i < 100; i++) {
+            std::unique_ptr<int> value(new int(i));
+            threadpool.AddTask([&ran, value = std::move(value)] { ran += *value >= 0; });
+        }
+        release = true;
     }
-    getchar();
+    assert(ran == 100);
+
+    /* TryAddTask 在各线程队列都满时返回 false，不进溢出队列；已接受的任务照样执行 */
+    release = false;
+    ran = 0;
+    std::atomic<int> started(0);
+    {
+        ThreadPool threadpool(2, 2);
+        for(int i = 0; i < 2; i++) {
+            threadpool.AddTask([&release, &started] { started++; while(!release) { std::this_thread::yield(); } });
+        }
+        while(started < 2) { std::this_thread::yield(); }  // 两个工作线程都被占住，队列是空的
+        int accepted = 0;
+        while(threadpool.TryAddTask([&ran] { ran++; })) { accepted++; }
+        assert(accepted == 4);  // 2 个队列各 2 个槽位
+        release = true;
+    }
+    assert(ran == 4);
 }
 
-int main() {
-    TestLog();
-    TestThreadPool();
-}
\ No newline at end of file
+/* 请求行、路径补全和长连接判断 */
+void TestParser() {
+    struct Case { std::string req, method, path, version; bool keepAlive; };
+    const Case cases[] = {
+        { "GET / HTTP/1.1\r\nHost: 127.0.0.1:1316\r\nConnection: keep-alive\r\n"
+          "Accept-Encoding: gzip, deflate\r\n\r\n", "GET", "/index.html", "1.1", true },
+        { "GET /css/bootstrap.min.css HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n", "GET", "/css/bootstrap.min.css", "1.1", true },
+        { "GET /video.html HTTP/1.0\r\nHost: 127.0.0.1\r\n\r\n", "GET", "/video.html", "1.0", false },
+        { "GET /video.html HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n", "GET", "/video.html", "1.0", true },
+        { "GET /picture HTTP/1.1\r\nConnection: close\r\n\r\n", "GET", "/picture.html", "1.1", false },
+        { "GET / HTTP/1.1\r\nConnection: Upgrade,\t CLOSE \r\n\r\n", "GET", "/index.html", "1.1", false },
+        { "GET / HTTP/1.1\r\nConnection: closed\r\nconnection: keep-alive\r\n\r\n", "GET", "/index.html", "1.1", true },
+    };
+    Buffer buff;
+    HttpRequest request;
+    for(const Case& c: cases) {
+        buff.RetrieveAll();
+        buff.Append(c.req);
+        assert(request.parse(buff) == HttpRequest::GET_REQUEST);
+        assert(request.method() == c.method && request.path() == c.path);
+        assert(request.version() == c.version && request.IsKeepAlive() == c.keepAlive);
+        assert(buff.ReadableBytes() == 0);
+    }
+    /* 逐字节到达时结果相同 */
+    const std::string& req = cases[0].req;
+    buff.RetrieveAll();
+    HttpRequest::HTTP_CODE ret = HttpRequest::NO_REQUEST;
+    for(size_t i = 0; i < req.size(); i++) {
+        assert(ret == HttpRequest::NO_REQUEST);
+        buff.Append(&req[i], 1);
+        ret = request.parse(buff);
+    }
+    assert(ret == HttpRequest::GET_REQUEST && request.path() == "/index.html");
+    buff.RetrieveAll();
+    buff.Append("GET /index.html HTTP/1.1 junk\r\n\r\n");
+    assert(request.parse(buff) == HttpRequest::BAD_REQUEST);
+}
+
+/* 请求体：逐字节到达的 Content-Length / chunked 请求体、转存临时文件、非法的分帧 */
+void TestBody() {
+    Buffer buff;
+    HttpRequest request;
+    const std::string form = "username=a+b&password=line1\r\nline2";
+    const std::string chunked =
+        "POST /form HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+        "Transfer-Encoding: chunked\r\n\r\n"
+        "d;ext=1\r\nusername=a+b&\r\n" "15\r\npassword=line1\r\nline2\r\n0\r\nX-Trailer: 1\r\n\r\n"
+        "GET /next HTTP/1.1\r\n\r\n";
+    const std::string sized =
+        "POST /form HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+        "Content-Length: " + std::to_string(form.size()) + "\r\n\r\n" + form + "GET /next HTTP/1.1\r\n\r\n";
+    for(const std::string* req: { &sized, &chunked }) {
+        buff.RetrieveAll();
+        HttpRequest::HTTP_CODE ret = HttpRequest::NO_REQUEST;
+        size_t i = 0;
+        while(i < req->size() && ret == HttpRequest::NO_REQUEST) {
+            buff.Append(&(*req)[i++], 1);
+            ret = request.parse(buff);
+        }
+        assert(ret == HttpRequest::GET_REQUEST && request.BodyLen() == form.size());
+        assert(request.GetPost("username") == "a b" && request.GetPost("password") == "line1\r\nline2");
+        assert(request.parse(buff) == HttpRequest::NO_REQUEST);
+        buff.Append(req->data() + i, req->size() - i);
+        assert(request.parse(buff) == HttpRequest::GET_REQUEST && request.path() == "/next");
+    }
+
+    /* 超过内存上限的请求体写入临时文件，buff 中不堆积 */
+    std::string big(1 << 20, 'x');
+    for(size_t i = 0; i < big.size(); i++) { big[i] = 'a' + i % 26; }
+    buff.RetrieveAll();
+    buff.Append("POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+    for(size_t off = 0; off < big.size(); off += 10000) {
+        size_t len = std::min<size_t>(10000, big.size() - off);
+        char size[16];
+        snprintf(size, sizeof(size), "%zx\r\n", len);
+        buff.Append(size);
+        buff.Append(big.data() + off, len);
+        buff.Append("\r\n");
+        assert(request.parse(buff) == HttpRequest::NO_REQUEST && buff.ReadableBytes() == 0);
+    }
+    buff.Append("0\r\n\r\n");
+    assert(request.parse(buff) == HttpRequest::GET_REQUEST);
+    assert(request.BodyFd() >= 0 && request.BodyLen() == big.size());
+    std::string spilled(big.size(), 0);
+    assert(pread(request.BodyFd(), &spilled[0], spilled.size(), 0) == (ssize_t)big.size() && spilled == big);
+
+    const char* bad[] = {
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 3\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcX\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: 999999999999\r\n\r\n",
+    };
+    for(const char* req: bad) {
+        buff.RetrieveAll();
+        buff.Append(req);
+        assert(request.parse(buff) == HttpRequest::BAD_REQUEST);
+    }
+}
+
+void TestBuffer() {
+    Buffer buff;
+    std::string expect;
+    for(int i = 0; i < 5000; i++) {
+        std::string piece(i % 97 + 1, 'a' + i % 26);
+        buff.Append(piece);
+        expect += piece;
+        if(i % 7 == 0) {
+            size_t n = std::min(buff.ReadableBytes(), static_cast<size_t>(i % 300));
+            assert(std::string(buff.Peek(), n) == expect.substr(0, n));
+            buff.Retrieve(n);
+            expect.erase(0, n);
+        }
+    }
+    assert(buff.RetrieveAllToStr() == expect);
+    buff.Release();
+    buff.Append("x", 1);
+    assert(buff.ReadableBytes() == 1 && *buff.Peek() == 'x');
+
+    /* 分段缓冲区：拷贝的数据和外部引用交替，iovec 拼起来与追加的内容一致 */
+    ChainBuffer chain;
+    auto file = std::make_shared<std::string>(10000, 'f');
+    expect.clear();
+    for(int i = 0; i < 300; i++) {
+        std::string piece(i * 37 % 5000, 'a' + i % 26);
+        chain.Append(piece);
+        expect += piece;
+        if(i % 3 == 0) {
+            chain.AppendRef(file->data(), i * 13 % file->size(), file);
+            expect.append(file->data(), i * 13 % file->size());
+        }
+        if(i % 5 == 0) {
+            chain.Retrieve(std::min<size_t>(chain.ReadableBytes(), i * 11));
+            expect.erase(0, std::min<size_t>(expect.size(), i * 11));
+        }
+    }
+    std::string joined;
+    struct iovec iov[1024];
+    int cnt = chain.PeekIov(iov, 1024);
+    for(int i = 0; i < cnt; i++) { joined.append(static_cast<char*>(iov[i].iov_base), iov[i].iov_len); }
+    assert(joined == expect && chain.ReadableBytes() == expect.size());
+
+    /* 文件区间夹在内存段之间：WriteFd 交替 writev 和 sendfile，对端收到的顺序不变 */
+    FILE* tmp = tmpfile();
+    assert(tmp && fwrite(file->data(), 1, file->size(), tmp) == file->size() && fflush(tmp) == 0);
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    chain.Clear();
+    chain.Append("head", 4);
+    chain.AppendFile(fileno(tmp), 100, 2000, nullptr);
+    chain.Append("mid", 3);
+    chain.AppendFile(fileno(tmp), 0, 10, nullptr);
+    chain.Append("tail", 4);
+    assert(chain.HasFile());
+    expect = "head" + file->substr(100, 2000) + "mid" + file->substr(0, 10) + "tail";
+    int err = 0;
+    while(chain.ReadableBytes() > 0 && chain.WriteFd(fds[0], &err) > 0) {}
+    assert(chain.ReadableBytes() == 0 && !chain.HasFile());
+    std::string got(expect.size(), '\0');
+    assert(recv(fds[1], &got[0], got.size(), MSG_WAITALL) == (ssize_t)expect.size() && got == expect);
+    close(fds[0]);
+    close(fds[1]);
+    fclose(tmp);
+}
+
+/* 短超时的定时器都要恰好触发一次，且不早于到期时间（两者都是毫秒精度，允许 1ms 误差） */
+static void CheckTimer(Timer& timer) {
+    const int n = 5000;
+    std::vector<int> fired(n, 0);
+    std::vector<TimeStamp> due(n);
+    bool early = false;
+    for(int i = 0; i < n; i++) {
+        int timeout = (i * 7919) % 300;
+        due[i] = Clock::now() + MS(timeout);
+        timer.add(i, timeout, [&, i] {
+            fired[i]++;
+            if(Clock::now() + MS(1) < due[i]) { early = true; }
+        });
+    }
+    for(int i = 0; i < n; i += 3) {
+        due[i] = Clock::now() + MS(400);
+        timer.adjust(i, 400);
+    }
+    due[1] = Clock::now();
+    timer.doWork(1);  // 立即触发
+    while(timer.GetNextTick() >= 0) { std::this_thread::sleep_for(MS(1)); }
+    for(int i = 0; i < n; i++) {
+        assert(fired[i] == 1);
+    }
+    assert(!early);
+}
+
+void TestTimer() {
+    HeapTimer heap;
+    TimingWheel wheel;
+    CheckTimer(heap);
+    CheckTimer(wheel);
+}
+
+static std::string DrainHead(ChainBuffer& buff) {  // 取出响应头，丢弃文件体
+    std::string out;
+    struct iovec iov[64];
+    int cnt = buff.PeekIov(iov, 64);
+    for(int i = 0; i < cnt; i++) { out.append(static_cast<char*>(iov[i].iov_base), iov[i].iov_len); }
+    buff.Clear();
+    size_t end = out.find("\r\n\r\n");
+    return end == std::string::npos ? out : out.substr(0, end + 4);
+}
+
+static std::string DrainAll(ChainBuffer& buff) {  // 响应头和内存中的响应体
+    std::string out;
+    struct iovec iov[64];
+    int cnt = buff.PeekIov(iov, 64);
+    for(int i = 0; i < cnt; i++) { out.append(static_cast<char*>(iov[i].iov_base), iov[i].iov_len); }
+    buff.Clear();
+    return out;
+}
+
+/* 在临时目录中建好测试用的文件，返回目录（以 / 结尾前的部分） */
+static std::string MakeDocRoot(const char* name, const std::vector<std::pair<std::string, size_t>>& files) {
+    std::string dir = std::string("/tmp/") + name + "_XXXXXX";
+    assert(mkdtemp(&dir[0]));
+    for(const auto& f: files) {
+        FILE* fp = fopen((dir + f.first).c_str(), "w");
+        assert(fp);
+        assert(f.second == 0 || ftruncate(fileno(fp), f.second) == 0);
+        fclose(fp);
+    }
+    return dir;
+}
+
+static void RemoveDocRoot(const std::string& dir, const std::vector<std::pair<std::string, size_t>>& files) {
+    for(const auto& f: files) { unlink((dir + f.first).c_str()); }
+    rmdir(dir.c_str());
+}
+
+void TestResponse() {
+    const std::vector<std::pair<std::string, size_t>> files = {
+        { "/index.html", 3059 }, { "/style.css", 1234567 }, { "/404.html", 57 }, { "/400.html", 0 },
+    };
+    std::string dir = MakeDocRoot("test_resp", files);
+    struct Case { std::string path; bool keepAlive; int code; std::string type; size_t len; };
+    const Case cases[] = {
+        { "/index.html", true, 200, "text/html", 3059 },
+        { "/style.css", false, 200, "text/css", 1234567 },
+        { "/missing.html", true, 404, "text/html", 57 },
+        { "/", false, 400, "text/html", 0 },
+    };
+    for(const Case& c: cases) {
+        ChainBuffer buff;
+        HttpResponse response;
+        std::string path = c.path;
+        response.Init(dir, path, c.keepAlive, c.code == 400 ? 400 : -1);
+        response.MakeResponse(buff);
+        size_t total = buff.ReadableBytes();
+        std::string head = DrainHead(buff);
+        assert(response.Code() == c.code);
+        assert(head.compare(0, 12, "HTTP/1.1 " + std::to_string(c.code)) == 0);
+        assert(head.find(c.keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n") != std::string::npos);
+        assert(head.find("Content-type: " + c.type + "\r\n") != std::string::npos);
+        assert(head.find("Content-length: " + std::to_string(c.len) + "\r\n") != std::string::npos);
+        assert(total == head.size() + c.len);
+    }
+    /* 条件请求：校验器一致时 304 且没有文件体 */
+    std::shared_ptr<const FileEntry> file = FileCache::Instance()->Get(dir + "/index.html");
+    assert(file);
+    const std::pair<std::string, std::string> conds[] = {
+        { file->etag, "" }, { "\"x\", W/" + file->etag, "" }, { "*", "" },
+        { "", file->lastModified }, { "", "Sun, 01 Jan 2090 00:00:00 GMT" },
+        { "\"x\"", file->lastModified }, { "", "Sat, 01 Jan 2000 00:00:00 GMT" }, { "", "garbage" },
+    };
+    for(size_t i = 0; i < sizeof(conds) / sizeof(conds[0]); i++) {
+        ChainBuffer buff;
+        HttpResponse response;
+        std::string path = "/index.html";
+        response.Init(dir, path, true, 200);
+        response.SetConditional(conds[i].first, conds[i].second);
+        response.MakeResponse(buff);
+        size_t total = buff.ReadableBytes();
+        std::string got = DrainHead(buff);
+        bool notModified = i < 5;
+        assert(response.Code() == (notModified ? 304 : 200));
+        assert((total == got.size()) == notModified);
+        assert(got.find("ETag: " + file->etag + "\r\n") != std::string::npos);
+        assert((got.find("Content-length") == std::string::npos) == notModified);
+    }
+    /* 没有错误页面时生成的 HTML 长度要与正文一致 */
+    ChainBuffer buff;
+    HttpResponse response;
+    std::string path = "/";
+    response.Init("/nonexistent", path, true, 403);
+    response.MakeResponse(buff);
+    size_t total = buff.ReadableBytes();
+    std::string got = DrainHead(buff);
+    assert(got.find("Content-type: text/html\r\n") != std::string::npos);
+    assert(got.find("Content-length: " + std::to_string(total - got.size()) + "\r\n") != std::string::npos);
+    /* Range：单段 206 只挂请求的区间，越界 416 不带正文 */
+    const std::pair<const char*, int> ranges[] = { { "bytes=100-109", 206 }, { "bytes=3059-", 416 } };
+    for(const auto& r: ranges) {
+        std::string path = "/index.html";
+        response.Init(dir, path, true, 200);
+        response.SetRange(r.first, "");
+        response.MakeResponse(buff);
+        total = buff.ReadableBytes();
+        got = DrainHead(buff);
+        assert(response.Code() == r.second && total - got.size() == (r.second == 206 ? 10u : 0u));
+    }
+    /* 压缩：gzip 体解压后与原文件一致，再次请求命中缓存，不再压缩 */
+    CompressCache::Stats before = CompressCache::Instance()->GetStats();
+    for(int i = 0; i < 2; i++) {
+        path = "/index.html";
+        response.Init(dir, path, true, 200);
+        response.SetAcceptEncoding("deflate, gzip;q=0.8, br;q=0");
+        response.MakeResponse(buff);
+        std::string all = DrainAll(buff);
+        size_t sep = all.find("\r\n\r\n");
+        assert(sep != std::string::npos && all.find("Content-Encoding: gzip\r\n") != std::string::npos);
+        std::string body = all.substr(sep + 4);
+        std::string plain(4096, 'x');
+        z_stream zs = {};
+        inflateInit2(&zs, 15 + 16);
+        zs.next_in = reinterpret_cast<Bytef*>(&body[0]);
+        zs.avail_in = body.size();
+        zs.next_out = reinterpret_cast<Bytef*>(&plain[0]);
+        zs.avail_out = plain.size();
+        int ret = inflate(&zs, Z_FINISH);
+        plain.resize(zs.total_out);
+        inflateEnd(&zs);
+        assert(ret == Z_STREAM_END && plain == std::string(3059, '\0'));
+    }
+    CompressCache::Stats after = CompressCache::Instance()->GetStats();
+    assert(after.misses == before.misses + 1 && after.hits == before.hits + 1);
+    RemoveDocRoot(dir, files);
+}
+
+/* 一次读入多个流水线请求：响应按顺序排队，不完整的尾部请求留到下次数据到达 */
+void TestPipeline() {
+    const std::vector<std::pair<std::string, size_t>> files = { { "/index.html", 100 }, { "/404.html", 10 } };
+    std::string dir = MakeDocRoot("test_pipe", files);
+    const char* srcDir = HttpConn::srcDir;
+    HttpConn::srcDir = dir.c_str();
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+    HttpConn conn;
+    struct sockaddr_in addr = {};
+    conn.init(fds[0], addr);
+    const std::string tail = "GET /index.html HTTP/1.1\r\nConnection: close\r\n\r\n";
+    const std::string batch = "GET /index.html HTTP/1.1\r\nHost: a\r\n\r\n"
+                              "GET /index.html HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"
+                              "GET /missing.html HTTP/1.1\r\n\r\n" + tail.substr(0, 30);
+    /* 每批返回收到的响应：状态码和 Connection 依次拼接，原始字节留在 out */
+    std::string out;
+    auto exchange = [&](const std::string& data) {
+        conn.Feed(data.data(), data.size());
+        assert(conn.process());
+        int err = 0;
+        while(conn.ToWriteBytes() > 0) { assert(conn.write(&err) > 0); }
+        std::string got;
+        char buf[4096];
+        out.clear();
+        struct pollfd pfd = { fds[1], POLLIN, 0 };
+        while(poll(&pfd, 1, 0) > 0) {
+            ssize_t n = read(fds[1], buf, sizeof(buf));
+            assert(n > 0);
+            out.append(buf, n);
+        }
+        for(size_t pos = out.find("HTTP/1.1 "); pos != std::string::npos; pos = out.find("HTTP/1.1 ", pos + 1)) {
+            size_t at = out.find("Connection: ", pos) + 12;
+            got += out.substr(pos + 9, 3) + " " + out.substr(at, out.find("\r\n", at) - at) + ";";
+        }
+        return got;
+    };
+    /* HEAD 的头部与 GET 相同，但后面紧跟下一个响应的状态行 */
+    assert(exchange("HEAD /index.html HTTP/1.1\r\n\r\nGET /index.html HTTP/1.1\r\n\r\n")
+           == "200 keep-alive;200 keep-alive;");
+    size_t headEnd = out.find("\r\n\r\n") + 4;
+    assert(out.find("HTTP/1.1 ", 1) == headEnd);
+    assert(out.substr(0, headEnd).find("Content-length: 100\r\n") != std::string::npos);
+    assert(out.compare(0, headEnd, out, headEnd, headEnd) == 0 && out.size() == headEnd * 2 + 100);
+    assert(exchange(batch) == "200 keep-alive;200 keep-alive;404 keep-alive;");
+    assert(conn.IsKeepAlive() && conn.ToReadBytes() == 30);
+    assert(exchange(tail.substr(30)) == "200 close;");
+    assert(!conn.IsKeepAlive() && conn.ToReadBytes() == 0);
+    /* 关闭时丢弃没发完的响应和没解析的数据 */
+    conn.Feed(batch.data(), 40);
+    assert(conn.process() && conn.ToWriteBytes() > 0 && conn.ToReadBytes() > 0);
+    conn.Close();
+    assert(conn.ToWriteBytes() == 0 && conn.ToReadBytes() == 0);
+    close(fds[1]);
+    HttpConn::srcDir = srcDir;
+    RemoveDocRoot(dir, files);
+}
+
+/* 桶的上界不小于落入的值，误差不超过 1/16；多线程记录的样本合并后一个不少 */
+void TestMetrics() {
+    int last = -1;
+    for(uint64_t v = 0; v < (uint64_t(1) << 40); v = v < 4096 ? v + 1 : v + v / 37) {
+        int bucket = Metrics::BucketOf(v);
+        uint64_t max = Metrics::BucketMax(bucket);
+        assert(bucket >= last && max >= v && max - v <= v / 16);
+        last = bucket;
+    }
+    Metrics::Snapshot before = Metrics::Instance()->Merge(Metrics::PARSE);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; t++) {
+        threads.emplace_back([] {
+            for(int i = 0; i < 10000; i++) { Metrics::Instance()->Observe(Metrics::PARSE, 1000 + i % 1000); }
+        });
+    }
+    for(auto& t: threads) { t.join(); }
+    Metrics::Snapshot after = Metrics::Instance()->Merge(Metrics::PARSE);
+    assert(after.count - before.count == 40000 && after.CountAtMost(999) == before.CountAtMost(999));
+    std::string text = Metrics::Instance()->Render();
+    assert(text.find("# TYPE webserver_request_parse_seconds histogram") != std::string::npos);
+    assert(text.find("webserver_request_parse_seconds_bucket{le=\"+Inf\"} " + std::to_string(after.count))
+           != std::string::npos);
+}
+
+/* 配置：默认值 < 配置文件 < 命令行，引号、大小后缀、未知键和取值范围 */
+void TestConfig() {
+    char path[] = "/tmp/test_config_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    const std::string text =
+        "# 注释\n; 注释\n[server]\nport = 2000\ntimeout_ms = 5000\n"
+        "resource_dir = \" /srv/my dir # x \"\n\n"
+        "[cache]\nfile_bytes = 64M\nmmap_limit=4k\nmax_age = text/css=10, image/*=-1\n";
+    assert(write(fd, text.data(), text.size()) == (ssize_t)text.size());
+    close(fd);
+
+    Config config;
+    std::string err;
+    std::string cli[] = { "server", "--server.port=3000", "-c", path, "--log.level", "2" };
+    char* argv[6];
+    for(int i = 0; i < 6; i++) { argv[i] = &cli[i][0]; }
+    assert(config.ParseArgs(6, argv, &err));
+    assert(config.port == 3000 && config.timeoutMS == 5000 && config.logLevel == 2);  // 命令行写在 -c 之前也覆盖文件
+    assert(config.resourceDir == " /srv/my dir # x ");
+    assert(config.fileCacheBytes == (64u << 20) && config.mmapLimit == 4096);
+    assert(config.cacheMaxAge.size() == 2 && config.cacheMaxAge[1].first == "image/*" && config.cacheMaxAge[1].second == -1);
+    assert(config.threads == Config().threads && config.backlog == 1024);  // 没写的保持默认值
+
+    /* 导出的文本重新加载后取值不变 */
+    Config copy;
+    fd = open(path, O_WRONLY | O_TRUNC);
+    std::string dump = config.Dump();
+    assert(write(fd, dump.data(), dump.size()) == (ssize_t)dump.size());
+    close(fd);
+    assert(copy.Load(path, &err) && copy.Dump() == dump);
+
+    /* 未知键和非法值：文件里报告行号，命令行直接报错 */
+    fd = open(path, O_WRONLY | O_TRUNC);
+    const std::string bad = "[server]\nport = 2000\nbogus = 1\n";
+    assert(write(fd, bad.data(), bad.size()) == (ssize_t)bad.size());
+    close(fd);
+    assert(!copy.Load(path, &err) && err == std::string(path) + ":3: unknown key: server.bogus");
+    assert(!copy.Set("server.no_such", "1", &err) && err == "unknown key: server.no_such");
+    const std::pair<const char*, const char*> invalid[] = {
+        { "server.port", "12x" }, { "server.port", "99999999999" }, { "cache.file_bytes", "-1" },
+        { "cache.file_bytes", "8T" }, { "cache.file_bytes", "M" }, { "server.linger", "maybe" },
+        { "cache.max_age", "text/css" }, { "cache.max_age", "=10" }, { "cache.max_age", "text/css=soon" },
+    };
+    for(const auto& kv: invalid) {
+        assert(!copy.Set(kv.first, kv.second, &err));
+    }
+    assert(copy.Set("cache.file_bytes", "2g", &err) && copy.fileCacheBytes == (size_t(2) << 30));
+    assert(copy.Set("server.linger", "on", &err) && copy.optLinger);
+
+    /* 取值范围 */
+    assert(Config().Validate(&err));
+    const std::pair<const char*, const char*> ranges[] = {
+        { "server.port", "80" }, { "server.port", "65536" }, { "server.trig_mode", "4" },
+        { "server.backlog", "0" }, { "uring.enable", "true" }, { "uring.entries", "32769" },
+        { "log.level", "-1" }, { "log.queue_size", "-1" }, { "metrics.path", "metrics" },
+    };
+    for(const auto& kv: ranges) {
+        Config c;
+        assert(c.Set(kv.first, kv.second, &err) && !c.Validate(&err));
+        assert(err.compare(0, strlen(kv.first), kv.first) == 0);  // 错误信息以出错的键开头
+    }
+    Config c;
+    assert(c.Set("server.sub_reactors", "2", &err) && c.Set("uring.enable", "true", &err) && c.Validate(&err));
+    unlink(path);
+}
+
+/* 用户缓存：命中/未命中、不存在结果的 TTL、分片内按 LRU 淘汰，以及 CachedVerify 对登录和注册的判定 */
+void TestUserCache() {
+    UserCache* cache = UserCache::Instance();
+    std::string pwd;
+    cache->Init(100, 60000, 50);
+    UserCache::Stats before = cache->GetStats();
+    assert(cache->Get("alice", &pwd) == UserCache::MISS);
+    cache->Put("alice", "secret");
+    assert(cache->Get("alice", &pwd) == UserCache::FOUND && pwd == "secret");
+    cache->PutMissing("ghost");
+    assert(cache->Get("ghost", &pwd) == UserCache::NOT_FOUND);
+    UserCache::Stats after = cache->GetStats();
+    assert(after.hits == before.hits + 1 && after.negativeHits == before.negativeHits + 1);
+    assert(after.misses == before.misses + 1 && after.entries == 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    assert(cache->Get("ghost", &pwd) == UserCache::MISS);  // 不存在的结果先过期
+    assert(cache->Get("alice", &pwd) == UserCache::FOUND);
+    assert(cache->GetStats().entries == 1);
+
+    /* 找出与 a 落在同一分片的名字：每片只留一条时，写入它们会把 a 挤掉 */
+    std::vector<std::string> same;
+    cache->Init(1, 60000, 60000);
+    for(int i = 0; same.size() < 2; i++) {
+        assert(i < 10000);
+        std::string name = "user" + std::to_string(i);
+        cache->Put("a", "pa");
+        cache->Put(name, "x");
+        if(cache->Get("a", &pwd) == UserCache::MISS) { same.push_back(name); }
+    }
+    /* 17 条分到 16 片，每片最多 2 条：刚用过的 a 留下，最久没用的被淘汰 */
+    cache->Init(17, 60000, 60000);
+    size_t evictions = cache->GetStats().evictions;
+    cache->Put("a", "pa");
+    cache->Put(same[0], "x");
+    assert(cache->Get("a", &pwd) == UserCache::FOUND);
+    cache->Put(same[1], "y");
+    assert(cache->GetStats().evictions == evictions + 1);
+    assert(cache->Get(same[0], &pwd) == UserCache::MISS);
+    assert(cache->Get("a", &pwd) == UserCache::FOUND && cache->Get(same[1], &pwd) == UserCache::FOUND);
+
+    /* CachedVerify：1 通过、0 拒绝、-1 查库；注册总要查库写入，缓存只能提前判定用户名已被占用 */
+    cache->Init(100, 60000, 60000);
+    assert(HttpRequest::CachedVerify("", "pw", true) == 0 && HttpRequest::CachedVerify("bob", "", false) == 0);
+    assert(HttpRequest::CachedVerify("bob", "pw", true) == -1 && HttpRequest::CachedVerify("bob", "pw", false) == -1);
+    cache->PutMissing("bob");  // 登录查库没有这个人
+    assert(HttpRequest::CachedVerify("bob", "pw", true) == 0 && HttpRequest::CachedVerify("bob", "pw", false) == -1);
+    cache->Put("bob", "pw");  // 注册成功后写穿，覆盖不存在的记录
+    assert(HttpRequest::CachedVerify("bob", "pw", true) == 1 && HttpRequest::CachedVerify("bob", "bad", true) == 0);
+    assert(HttpRequest::CachedVerify("bob", "pw", false) == 0);  // 用户名已被使用
+    cache->Init();
+}
+
+/* 连接表的代数保护：连接关闭、fd 被新连接复用后，旧连接的定时器和验证结果都找不到连接 */
+void TestConnTable() {
+    ConnTable table(1024);
+    assert(table.Find(1000) == nullptr);  // 块还没有分配
+    struct sockaddr_in addr = {};
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+    int fd = fds[0];
+    HttpConn* conn = table.Get(fd);
+    conn->init(fd, addr);
+    uint32_t gen = conn->GetGen();
+    assert(table.Find(fd) == conn && table.Find(fd, gen) == conn);
+
+    HeapTimer timer;
+    int fired = 0;
+    timer.add(fd, 1, [&table, &fired, fd, gen] {
+        fired++;
+        assert(table.Find(fd, gen) == nullptr);  // 回调执行时连接已经换人
+    });
+    VerifyTask task{ fd, gen, "name", "pwd", true, true };
+
+    conn->Close();
+    assert(table.Find(fd, gen) == nullptr);  // 关闭后即失效，不必等 fd 复用
+    int again[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, again) == 0);
+    assert(again[0] == fd);  // 内核分配最小的空闲 fd，槽位被新连接复用
+    HttpConn* reused = table.Get(fd);
+    assert(reused == conn);
+    reused->init(fd, addr);
+    uint32_t newGen = reused->GetGen();
+    assert(newGen != gen);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    timer.tick();
+    assert(fired == 1);
+    assert(table.Find(task.fd, task.gen) == nullptr);  // 验证结果晚到：丢弃
+    assert(table.Find(fd, newGen) == reused);
+
+    reused->Close();
+    close(fds[1]);
+    close(again[1]);
+}
+
+static int ConnectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for(int i = 0; connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0; i++) {
+        assert(i < 100);  // 服务器还没开始监听时重试，最多 1 秒
+        close(fd);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    struct timeval tv = { 0, 0 };
+    tv.tv_sec = 5;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));  // 等不到响应时 recv 超时返回，不挂住测试
+    return fd;
+}
+
+/* 监听套接字：接受的连接已是非阻塞、close-on-exec，每次最多接受 acceptBatch 个 */
+void TestListener() {
+    Listener listener({ 19330, 16, false, 0, 0, true, 3 });
+    int listenFd = listener.Open(false);
+    assert(listenFd >= 0);
+    assert((fcntl(listenFd, F_GETFL) & O_NONBLOCK) && (fcntl(listenFd, F_GETFD) & FD_CLOEXEC));
+    std::vector<int> clients;
+    for(int i = 0; i < 5; i++) { clients.push_back(ConnectLoopback(19330)); }
+    struct pollfd pfd = { listenFd, POLLIN, 0 };
+    assert(poll(&pfd, 1, 1000) == 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));  // 5 个连接都进入 accept 队列
+
+    std::vector<int> accepted;
+    auto onConn = [&accepted](int fd, const sockaddr_in& addr) {
+        assert(addr.sin_family == AF_INET && addr.sin_addr.s_addr == htonl(INADDR_LOOPBACK));
+        assert((fcntl(fd, F_GETFL) & O_NONBLOCK) && (fcntl(fd, F_GETFD) & FD_CLOEXEC));
+        int noDelay = 0;
+        socklen_t len = sizeof(noDelay);
+        assert(getsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, &len) == 0 && noDelay);
+        accepted.push_back(fd);
+    };
+    assert(listener.AcceptSome(listenFd, onConn) == 3 && accepted.size() == 3);  // 取满一批就停
+    assert(listener.AcceptSome(listenFd, onConn) == 2 && accepted.size() == 5);
+    assert(listener.AcceptSome(listenFd, onConn) == 0);
+    struct sockaddr_in addr;
+    assert(listener.Accept(listenFd, &addr) < 0 && errno == EAGAIN);  // 队列已空时不阻塞
+    for(int fd: accepted) { close(fd); }
+    for(int fd: clients) { close(fd); }
+    close(listenFd);
+}
+
+/* 平滑升级的交接：监听套接字经 SCM_RIGHTS 传给新进程，热点路径按原顺序到达，新进程确认后旧进程得到 DONE */
+void TestHandover() {
+    Listener listener({ 19331, 16, false, 0, 0, true, 8 });
+    int listenFd = listener.Open(false);
+    assert(listenFd >= 0);
+    std::string path = "/tmp/test_handover_" + std::to_string(getpid()) + ".sock";
+    Handover old(path);
+    assert(old.Listen());
+    const std::vector<std::string> hot = { "/srv/www/index.html", "/srv/www/a b.css", "/bad\npath", "/srv/www/x.js" };
+
+    std::vector<int> fds;
+    std::vector<std::string> paths;
+    bool fetched = false;
+    std::thread newer([&] {  // 新进程
+        Handover handover(path);
+        fetched = handover.Fetch(19331, &fds, &paths);
+        if(fetched) { handover.Confirm(); }
+    });
+    struct pollfd pfd = { old.ListenFd(), POLLIN, 0 };
+    assert(poll(&pfd, 1, 5000) == 1 && old.Accept() >= 0);
+    Handover::STATE state = Handover::WAITING;
+    int rounds = 0;
+    while(state == Handover::WAITING) {
+        assert(rounds++ < 100);
+        pfd = { old.ConnFd(), POLLIN, 0 };
+        assert(poll(&pfd, 1, 5000) == 1);
+        state = old.OnReadable({ listenFd }, hot);
+    }
+    newer.join();
+    assert(state == Handover::DONE && fetched);
+    /* 含换行的路径无法按行传送，被跳过；其余顺序不变 */
+    assert(paths == std::vector<std::string>({ hot[0], hot[1], hot[3] }));
+    assert(fds.size() == 1 && fds[0] != listenFd);
+    assert(fcntl(fds[0], F_GETFD) & FD_CLOEXEC);
+    close(listenFd);  // 旧进程退出后，接过来的套接字照常接受连接
+    int client = ConnectLoopback(19331);
+    pfd = { fds[0], POLLIN, 0 };
+    assert(poll(&pfd, 1, 1000) == 1);
+    struct sockaddr_in addr;
+    int conn = listener.Accept(fds[0], &addr);
+    assert(conn >= 0);
+    close(conn);
+    close(client);
+    close(fds[0]);
+    old.CloseConn();
+    old.Close();  // 已被接管：套接字文件归新进程，不删除
+    assert(access(path.c_str(), F_OK) == 0);
+    unlink(path.c_str());
+}
+
+/* 读一个完整的响应（按 Content-length），超时或连接关闭时返回已收到的部分 */
+static std::string RecvResponse(int fd) {
+    std::string resp;
+    char buf[4096];
+    size_t need = 0;
+    while(need == 0 || resp.size() < need) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if(n <= 0) { break; }
+        resp.append(buf, n);
+        size_t head = resp.find("\r\n\r\n");
+        size_t len = resp.find("Content-length: ");
+        if(need == 0 && head != std::string::npos && len < head) {
+            need = head + 4 + atoi(resp.c_str() + len + 16);
+        }
+    }
+    return resp;
+}
+
+static std::mutex stubMtx;
+static std::condition_variable stubCond;
+static bool stubHeld = false;
+static int stubCalls = 0;
+
+static bool StubVerify(const std::string&, const std::string&, bool) {  // 数据库的桩：放行之前一直阻塞
+    std::unique_lock<std::mutex> locker(stubMtx);
+    stubCalls++;
+    stubCond.notify_all();
+    stubCond.wait(locker, [] { return !stubHeld; });
+    return true;
+}
+
+/* 数据库卡住时，同一 Reactor 上的静态请求照常完成；数据库线程的队列满了回 503，不阻塞事件循环 */
+void TestVerify() {
+    const std::vector<std::pair<std::string, size_t>> files = { { "/index.html", 100 }, { "/welcome.html", 10 } };
+    std::string dir = MakeDocRoot("test_verify", files);
+    HttpRequest::verifyBackend = StubVerify;
+    int port = 19316;
+    const struct { int subReactors; bool uring; } MODES[] = { { 0, false }, { 1, false }, { 1, true } };
+    for(const auto& mode: MODES) {  // io_uring 不可用时退回 epoll
+        Config config;
+        config.port = port++;
+        config.subReactors = mode.subReactors;
+        config.uring = mode.uring;
+        config.threads = 2;
+        config.connPoolNum = 1;  // 一个数据库线程
+        config.queueSize = 2;  // 它的队列只能再排 2 个
+        config.openLog = false;
+        config.tcpDeferAccept = 0;
+        config.resourceDir = dir;
+        stubHeld = true;
+        stubCalls = 0;
+        WebServer server(config);
+        std::thread client([&] {
+            auto login = [&](int i) {
+                std::string form = "username=slow" + std::to_string(i) + "&password=p";
+                std::string req = "POST /login HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+                                  "Content-Length: " + std::to_string(form.size()) + "\r\n\r\n" + form;
+                int fd = ConnectLoopback(config.port);
+                assert(send(fd, req.data(), req.size(), 0) == (ssize_t)req.size());
+                return fd;
+            };
+            int held = login(0);
+            {
+                std::unique_lock<std::mutex> locker(stubMtx);
+                assert(stubCond.wait_for(locker, std::chrono::seconds(5), [] { return stubCalls == 1; }));
+            }
+            /* 数据库线程卡在第一个查询上：再来三个登录，两个排队，一个立即收到 503 */
+            std::vector<int> waiting = { login(1), login(2), login(3) };
+            int rejected = 0;
+            for(int i = 0; i < 3 && rejected == 0; i++) {
+                std::vector<pollfd> pfds;
+                for(int fd: waiting) { pfds.push_back({ fd, POLLIN, 0 }); }
+                assert(poll(pfds.data(), pfds.size(), 5000) > 0);
+                for(size_t j = 0; j < pfds.size(); j++) {
+                    if(pfds[j].revents & POLLIN) {
+                        assert(RecvResponse(waiting[j]).compare(0, 12, "HTTP/1.1 503") == 0);
+                        close(waiting[j]);
+                        waiting.erase(waiting.begin() + j);
+                        rejected++;
+                        break;
+                    }
+                }
+            }
+            assert(rejected == 1 && waiting.size() == 2);
+            /* 同一个 Reactor 上的静态请求不受影响 */
+            int fd = ConnectLoopback(config.port);
+            const std::string get = "GET /index.html HTTP/1.1\r\nConnection: keep-alive\r\n\r\n";
+            for(int i = 0; i < 3; i++) {
+                assert(send(fd, get.data(), get.size(), 0) == (ssize_t)get.size());
+                assert(RecvResponse(fd).compare(0, 12, "HTTP/1.1 200") == 0);
+            }
+            close(fd);
+            {
+                std::lock_guard<std::mutex> locker(stubMtx);
+                stubHeld = false;
+            }
+            stubCond.notify_all();
+            waiting.push_back(held);
+            for(int fd: waiting) {
+                std::string resp = RecvResponse(fd);
+                assert(resp.compare(0, 12, "HTTP/1.1 200") == 0 && resp.size() == resp.find("\r\n\r\n") + 4 + 10);
+                close(fd);
+            }
+            kill(getpid(), SIGTERM);  // 优雅退出，Start 返回
+        });
+        server.Start();
+        client.join();
+        assert(stubCalls == 3);
+    }
+    HttpRequest::verifyBackend = nullptr;
+    RemoveDocRoot(dir, files);
+}
+
+int main(int argc, char* argv[]) {
+    const struct { const char* name; void (*run)(); } TESTS[] = {
+        { "log", TestLog }, { "threadpool", TestThreadPool }, { "parser", TestParser },
+        { "body", TestBody }, { "buffer", TestBuffer }, { "timer", TestTimer },
+        { "response", TestResponse }, { "pipeline", TestPipeline }, { "metrics", TestMetrics },
+        { "config", TestConfig }, { "usercache", TestUserCache }, { "conntable", TestConnTable },
+        { "listener", TestListener }, { "handover", TestHandover }, { "verify", TestVerify },
+    };
+    /* 在创建任何线程之前屏蔽退出信号：服务器测试用 SIGTERM 让 Start 返回，信号只经 signalfd 交给主循环 */
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    std::string which = argc > 1 ? argv[1] : "";
+    for(const auto& test: TESTS) {
+        if(which.empty() || which == test.name) {
+            test.run();
+            printf("[test] %s ok\n", test.name);
+        }
+    }
+}